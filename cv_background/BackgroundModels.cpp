@@ -0,0 +1,453 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file BackgroundModels.cpp
+ * @brief Implementation of the lightweight background subtractor classes
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#include "BackgroundModels.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <opencv2/core/hal/intrin.hpp>
+
+/*******************************************************************************************************************//**
+ * @brief Get an 8 bit grey view of an input frame, converting color frames into a scratch buffer
+ * @param[in] image the input frame
+ * @param[in, out] greyScratch buffer used for color conversion
+ * @return the grey frame
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+static cv::Mat getGrey(cv::InputArray image, cv::Mat &greyScratch)
+{
+    cv::Mat frame = image.getMat();
+    CV_Assert(frame.depth() == CV_8U);
+    if(frame.channels() == 1)
+    {
+        return frame;
+    }
+    cv::cvtColor(frame, greyScratch, cv::COLOR_BGR2GRAY);
+    return greyScratch;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Classify and update one row of a running average model
+ * @param[in] src the grey pixels
+ * @param[in, out] background the 8.8 fixed point averages
+ * @param[out] mask the foreground mask
+ * @param[in] width number of pixels in the row
+ * @param[in] shift learning rate as a power of two, from 1 to 8
+ * @param[in] threshold foreground threshold in grey levels
+ * @param[in] update whether to update the averages
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+static void runningAverageRow(const uchar *src, ushort *background, uchar *mask, int width, int shift, int threshold, bool update)
+{
+    int x = 0;
+#if CV_SIMD128
+    const cv::v_uint8x16 thresholdVector = cv::v_setall_u8(static_cast<uchar>(threshold));
+    for(; x <= width - 16; x += 16)
+    {
+        cv::v_uint8x16 pixels = cv::v_load(src + x);
+        cv::v_uint16x8 averageLow = cv::v_load(background + x);
+        cv::v_uint16x8 averageHigh = cv::v_load(background + x + 8);
+        cv::v_uint8x16 averagePixels = cv::v_pack(averageLow >> 8, averageHigh >> 8);
+        cv::v_store(mask + x, cv::v_absdiff(pixels, averagePixels) > thresholdVector);
+        if(update)
+        {
+            // average += (pixel - average) / 2^shift, rearranged so no lane goes negative or overflows
+            cv::v_uint16x8 pixelsLow, pixelsHigh;
+            cv::v_expand(pixels, pixelsLow, pixelsHigh);
+            cv::v_store(background + x, averageLow - (averageLow >> shift) + (pixelsLow << (8 - shift)));
+            cv::v_store(background + x + 8, averageHigh - (averageHigh >> shift) + (pixelsHigh << (8 - shift)));
+        }
+    }
+#endif
+    for(; x < width; x++)
+    {
+        mask[x] = std::abs(src[x] - (background[x] >> 8)) > threshold ? 255 : 0;
+        if(update)
+        {
+            background[x] = static_cast<ushort>(background[x] - (background[x] >> shift) + (src[x] << (8 - shift)));
+        }
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Classify and update one row of an approximate median model
+ * @param[in] src the grey pixels
+ * @param[in, out] background the running medians
+ * @param[out] mask the foreground mask
+ * @param[in] width number of pixels in the row
+ * @param[in] threshold foreground threshold in grey levels
+ * @param[in] update whether to update the medians
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+static void approxMedianRow(const uchar *src, uchar *background, uchar *mask, int width, int threshold, bool update)
+{
+    int x = 0;
+#if CV_SIMD128
+    const cv::v_uint8x16 thresholdVector = cv::v_setall_u8(static_cast<uchar>(threshold));
+    const cv::v_uint8x16 one = cv::v_setall_u8(1);
+    for(; x <= width - 16; x += 16)
+    {
+        cv::v_uint8x16 pixels = cv::v_load(src + x);
+        cv::v_uint8x16 median = cv::v_load(background + x);
+        cv::v_store(mask + x, cv::v_absdiff(pixels, median) > thresholdVector);
+        if(update)
+        {
+            // step one grey level towards the pixel, the 8 bit lanes saturate
+            median = median + ((pixels > median) & one);
+            median = median - ((pixels < median) & one);
+            cv::v_store(background + x, median);
+        }
+    }
+#endif
+    for(; x < width; x++)
+    {
+        mask[x] = std::abs(src[x] - background[x]) > threshold ? 255 : 0;
+        if(update)
+        {
+            background[x] = static_cast<uchar>(background[x] + (src[x] > background[x]) - (src[x] < background[x]));
+        }
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Count the samples that match each pixel of a row
+ * @param[in] src the grey pixels
+ * @param[in] samples the sample rows
+ * @param[out] counts the number of matching samples of each pixel
+ * @param[in] width number of pixels in the row
+ * @param[in] radius largest grey level difference of a matching sample
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+static void countMatchesRow(const uchar *src, const std::vector<const uchar*> &samples, uchar *counts, int width, int radius)
+{
+    const size_t numSamples = samples.size();
+    int x = 0;
+#if CV_SIMD128
+    const cv::v_uint8x16 radiusVector = cv::v_setall_u8(static_cast<uchar>(radius));
+    const cv::v_uint8x16 one = cv::v_setall_u8(1);
+    for(; x <= width - 16; x += 16)
+    {
+        cv::v_uint8x16 pixels = cv::v_load(src + x);
+        cv::v_uint8x16 count = cv::v_setall_u8(0);
+        for(size_t k = 0; k < numSamples; k++)
+        {
+            count = count + ((cv::v_absdiff(pixels, cv::v_load(samples[k] + x)) <= radiusVector) & one);
+        }
+        cv::v_store(counts + x, count);
+    }
+#endif
+    for(; x < width; x++)
+    {
+        int count = 0;
+        for(size_t k = 0; k < numSamples; k++)
+        {
+            count += std::abs(src[x] - samples[k][x]) <= radius;
+        }
+        counts[x] = static_cast<uchar>(count);
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Threshold match counts into a foreground mask
+ * @param[in] counts the number of matching samples of each pixel
+ * @param[out] mask the foreground mask
+ * @param[in] width number of pixels in the row
+ * @param[in] minMatches number of matching samples needed for background
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+static void matchMaskRow(const uchar *counts, uchar *mask, int width, int minMatches)
+{
+    int x = 0;
+#if CV_SIMD128
+    const cv::v_uint8x16 minVector = cv::v_setall_u8(static_cast<uchar>(minMatches));
+    for(; x <= width - 16; x += 16)
+    {
+        cv::v_store(mask + x, cv::v_load(counts + x) < minVector);
+    }
+#endif
+    for(; x < width; x++)
+    {
+        mask[x] = counts[x] < minMatches ? 255 : 0;
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Class constructor
+ * @param[in] history number of frames the average spans, rounded to a power of two between 2 and 256
+ * @param[in] threshold foreground threshold in grey levels
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+RunningAverageBackgroundSubtractor::RunningAverageBackgroundSubtractor(int history, int threshold) : m_shift(std::min(std::max(cvRound(std::log(std::max(history, 2)) / std::log(2.0)), 1), 8)), m_threshold(threshold)
+{
+}
+
+/*******************************************************************************************************************//**
+ * @brief Update the model with a frame and extract its foreground mask
+ * @param[in] image the 8 bit grey or BGR frame
+ * @param[out] fgmask the foreground mask
+ * @param[in] learningRate negative for the history based rate, 0 to freeze the model, otherwise the update rate
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void RunningAverageBackgroundSubtractor::apply(cv::InputArray image, cv::OutputArray fgmask, double learningRate)
+{
+    cv::Mat grey = getGrey(image, m_grey);
+    fgmask.create(grey.size(), CV_8UC1);
+    cv::Mat mask = fgmask.getMat();
+
+    // start from the first frame
+    if(m_background.size() != grey.size())
+    {
+        grey.convertTo(m_background, CV_16U, 256.0);
+        mask.setTo(cv::Scalar::all(0));
+        return;
+    }
+
+    // classify and update each row
+    int shift = m_shift;
+    if(learningRate > 0.0)
+    {
+        shift = std::min(std::max(cvRound(-std::log(std::min(learningRate, 1.0)) / std::log(2.0)), 1), 8);
+    }
+    const bool update = learningRate != 0.0;
+    for(int y = 0; y < grey.rows; y++)
+    {
+        runningAverageRow(grey.ptr<uchar>(y), m_background.ptr<ushort>(y), mask.ptr<uchar>(y), grey.cols, shift, m_threshold, update);
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the current background estimate
+ * @param[out] backgroundImage the background image
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void RunningAverageBackgroundSubtractor::getBackgroundImage(cv::OutputArray backgroundImage) const
+{
+    m_background.convertTo(backgroundImage, CV_8U, 1.0 / 256.0);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Class constructor
+ * @param[in] threshold foreground threshold in grey levels
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+ApproxMedianBackgroundSubtractor::ApproxMedianBackgroundSubtractor(int threshold) : m_threshold(threshold)
+{
+}
+
+/*******************************************************************************************************************//**
+ * @brief Update the model with a frame and extract its foreground mask
+ * @param[in] image the 8 bit grey or BGR frame
+ * @param[out] fgmask the foreground mask
+ * @param[in] learningRate 0 to freeze the model, any other value updates it
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void ApproxMedianBackgroundSubtractor::apply(cv::InputArray image, cv::OutputArray fgmask, double learningRate)
+{
+    cv::Mat grey = getGrey(image, m_grey);
+    fgmask.create(grey.size(), CV_8UC1);
+    cv::Mat mask = fgmask.getMat();
+
+    // start from the first frame
+    if(m_background.size() != grey.size())
+    {
+        grey.copyTo(m_background);
+        mask.setTo(cv::Scalar::all(0));
+        return;
+    }
+
+    // classify and update each row
+    const bool update = learningRate != 0.0;
+    for(int y = 0; y < grey.rows; y++)
+    {
+        approxMedianRow(grey.ptr<uchar>(y), m_background.ptr<uchar>(y), mask.ptr<uchar>(y), grey.cols, m_threshold, update);
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the current background estimate
+ * @param[out] backgroundImage the background image
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void ApproxMedianBackgroundSubtractor::getBackgroundImage(cv::OutputArray backgroundImage) const
+{
+    m_background.copyTo(backgroundImage);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Class constructor
+ * @param[in] radius largest grey level difference of a matching sample
+ * @param[in] numSamples number of samples kept for each pixel
+ * @param[in] minMatches number of matching samples needed for background
+ * @param[in] subsampling mean number of background pixels between random model updates
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+ViBeBackgroundSubtractor::ViBeBackgroundSubtractor(int radius, int numSamples, int minMatches, int subsampling) : m_numSamples(std::min(std::max(numSamples, 1), 255)), m_radius(radius), m_minMatches(minMatches), m_subsampling(std::max(subsampling, 1)), m_randomState(2463534242u)
+{
+}
+
+/*******************************************************************************************************************//**
+ * @brief Draw the next number from a xorshift generator
+ * @return a pseudo random number
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+unsigned int ViBeBackgroundSubtractor::nextRandom()
+{
+    m_randomState ^= m_randomState << 13;
+    m_randomState ^= m_randomState >> 17;
+    m_randomState ^= m_randomState << 5;
+    return m_randomState;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Fill the samples from the first frame, each shifted by a random neighbour offset
+ * @param[in] grey the first frame
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void ViBeBackgroundSubtractor::initialize(const cv::Mat &grey)
+{
+    cv::copyMakeBorder(grey, m_padded, 1, 1, 1, 1, cv::BORDER_REPLICATE);
+    m_samples.resize(m_numSamples);
+    for(int k = 0; k < m_numSamples; k++)
+    {
+        int dx = k == 0 ? 0 : static_cast<int>(nextRandom() % 3) - 1;
+        int dy = k == 0 ? 0 : static_cast<int>(nextRandom() % 3) - 1;
+        m_padded(cv::Rect(1 + dx, 1 + dy, grey.cols, grey.rows)).copyTo(m_samples[k]);
+    }
+    m_rowCounts.resize(grey.cols);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Update the model with a frame and extract its foreground mask
+ * @param[in] image the 8 bit grey or BGR frame
+ * @param[out] fgmask the foreground mask
+ * @param[in] learningRate negative for the default subsampling, 0 to freeze the model, otherwise the update chance
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void ViBeBackgroundSubtractor::apply(cv::InputArray image, cv::OutputArray fgmask, double learningRate)
+{
+    cv::Mat grey = getGrey(image, m_grey);
+    fgmask.create(grey.size(), CV_8UC1);
+    cv::Mat mask = fgmask.getMat();
+
+    // start from the first frame
+    if(m_samples.empty() || m_samples[0].size() != grey.size())
+    {
+        initialize(grey);
+        mask.setTo(cv::Scalar::all(0));
+        return;
+    }
+    int subsampling = m_subsampling;
+    if(learningRate > 0.0)
+    {
+        subsampling = std::max(1, cvRound(1.0 / std::min(learningRate, 1.0)));
+    }
+    const bool update = learningRate != 0.0;
+
+    std::vector<const uchar*> sampleRows(m_numSamples);
+    for(int y = 0; y < grey.rows; y++)
+    {
+        // classify the row
+        const uchar *src = grey.ptr<uchar>(y);
+        uchar *maskRow = mask.ptr<uchar>(y);
+        for(int k = 0; k < m_numSamples; k++)
+        {
+            sampleRows[k] = m_samples[k].ptr<uchar>(y);
+        }
+        countMatchesRow(src, sampleRows, &m_rowCounts[0], grey.cols, m_radius);
+        matchMaskRow(&m_rowCounts[0], maskRow, grey.cols, m_minMatches);
+        if(!update)
+        {
+            continue;
+        }
+
+        // replace one of the pixel's own samples at random background pixels
+        for(int x = static_cast<int>(nextRandom() % subsampling); x < grey.cols; x += 1 + static_cast<int>(nextRandom() % (2 * subsampling - 1)))
+        {
+            if(maskRow[x] == 0)
+            {
+                m_samples[nextRandom() % m_numSamples].at<uchar>(y, x) = src[x];
+            }
+        }
+
+        // and propagate the pixel into a sample of a random neighbour at others
+        for(int x = static_cast<int>(nextRandom() % subsampling); x < grey.cols; x += 1 + static_cast<int>(nextRandom() % (2 * subsampling - 1)))
+        {
+            if(maskRow[x] == 0)
+            {
+                unsigned int random = nextRandom();
+                int nx = std::min(std::max(x + static_cast<int>(random % 3) - 1, 0), grey.cols - 1);
+                int ny = std::min(std::max(y + static_cast<int>((random / 3) % 3) - 1, 0), grey.rows - 1);
+                m_samples[(random / 9) % m_numSamples].at<uchar>(ny, nx) = src[x];
+            }
+        }
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the current background estimate
+ * @param[out] backgroundImage the first sample of every pixel
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void ViBeBackgroundSubtractor::getBackgroundImage(cv::OutputArray backgroundImage) const
+{
+    if(!m_samples.empty())
+    {
+        m_samples[0].copyTo(backgroundImage);
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Create a background model by name
+ *
+ * The lightweight models compare grey levels directly, so the MOG2 variance threshold is converted to a grey level
+ * threshold by taking its square root.
+ *
+ * @param[in] modelType one of "mog2", "average", "median", or "vibe"
+ * @param[in] history number of frames the model spans
+ * @param[in] varThreshold MOG2 variance threshold
+ * @param[in] detectShadows whether MOG2 marks shadows
+ * @return the background model, empty if the name is unknown
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+cv::Ptr<cv::BackgroundSubtractor> createBackgroundModel(const std::string &modelType, int history, double varThreshold, bool detectShadows)
+{
+    const int threshold = std::min(std::max(cvRound(std::sqrt(std::max(varThreshold, 0.0))), 1), 254);
+    if(modelType == "mog2")
+    {
+        return cv::createBackgroundSubtractorMOG2(history, varThreshold, detectShadows);
+    }
+    if(modelType == "average")
+    {
+        return cv::makePtr<RunningAverageBackgroundSubtractor>(history, threshold);
+    }
+    if(modelType == "median")
+    {
+        return cv::makePtr<ApproxMedianBackgroundSubtractor>(threshold);
+    }
+    if(modelType == "vibe")
+    {
+        return cv::makePtr<ViBeBackgroundSubtractor>(threshold);
+    }
+    return cv::Ptr<cv::BackgroundSubtractor>();
+}
@@ -0,0 +1,123 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file BackgroundModels.h
+ * @brief Header file for the lightweight background subtractor classes
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#ifndef BACKGROUND_MODELS_H
+#define BACKGROUND_MODELS_H
+
+#include <vector>
+#include <string>
+#include "opencv2/opencv.hpp"
+
+/*******************************************************************************************************************//**
+ * @class RunningAverageBackgroundSubtractor
+ *
+ * @brief Background subtractor that keeps an exponential running average of every pixel
+ *
+ * The average is stored in 8.8 fixed point and updated with a power of two learning rate close to 1 / history, so the
+ * update is two shifts and an add per pixel. A pixel is foreground when it differs from the average by more than the
+ * threshold. Rows are processed 16 pixels at a time with OpenCV universal intrinsics.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class RunningAverageBackgroundSubtractor : public cv::BackgroundSubtractor
+{
+private:
+
+    int m_shift;
+    int m_threshold;
+    cv::Mat m_background;
+    cv::Mat m_grey;
+
+public:
+
+    RunningAverageBackgroundSubtractor(int history=200, int threshold=20);
+    void apply(cv::InputArray image, cv::OutputArray fgmask, double learningRate=-1) override;
+    void getBackgroundImage(cv::OutputArray backgroundImage) const override;
+};
+
+/*******************************************************************************************************************//**
+ * @class ApproxMedianBackgroundSubtractor
+ *
+ * @brief Background subtractor that tracks the median of every pixel by stepping one grey level towards each frame
+ *
+ * A pixel is foreground when it differs from its running median by more than the threshold. Rows are processed 16
+ * pixels at a time with OpenCV universal intrinsics.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class ApproxMedianBackgroundSubtractor : public cv::BackgroundSubtractor
+{
+private:
+
+    int m_threshold;
+    cv::Mat m_background;
+    cv::Mat m_grey;
+
+public:
+
+    ApproxMedianBackgroundSubtractor(int threshold=20);
+    void apply(cv::InputArray image, cv::OutputArray fgmask, double learningRate=-1) override;
+    void getBackgroundImage(cv::OutputArray backgroundImage) const override;
+};
+
+/*******************************************************************************************************************//**
+ * @class ViBeBackgroundSubtractor
+ *
+ * @brief Background subtractor that keeps a set of past samples for every pixel, in the style of ViBe
+ *
+ * A pixel is background when at least the minimum number of its samples lie within the radius of its value. The
+ * sample comparisons are counted 16 pixels at a time with OpenCV universal intrinsics. Background pixels occasionally
+ * replace one of their own samples and one sample of a random neighbour, which lets the model absorb slow changes and
+ * erode ghosts. The random updates visit pixels by random skips with a mean of the subsampling factor instead of
+ * drawing a random number per pixel.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class ViBeBackgroundSubtractor : public cv::BackgroundSubtractor
+{
+private:
+
+    int m_numSamples;
+    int m_radius;
+    int m_minMatches;
+    int m_subsampling;
+    std::vector<cv::Mat> m_samples;
+    std::vector<uchar> m_rowCounts;
+    cv::Mat m_grey;
+    cv::Mat m_padded;
+    unsigned int m_randomState;
+
+    unsigned int nextRandom();
+    void initialize(const cv::Mat &grey);
+
+public:
+
+    ViBeBackgroundSubtractor(int radius=20, int numSamples=20, int minMatches=2, int subsampling=16);
+    void apply(cv::InputArray image, cv::OutputArray fgmask, double learningRate=-1) override;
+    void getBackgroundImage(cv::OutputArray backgroundImage) const override;
+};
+
+// factory
+cv::Ptr<cv::BackgroundSubtractor> createBackgroundModel(const std::string &modelType, int history, double varThreshold, bool detectShadows);
+
+#endif // BACKGROUND_MODELS_H
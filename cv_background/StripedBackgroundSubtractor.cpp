@@ -0,0 +1,154 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file StripedBackgroundSubtractor.cpp
+ * @brief Implementation of the StripedBackgroundSubtractor class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#include "StripedBackgroundSubtractor.h"
+#include "BackgroundModels.h"
+
+#include <algorithm>
+
+/*******************************************************************************************************************//**
+ * @brief Class constructor
+ * @param[in] numStripes number of horizontal stripes, 0 uses one stripe per CPU
+ * @param[in] modelScale scale of the background model relative to the frame, 1.0 models every pixel
+ * @param[in] history MOG2 history length
+ * @param[in] varThreshold MOG2 variance threshold
+ * @param[in] detectShadows whether MOG2 marks shadows
+ * @param[in] modelType background model of each stripe, one of "mog2", "average", "median", or "vibe"
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+StripedBackgroundSubtractor::StripedBackgroundSubtractor(int numStripes, double modelScale, int history, double varThreshold, bool detectShadows, const std::string &modelType) : m_modelType(modelType), m_numStripes(numStripes > 0 ? numStripes : cv::getNumberOfCPUs()), m_modelScale(std::min(std::max(modelScale, 0.05), 1.0)), m_history(history), m_varThreshold(varThreshold), m_detectShadows(detectShadows)
+{
+}
+
+/*******************************************************************************************************************//**
+ * @brief Split a frame size into stripes and create a model for each
+ * @param[in] frameSize the frame size
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void StripedBackgroundSubtractor::createStripes(const cv::Size &frameSize)
+{
+    m_frameSize = frameSize;
+    const int numStripes = std::max(1, std::min(m_numStripes, frameSize.height));
+    m_stripeRows.resize(numStripes);
+    m_models.resize(numStripes);
+    m_scaled.resize(numStripes);
+    m_scaledMasks.resize(numStripes);
+    m_stripeMin.resize(numStripes);
+    m_stripeMax.resize(numStripes);
+    for(int i = 0; i < numStripes; i++)
+    {
+        m_stripeRows[i] = cv::Range(i * frameSize.height / numStripes, (i + 1) * frameSize.height / numStripes);
+        m_models[i] = createBackgroundModel(m_modelType, m_history, m_varThreshold, m_detectShadows);
+        CV_Assert(!m_models[i].empty());
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Update the background model with a frame and extract its foreground mask
+ * @param[in] frame the BGR frame
+ * @param[out] fgMaskOut the foreground mask at the frame resolution
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void StripedBackgroundSubtractor::apply(const cv::Mat &frame, cv::Mat &fgMaskOut)
+{
+    if(frame.size() != m_frameSize)
+    {
+        createStripes(frame.size());
+    }
+    m_grey.create(frame.rows, frame.cols, CV_8UC1);
+    fgMaskOut.create(frame.rows, frame.cols, CV_8UC1);
+    const int numStripes = static_cast<int>(m_stripeRows.size());
+
+    // convert each stripe to grey and measure its range
+    cv::parallel_for_(cv::Range(0, numStripes), [&](const cv::Range &range)
+    {
+        for(int i = range.start; i < range.end; i++)
+        {
+            cv::Mat grey = m_grey.rowRange(m_stripeRows[i]);
+            cv::cvtColor(frame.rowRange(m_stripeRows[i]), grey, cv::COLOR_BGR2GRAY);
+            cv::minMaxLoc(grey, &m_stripeMin[i], &m_stripeMax[i]);
+        }
+    }, numStripes);
+
+    // stretch the combined range to the full 8 bit range, as cv::normalize with NORM_MINMAX would
+    const double greyMin = *std::min_element(m_stripeMin.begin(), m_stripeMin.end());
+    const double greyMax = *std::max_element(m_stripeMax.begin(), m_stripeMax.end());
+    const double alpha = greyMax > greyMin ? 255.0 / (greyMax - greyMin) : 1.0;
+    const double beta = greyMax > greyMin ? -greyMin * alpha : 0.0;
+    const bool stretch = greyMin != 0.0 || greyMax != 255.0;
+
+    // normalize each stripe and update its model
+    cv::parallel_for_(cv::Range(0, numStripes), [&](const cv::Range &range)
+    {
+        for(int i = range.start; i < range.end; i++)
+        {
+            cv::Mat grey = m_grey.rowRange(m_stripeRows[i]);
+            cv::Mat mask = fgMaskOut.rowRange(m_stripeRows[i]);
+            if(stretch)
+            {
+                grey.convertTo(grey, CV_8U, alpha, beta);
+            }
+            if(m_modelScale < 1.0)
+            {
+                cv::Size scaledSize(std::max(1, cvRound(grey.cols * m_modelScale)), std::max(1, cvRound(grey.rows * m_modelScale)));
+                cv::resize(grey, m_scaled[i], scaledSize, 0, 0, cv::INTER_AREA);
+                m_models[i]->apply(m_scaled[i], m_scaledMasks[i]);
+                cv::resize(m_scaledMasks[i], mask, mask.size(), 0, 0, cv::INTER_NEAREST);
+            }
+            else
+            {
+                m_models[i]->apply(grey, mask);
+            }
+        }
+    }, numStripes);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the background model type
+ * @return the name of the model used by every stripe
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+const std::string& StripedBackgroundSubtractor::getModelType() const
+{
+    return m_modelType;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the number of stripes
+ * @return the number of stripes, each with its own model
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+int StripedBackgroundSubtractor::getNumStripes() const
+{
+    return m_stripeRows.empty() ? m_numStripes : static_cast<int>(m_stripeRows.size());
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the background model scale
+ * @return the scale of the model relative to the frame
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+double StripedBackgroundSubtractor::getModelScale() const
+{
+    return m_modelScale;
+}
@@ -0,0 +1,85 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file StripedBackgroundSubtractor.h
+ * @brief Header file for the StripedBackgroundSubtractor class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#ifndef STRIPED_BACKGROUND_SUBTRACTOR_H
+#define STRIPED_BACKGROUND_SUBTRACTOR_H
+
+#include <vector>
+#include <string>
+#include "opencv2/opencv.hpp"
+
+/*******************************************************************************************************************//**
+ * @class StripedBackgroundSubtractor
+ *
+ * @brief Class for running background subtraction on horizontal stripes of a frame in parallel
+ *
+ * MOG2 and the lightweight models in BackgroundModels.h treat every pixel independently, so the frame is split into
+ * horizontal stripes that each own a model and run on the OpenCV thread pool with no shared state. Each stripe converts
+ * its rows to grey and measures their range in the same pass, and the min-max normalization is then applied per stripe
+ * with the combined range just before the model update, while the stripe is still in cache. In the optional downscaled
+ * mode each stripe is shrunk before the model update and its mask is scaled back up to the frame resolution.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class StripedBackgroundSubtractor
+{
+private:
+
+    // model settings
+    std::string m_modelType;
+    int m_numStripes;
+    double m_modelScale;
+    int m_history;
+    double m_varThreshold;
+    bool m_detectShadows;
+
+    // per stripe state
+    cv::Size m_frameSize;
+    std::vector<cv::Range> m_stripeRows;
+    std::vector<cv::Ptr<cv::BackgroundSubtractor> > m_models;
+    std::vector<cv::Mat> m_scaled;
+    std::vector<cv::Mat> m_scaledMasks;
+    std::vector<double> m_stripeMin;
+    std::vector<double> m_stripeMax;
+
+    // whole frame scratch buffers
+    cv::Mat m_grey;
+
+    // helper functions
+    void createStripes(const cv::Size &frameSize);
+
+public:
+
+    // constructors
+    StripedBackgroundSubtractor(int numStripes=0, double modelScale=1.0, int history=200, double varThreshold=16.0, bool detectShadows=false, const std::string &modelType="mog2");
+
+    // background subtraction
+    void apply(const cv::Mat &frame, cv::Mat &fgMaskOut);
+
+    // accessors
+    const std::string& getModelType() const;
+    int getNumStripes() const;
+    double getModelScale() const;
+};
+
+#endif // STRIPED_BACKGROUND_SUBTRACTOR_H
@@ -0,0 +1,175 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file cv_bg_benchmark.cpp
+ * @brief C++ example for comparing the throughput and masks of background models with OpenCV
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+// include necessary dependencies
+#include <iostream>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include "opencv2/opencv.hpp"
+#include "Metrics.h"
+#include "BackgroundModels.h"
+
+// configuration parameters
+#define NUM_COMNMAND_LINE_ARGUMENTS 1
+#define DEFAULT_MAX_FRAMES 300
+#define WARMUP_FRAMES 30
+
+/*******************************************************************************************************************//**
+ * @brief program entry point
+ *
+ * Every model sees the same preprocessed grey frames, in lockstep, and only the model update is timed. Each mask is
+ * compared with the MOG2 mask of the same frame once the models have warmed up.
+ *
+ * @param[in] argc number of command line arguments
+ * @param[in] argv string array of command line arguments
+ * @return return code (0 for normal termination)
+ * @author Christoper D. McMurrough
+ **********************************************************************************************************************/
+int main(int argc, char **argv)
+{
+    // store video capture parameters
+    std::string fileName;
+
+    // parse the benchmark options
+    std::string optionValue;
+    int maxFrames = DEFAULT_MAX_FRAMES;
+    if(extractOption(argc, argv, "--frames", optionValue))
+    {
+        maxFrames = std::atoi(optionValue.c_str());
+    }
+    if(extractOption(argc, argv, "--threads", optionValue))
+    {
+        cv::setNumThreads(std::atoi(optionValue.c_str()));
+    }
+
+    // validate and parse the command line arguments
+    if(argc != NUM_COMNMAND_LINE_ARGUMENTS + 1)
+    {
+        std::printf("USAGE: %s <file_path> [--frames=<count>] [--threads=<count>] \n", argv[0]);
+        return 0;
+    }
+    else
+    {
+        fileName = argv[1];
+    }
+
+    // open the video file
+    cv::VideoCapture capture(fileName);
+    if(!capture.isOpened())
+    {
+        std::printf("Unable to open video source, terminating program! \n");
+        return 0;
+    }
+
+    // get the video source parameters
+    int captureWidth = static_cast<int>(capture.get(cv::CAP_PROP_FRAME_WIDTH));
+    int captureHeight = static_cast<int>(capture.get(cv::CAP_PROP_FRAME_HEIGHT));
+    int captureFPS = static_cast<int>(capture.get(cv::CAP_PROP_FPS));
+    std::cout << "Video source opened successfully (width=" << captureWidth << " height=" << captureHeight << " fps=" << captureFPS << ")!" << std::endl;
+
+    // create the models with the cv_pmog settings, the first model is the reference
+    const int bgHistory = 200;
+    const float bgThreshold = 500;
+    const bool bgShadowDetection = false;
+    std::vector<std::string> modelTypes;
+    modelTypes.push_back("mog2");
+    modelTypes.push_back("average");
+    modelTypes.push_back("median");
+    modelTypes.push_back("vibe");
+    const size_t numModels = modelTypes.size();
+    std::vector<cv::Ptr<cv::BackgroundSubtractor> > models(numModels);
+    for(size_t i = 0; i < numModels; i++)
+    {
+        models[i] = createBackgroundModel(modelTypes[i], bgHistory, bgThreshold, bgShadowDetection);
+    }
+
+    // per model timing and agreement with the reference mask
+    std::vector<MetricsHistogram> latencies(numModels);
+    std::vector<cv::Mat> masks(numModels);
+    std::vector<double> agreementSum(numModels, 0.0);
+    std::vector<double> overlapSum(numModels, 0.0);
+    int comparedFrames = 0;
+
+    // run every model on each frame
+    cv::Mat captureFrame;
+    cv::Mat grayFrame;
+    cv::Mat difference;
+    int frameCount = 0;
+    while((maxFrames <= 0 || frameCount < maxFrames) && capture.read(captureFrame))
+    {
+        // pre-process the raw image frame as cv_pmog does
+        const int rangeMin = 0;
+        const int rangeMax = 255;
+        cv::cvtColor(captureFrame, grayFrame, cv::COLOR_BGR2GRAY);
+        cv::normalize(grayFrame, grayFrame, rangeMin, rangeMax, cv::NORM_MINMAX, CV_8UC1);
+
+        // time the model updates only
+        for(size_t i = 0; i < numModels; i++)
+        {
+            double startTicks = static_cast<double>(cv::getTickCount());
+            models[i]->apply(grayFrame, masks[i]);
+            latencies[i].record((static_cast<double>(cv::getTickCount()) - startTicks) / cv::getTickFrequency());
+        }
+        frameCount++;
+
+        // compare the masks with the reference once the models have settled
+        if(frameCount <= WARMUP_FRAMES)
+        {
+            continue;
+        }
+        const double totalPixels = static_cast<double>(grayFrame.total());
+        const int referenceCount = cv::countNonZero(masks[0]);
+        for(size_t i = 0; i < numModels; i++)
+        {
+            // fraction of pixels with the same label, and intersection over union of the foreground
+            cv::bitwise_xor(masks[i], masks[0], difference);
+            agreementSum[i] += 1.0 - cv::countNonZero(difference) / totalPixels;
+            cv::bitwise_and(masks[i], masks[0], difference);
+            const int intersection = cv::countNonZero(difference);
+            const int unionCount = cv::countNonZero(masks[i]) + referenceCount - intersection;
+            overlapSum[i] += unionCount > 0 ? static_cast<double>(intersection) / unionCount : 1.0;
+        }
+        comparedFrames++;
+    }
+
+    // report the throughput and agreement of each model
+    std::printf("Background models over %d frames (%dx%d), %d threads, masks compared after %d frames \n", frameCount, captureWidth, captureHeight, cv::getNumThreads(), WARMUP_FRAMES);
+    std::printf("%-8s %10s %10s %10s %8s %10s %8s \n", "model", "mean ms", "p99 ms", "fps", "speedup", "agreement", "fg IoU");
+    const double referenceMean = latencies[0].getMean();
+    for(size_t i = 0; i < numModels; i++)
+    {
+        const double mean = latencies[i].getMean();
+        std::printf("%-8s %10.3f %10.3f %10.1f %7.1fx %9.1f%% %8.3f \n",
+                    modelTypes[i].c_str(),
+                    mean * 1000.0,
+                    latencies[i].getPercentile(99.0) * 1000.0,
+                    mean > 0.0 ? 1.0 / mean : 0.0,
+                    mean > 0.0 ? referenceMean / mean : 0.0,
+                    comparedFrames > 0 ? 100.0 * agreementSum[i] / comparedFrames : 0.0,
+                    comparedFrames > 0 ? overlapSum[i] / comparedFrames : 0.0);
+    }
+
+    // release program resources before returning
+    capture.release();
+}
@@ -25,6 +25,10 @@
 #include <iostream>
 #include <cstdio>
 #include "opencv2/opencv.hpp"
+#include "FramePool.h"
+#include "Metrics.h"
+#include "StripedBackgroundSubtractor.h"
+#include "BackgroundModels.h"
 
 // configuration parameters
 #define NUM_COMNMAND_LINE_ARGUMENTS 1
@@ -41,10 +45,34 @@ int main(int argc, char **argv)
     // store video capture parameters
     std::string fileName;
 
+    // run without display or pacing if requested
+    bool benchMode = extractFlag(argc, argv, "--bench");
+
+    // write metrics to a file instead of printing per frame timing, if requested
+    std::string metricsPath;
+    bool metricsEnabled = extractOption(argc, argv, "--metrics", metricsPath);
+
+    // split the background model into stripes, and optionally downscale it
+    std::string optionValue;
+    int numStripes = 0;
+    double modelScale = 1.0;
+    if(extractOption(argc, argv, "--stripes", optionValue))
+    {
+        numStripes = std::atoi(optionValue.c_str());
+    }
+    if(extractOption(argc, argv, "--model-scale", optionValue))
+    {
+        modelScale = std::atof(optionValue.c_str());
+    }
+
+    // select the background model
+    std::string modelType = "mog2";
+    extractOption(argc, argv, "--model", modelType);
+
     // validate and parse the command line arguments
     if(argc != NUM_COMNMAND_LINE_ARGUMENTS + 1)
     {
-        std::printf("USAGE: %s <file_path> \n", argv[0]);
+        std::printf("USAGE: %s <file_path> [--model=<mog2|average|median|vibe>] [--stripes=<count>] [--model-scale=<fraction>] [--bench] [--metrics=<path>] \n", argv[0]);
         return 0;
     }
     else
@@ -67,53 +95,73 @@ int main(int argc, char **argv)
     std::cout << "Video source opened successfully (width=" << captureWidth << " height=" << captureHeight << " fps=" << captureFPS << ")!" << std::endl;
 
     // create image window
-    cv::namedWindow("captureFrame", cv::WINDOW_AUTOSIZE);
-	cv::namedWindow("fgMask", cv::WINDOW_AUTOSIZE);
+    if(!benchMode)
+    {
+        cv::namedWindow("captureFrame", cv::WINDOW_AUTOSIZE);
+        cv::namedWindow("fgMask", cv::WINDOW_AUTOSIZE);
+    }
 
 	// set background filtering parameters
     const int bgHistory = 200;
     const float bgThreshold = 500;
     const bool bgShadowDetection = false;
-    cv::Mat fgMask; //fg mask generated by MOG2 method
-    cv::Ptr<cv::BackgroundSubtractor> pMOG2; //MOG2 Background subtractor
-    pMOG2 = cv::createBackgroundSubtractorMOG2(bgHistory, bgThreshold, bgShadowDetection);
+    cv::Mat fgMask; //fg mask generated by the background model
+    if(createBackgroundModel(modelType, bgHistory, bgThreshold, bgShadowDetection).empty())
+    {
+        std::printf("Unknown background model %s, expected mog2, average, median, or vibe \n", modelType.c_str());
+        return 0;
+    }
+    StripedBackgroundSubtractor pMOG2(numStripes, modelScale, bgHistory, bgThreshold, bgShadowDetection, modelType); //striped Background subtractor
+    std::printf("Background subtraction with %s on %d stripes, model scale %.2f \n", pMOG2.getModelType().c_str(), pMOG2.getNumStripes(), pMOG2.getModelScale());
+
+    // register the frame metrics, written to a file in the background if requested
+    MetricsRegistry metrics("cv_pmog");
+    MetricsCounter &framesTotal = metrics.counter("frames_total", "Frames processed");
+    MetricsHistogram &frameSeconds = metrics.histogram("frame_seconds", "Frame processing time in seconds");
+    MetricsCounter &captureFailures = metrics.counter("capture_failures_total", "Frames that could not be read");
+    if(metricsEnabled)
+    {
+        metrics.startDumping(metricsPath);
+    }
+
+    // recycle frame buffers between iterations
+    FramePool framePool;
 
     // process data until program termination
     bool doCapture = true;
     int frameCount = 0;
+    double benchStartTicks = static_cast<double>(cv::getTickCount());
     while(doCapture)
     {
         // get the start time
         double startTicks = static_cast<double>(cv::getTickCount());
 
         // attempt to acquire and process an image frame
-        cv::Mat captureFrame;
-        cv::Mat grayFrame;
-        //cv::Mat processedFrame;
-        bool captureSuccess = capture.read(captureFrame);
+        FrameHandle captureFrame = framePool.acquire(cv::Size(captureWidth, captureHeight), CV_8UC3);
+        bool captureSuccess = capture.read(captureFrame.mat());
         if(captureSuccess)
         {
-			// pre-process the raw image frame
-            const int rangeMin = 0;
-            const int rangeMax = 255;
-            cv::cvtColor(captureFrame, grayFrame, cv::COLOR_BGR2GRAY);
-            cv::normalize(grayFrame, grayFrame, rangeMin, rangeMax, cv::NORM_MINMAX, CV_8UC1);
-
-			// extract the foreground mask from image
-			pMOG2->apply(grayFrame, fgMask);
+			// convert and normalize the raw image frame and extract the foreground mask, one stripe per thread
+			pMOG2.apply(captureFrame.mat(), fgMask);
 
             // increment the frame counter
             frameCount++;
         }
+        else if(benchMode)
+        {
+            // stop at the end of the video when benchmarking
+            doCapture = false;
+        }
         else
         {
+            captureFailures.add();
             std::printf("Unable to acquire image frame! \n");
         }
 
         // update the GUI window if necessary
-        if(captureSuccess)
+        if(captureSuccess && !benchMode)
         {
-            cv::imshow("captureFrame", captureFrame);
+            cv::imshow("captureFrame", captureFrame.mat());
 			cv::imshow("fgMask", fgMask);
 
             // get the number of milliseconds per frame
@@ -129,9 +177,20 @@ int main(int argc, char **argv)
         // compute the frame processing time
         double endTicks = static_cast<double>(cv::getTickCount());
         double elapsedTime = (endTicks - startTicks) / cv::getTickFrequency();
-        std::cout << "Frame processing time: " << elapsedTime << std::endl;
+        if(captureSuccess)
+        {
+            frameSeconds.record(elapsedTime);
+            framesTotal.add();
+        }
     }
 
+    // report the throughput and latency distribution
+    double benchElapsedTime = (static_cast<double>(cv::getTickCount()) - benchStartTicks) / cv::getTickFrequency();
+    frameSeconds.printSummary("cv_pmog", benchElapsedTime);
+
+    // report frame buffer reuse
+    std::printf("Frame buffers: %d pooled, %lld allocations over %d frames \n", static_cast<int>(framePool.getSize()), framePool.getAllocationCount(), frameCount);
+
     // release program resources before returning
     capture.release();
     cv::destroyAllWindows();
@@ -0,0 +1,130 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file BoundedQueue.h
+ * @brief Header file for the BoundedQueue class
+ *
+ * A fixed capacity blocking queue for passing work between threads. Producers block while the queue is full, which
+ * propagates backpressure to the start of a pipeline.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+/*******************************************************************************************************************//**
+ * @class BoundedQueue
+ *
+ * @brief Blocking queue with a fixed capacity that can be closed to release waiting threads
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+template <typename T>
+class BoundedQueue
+{
+private:
+
+    std::deque<T> m_items;
+    size_t m_capacity;
+    bool m_closed;
+    std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+
+public:
+
+    /***************************************************************************************************************//**
+     * @brief Class constructor
+     * @param[in] capacity maximum number of queued items
+     * @author Christopher D. McMurrough
+     ******************************************************************************************************************/
+    explicit BoundedQueue(size_t capacity) : m_capacity(capacity > 0 ? capacity : 1), m_closed(false)
+    {
+    }
+
+    /***************************************************************************************************************//**
+     * @brief Add an item, blocking while the queue is full
+     * @param[in] item the item to add
+     * @return false if the queue was closed before the item could be added
+     * @author Christopher D. McMurrough
+     ******************************************************************************************************************/
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFull.wait(lock, [this] { return m_closed || m_items.size() < m_capacity; });
+        if(m_closed)
+        {
+            return false;
+        }
+        m_items.push_back(std::move(item));
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    /***************************************************************************************************************//**
+     * @brief Remove the oldest item, blocking while the queue is empty
+     * @param[out] item the removed item
+     * @return false if the queue is closed and no items remain
+     * @author Christopher D. McMurrough
+     ******************************************************************************************************************/
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+        if(m_items.empty())
+        {
+            return false;
+        }
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    /***************************************************************************************************************//**
+     * @brief Close the queue, pending items can still be removed but no new items are accepted
+     * @author Christopher D. McMurrough
+     ******************************************************************************************************************/
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notEmpty.notify_all();
+        m_notFull.notify_all();
+    }
+
+    /***************************************************************************************************************//**
+     * @brief Close the queue and discard any pending items
+     * @author Christopher D. McMurrough
+     ******************************************************************************************************************/
+    void abort()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_items.clear();
+        m_notEmpty.notify_all();
+        m_notFull.notify_all();
+    }
+};
+
+#endif // BOUNDED_QUEUE_H
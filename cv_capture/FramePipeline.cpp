@@ -0,0 +1,270 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file FramePipeline.cpp
+ * @brief Implementation of the FramePipeline class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#include "FramePipeline.h"
+#include "BoundedQueue.h"
+
+#include <cstdio>
+#include <map>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+/*******************************************************************************************************************//**
+ * @brief Add a single timing sample
+ * @param[in] ms the sample duration in milliseconds
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void StageTiming::add(double ms)
+{
+    count++;
+    totalMs += ms;
+    maxMs = std::max(maxMs, ms);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Combine the samples of another timing record into this one
+ * @param[in] other the timing record to merge
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void StageTiming::merge(const StageTiming &other)
+{
+    count += other.count;
+    totalMs += other.totalMs;
+    maxMs = std::max(maxMs, other.maxMs);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the mean sample duration
+ * @return the mean duration in milliseconds
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+double StageTiming::meanMs() const
+{
+    return count > 0 ? totalMs / count : 0.0;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Convert a tick count interval to milliseconds
+ * @param[in] startTicks the interval start tick count
+ * @param[in] endTicks the interval end tick count
+ * @return the interval duration in milliseconds
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+static double ticksToMs(int64 startTicks, int64 endTicks)
+{
+    return static_cast<double>(endTicks - startTicks) * 1000.0 / cv::getTickFrequency();
+}
+
+/*******************************************************************************************************************//**
+ * @brief Class constructor
+ * @param[in] numWorkers number of processing threads (default: 2)
+ * @param[in] queueCapacity capacity of the queues between stages (default: 4)
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+FramePipeline::FramePipeline(int numWorkers, size_t queueCapacity)
+{
+    m_numWorkers = std::max(numWorkers, 1);
+    m_queueCapacity = std::max<size_t>(queueCapacity, 1);
+    m_maxInFlight = static_cast<long long>(m_numWorkers + 2 * m_queueCapacity);
+    m_stop = false;
+    m_emitted = 0;
+    m_droppedFrames = 0;
+    m_elapsedSeconds = 0.0;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Signal every stage to stop and wake the decode thread if it is waiting for frames to drain
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void FramePipeline::requestStop()
+{
+    std::lock_guard<std::mutex> lock(m_flowMutex);
+    m_stop = true;
+    m_flowCondition.notify_all();
+}
+
+/*******************************************************************************************************************//**
+ * @brief Run the pipeline until the source is exhausted or the sink requests termination
+ *
+ * The process function is called concurrently from every worker thread and must not modify shared state. The sink is
+ * called on the calling thread in frame order, and only for frames that were processed successfully.
+ *
+ * @param[in] source function that acquires the next frame, returning false at the end of the stream
+ * @param[in] process function that processes a single frame
+ * @param[in] sink function that consumes a processed frame, returning false to stop the pipeline
+ * @return true if at least one frame was delivered to the sink
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool FramePipeline::run(const SourceFunction &source, const ProcessFunction &process, const SinkFunction &sink)
+{
+    // reset the pipeline state
+    m_stop = false;
+    m_emitted = 0;
+    m_droppedFrames = 0;
+    m_decodeTiming = StageTiming();
+    m_decodeWaitTiming = StageTiming();
+    m_processTiming = StageTiming();
+    m_sinkTiming = StageTiming();
+    m_latencyTiming = StageTiming();
+    int64 startTicks = cv::getTickCount();
+
+    BoundedQueue<PipelineFrame> inputQueue(m_queueCapacity);
+    BoundedQueue<PipelineFrame> outputQueue(m_queueCapacity);
+    std::atomic<int> activeWorkers(m_numWorkers);
+
+    // acquire frames until the source is exhausted, waiting whenever too many frames are in flight
+    std::thread decodeThread([&]()
+    {
+        for(long long index = 0; !m_stop; index++)
+        {
+            int64 waitTicks = cv::getTickCount();
+            {
+                std::unique_lock<std::mutex> lock(m_flowMutex);
+                m_flowCondition.wait(lock, [&]() { return m_stop || index - m_emitted < m_maxInFlight; });
+            }
+            if(m_stop)
+            {
+                break;
+            }
+
+            PipelineFrame frame;
+            frame.image = m_pool.acquire();
+            frame.index = index;
+            frame.success = false;
+            frame.captureTicks = cv::getTickCount();
+            m_decodeWaitTiming.add(ticksToMs(waitTicks, frame.captureTicks));
+            if(!source(frame.image.mat()))
+            {
+                break;
+            }
+            m_decodeTiming.add(ticksToMs(frame.captureTicks, cv::getTickCount()));
+
+            if(!inputQueue.push(std::move(frame)))
+            {
+                break;
+            }
+        }
+        inputQueue.close();
+    });
+
+    // process frames in any order, the last worker to finish closes the output queue
+    std::vector<std::thread> workers;
+    for(int i = 0; i < m_numWorkers; i++)
+    {
+        workers.push_back(std::thread([&]()
+        {
+            StageTiming timing;
+            PipelineFrame frame;
+            while(inputQueue.pop(frame))
+            {
+                int64 processTicks = cv::getTickCount();
+                frame.processed = m_pool.acquire();
+                frame.success = process(frame.image.mat(), frame.processed.mat());
+                frame.image.release();
+                timing.add(ticksToMs(processTicks, cv::getTickCount()));
+                if(!outputQueue.push(std::move(frame)))
+                {
+                    break;
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_timingMutex);
+                m_processTiming.merge(timing);
+            }
+            if(--activeWorkers == 0)
+            {
+                outputQueue.close();
+            }
+        }));
+    }
+
+    // restore frame order and deliver frames to the sink on this thread
+    std::map<long long, PipelineFrame> pending;
+    long long nextIndex = 0;
+    PipelineFrame frame;
+    while(outputQueue.pop(frame))
+    {
+        long long index = frame.index;
+        pending[index] = std::move(frame);
+
+        std::map<long long, PipelineFrame>::iterator it;
+        while(!m_stop && (it = pending.find(nextIndex)) != pending.end())
+        {
+            if(it->second.success)
+            {
+                int64 sinkTicks = cv::getTickCount();
+                bool keepRunning = sink(it->second);
+                int64 endTicks = cv::getTickCount();
+                m_sinkTiming.add(ticksToMs(sinkTicks, endTicks));
+                m_latencyTiming.add(ticksToMs(it->second.captureTicks, endTicks));
+                if(!keepRunning)
+                {
+                    requestStop();
+                    inputQueue.abort();
+                    outputQueue.abort();
+                }
+            }
+            else
+            {
+                m_droppedFrames++;
+            }
+            pending.erase(it);
+            nextIndex++;
+
+            // allow the decode thread to acquire another frame
+            std::lock_guard<std::mutex> lock(m_flowMutex);
+            m_emitted = nextIndex;
+            m_flowCondition.notify_all();
+        }
+    }
+
+    // wait for every stage to exit
+    requestStop();
+    inputQueue.abort();
+    decodeThread.join();
+    for(size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+    m_elapsedSeconds = ticksToMs(startTicks, cv::getTickCount()) / 1000.0;
+
+    return m_sinkTiming.count > 0;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Print the throughput and per stage timing of the last run
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void FramePipeline::printStatistics() const
+{
+    double fps = m_elapsedSeconds > 0.0 ? m_sinkTiming.count / m_elapsedSeconds : 0.0;
+    std::printf("Pipeline: %d workers, %lld frames displayed, %lld dropped, %.2f s, %.2f fps \n", m_numWorkers, m_sinkTiming.count, m_droppedFrames, m_elapsedSeconds, fps);
+    std::printf("  %-12s %10s %10s \n", "stage", "mean (ms)", "max (ms)");
+    std::printf("  %-12s %10.3f %10.3f \n", "decode", m_decodeTiming.meanMs(), m_decodeTiming.maxMs);
+    std::printf("  %-12s %10.3f %10.3f \n", "backpressure", m_decodeWaitTiming.meanMs(), m_decodeWaitTiming.maxMs);
+    std::printf("  %-12s %10.3f %10.3f \n", "process", m_processTiming.meanMs(), m_processTiming.maxMs);
+    std::printf("  %-12s %10.3f %10.3f \n", "display", m_sinkTiming.meanMs(), m_sinkTiming.maxMs);
+    std::printf("  %-12s %10.3f %10.3f \n", "latency", m_latencyTiming.meanMs(), m_latencyTiming.maxMs);
+    std::printf("Frame buffers: %d pooled, %lld allocations \n", static_cast<int>(m_pool.getSize()), m_pool.getAllocationCount());
+}
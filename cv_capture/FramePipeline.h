@@ -0,0 +1,125 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file FramePipeline.h
+ * @brief Header file for the FramePipeline class
+ *
+ * Runs frame acquisition, processing, and display as separate pipeline stages connected by bounded queues
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "opencv2/opencv.hpp"
+#include "FramePool.h"
+
+/*******************************************************************************************************************//**
+ * @brief A single frame passing through the pipeline
+ **********************************************************************************************************************/
+struct PipelineFrame
+{
+    long long index;
+    FrameHandle image;
+    FrameHandle processed;
+    bool success;
+    int64 captureTicks;
+};
+
+/*******************************************************************************************************************//**
+ * @brief Accumulated timing for a single pipeline stage
+ **********************************************************************************************************************/
+struct StageTiming
+{
+    long long count;
+    double totalMs;
+    double maxMs;
+
+    StageTiming() : count(0), totalMs(0.0), maxMs(0.0) {}
+    void add(double ms);
+    void merge(const StageTiming &other);
+    double meanMs() const;
+};
+
+/*******************************************************************************************************************//**
+ * @class FramePipeline
+ *
+ * @brief Class for running a staged decode, process, and display pipeline
+ *
+ * A decode thread acquires frames from the source and hands them to a pool of processing workers. Processed frames
+ * are reordered and passed to the sink on the calling thread, so GUI functions such as imshow and waitKey may be used
+ * from the sink. The number of frames in flight is bounded; when processing or display falls behind, the decode thread
+ * blocks instead of buffering frames without limit. Frame buffers are recycled through a FramePool, so once every
+ * buffer in flight has been allocated the pipeline does not allocate image memory.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class FramePipeline
+{
+public:
+
+    // stage callbacks
+    typedef std::function<bool(cv::Mat&)> SourceFunction;
+    typedef std::function<bool(const cv::Mat&, cv::Mat&)> ProcessFunction;
+    typedef std::function<bool(const PipelineFrame&)> SinkFunction;
+
+private:
+
+    // pipeline settings
+    int m_numWorkers;
+    size_t m_queueCapacity;
+    long long m_maxInFlight;
+
+    // flow control state
+    std::atomic<bool> m_stop;
+    std::mutex m_flowMutex;
+    std::condition_variable m_flowCondition;
+    long long m_emitted;
+
+    // recycled frame buffers
+    FramePool m_pool;
+
+    // stage timing
+    std::mutex m_timingMutex;
+    StageTiming m_decodeTiming;
+    StageTiming m_decodeWaitTiming;
+    StageTiming m_processTiming;
+    StageTiming m_sinkTiming;
+    StageTiming m_latencyTiming;
+    long long m_droppedFrames;
+    double m_elapsedSeconds;
+
+    // helper functions
+    void requestStop();
+
+public:
+
+    // constructors
+    FramePipeline(int numWorkers=2, size_t queueCapacity=4);
+
+    // pipeline control
+    bool run(const SourceFunction &source, const ProcessFunction &process, const SinkFunction &sink);
+    void printStatistics() const;
+};
+
+#endif // FRAME_PIPELINE_H
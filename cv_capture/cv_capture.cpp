@@ -25,9 +25,14 @@
 #include <iostream>
 #include <cstdio>
 #include "opencv2/opencv.hpp"
+#include "FramePipeline.h"
+#include "Metrics.h"
 
 // configuration parameters
 #define NUM_COMNMAND_LINE_ARGUMENTS 1
+#define DEFAULT_NUM_WORKERS 2
+#define PIPELINE_QUEUE_CAPACITY 4
+#define MAX_CAPTURE_FAILURES 30
 #define DISPLAY_WINDOW_NAME "Camera Image"
 
 // capture settings
@@ -55,8 +60,8 @@ bool processFrame(const cv::Mat &imageIn, cv::Mat &imageOut);
  **********************************************************************************************************************/
 bool processFrame(const cv::Mat &imageIn, cv::Mat &imageOut)
 {
-    // copy the input image frame to the ouput image (deep copy)
-    imageOut = imageIn.clone();
+    // copy the input image frame to the ouput image (deep copy, reusing the output buffer if it has the same size)
+    imageIn.copyTo(imageOut);
 
     // copy the input image frame to the ouput image (shallow copy, if you just want to display)
     //imageOut = imageIn;
@@ -76,17 +81,26 @@ int main(int argc, char **argv)
 {
     // store video capture parameters
     int cameraIndex = 0;
+    int numWorkers = DEFAULT_NUM_WORKERS;
+
+    // write metrics to a file instead of printing per frame timing, if requested
+    std::string metricsPath;
+    bool metricsEnabled = extractOption(argc, argv, "--metrics", metricsPath);
 
     // validate and parse the command line arguments
-    if(argc != NUM_COMNMAND_LINE_ARGUMENTS + 1)
+    if(argc != NUM_COMNMAND_LINE_ARGUMENTS + 1 && argc != NUM_COMNMAND_LINE_ARGUMENTS + 2)
     {
-        std::printf("USAGE: %s <camera_index> \n", argv[0]);
+        std::printf("USAGE: %s <camera_index> [num_workers] [--metrics=<path>] \n", argv[0]);
         std::printf("WARNING: Proceeding with default execution parameters... \n");
         cameraIndex = 0;
     }
     else
     {
         cameraIndex = atoi(argv[1]);
+        if(argc == NUM_COMNMAND_LINE_ARGUMENTS + 2)
+        {
+            numWorkers = atoi(argv[2]);
+        }
     }
 
     // display the OpenCV vesion
@@ -121,48 +135,53 @@ int main(int argc, char **argv)
     // create image window
     cv::namedWindow(DISPLAY_WINDOW_NAME, cv::WINDOW_AUTOSIZE);
 
-    // process data until program termination
-    bool doCapture = true;
-    int frameCount = 0;
-    while(doCapture)
+    // register the frame metrics, written to a file in the background if requested
+    MetricsRegistry metrics("cv_capture");
+    MetricsCounter &framesTotal = metrics.counter("frames_total", "Frames processed");
+    MetricsHistogram &frameSeconds = metrics.histogram("frame_seconds", "Frame processing time in seconds");
+    if(metricsEnabled)
     {
-        // get the start time
-        double startTicks = static_cast<double>(cv::getTickCount());
-
-        // attempt to acquire and process an image frame
-        cv::Mat captureFrame;
-        cv::Mat processedFrame;
-        bool captureSuccess = capture.read(captureFrame);
-        if(captureSuccess)
-        {
-            // process the image frame
-            processFrame(captureFrame, processedFrame);
+        metrics.startDumping(metricsPath);
+    }
 
-            // increment the frame counter
-            frameCount++;
-        }
-        else
+    // acquire frames on the decode thread, a live camera may drop a frame so only repeated failures end the pipeline
+    FramePipeline::SourceFunction source = [&capture](cv::Mat &captureFrame)
+    {
+        for(int failures = 0; failures < MAX_CAPTURE_FAILURES; failures++)
         {
+            if(capture.read(captureFrame))
+            {
+                return true;
+            }
             std::printf("Unable to acquire image frame! \n");
         }
+        std::printf("Unable to acquire %d frames in a row, terminating program! \n", MAX_CAPTURE_FAILURES);
+        return false;
+    };
 
-        // update the GUI window if necessary
-        if(captureSuccess)
-        {
-            cv::imshow(DISPLAY_WINDOW_NAME, processedFrame);
+    // display processed frames in order on the main thread
+    int frameCount = 0;
+    FramePipeline::SinkFunction sink = [&frameCount, &framesTotal, &frameSeconds](const PipelineFrame &frame)
+    {
+        // increment the frame counter
+        frameCount++;
+        framesTotal.add();
 
-            // check for program termination
-            if(((char) cv::waitKey(1)) == 'q')
-            {
-                doCapture = false;
-            }
-        }
+        // update the GUI window
+        cv::imshow(DISPLAY_WINDOW_NAME, frame.processed.mat());
 
         // compute the frame processing time
-        double endTicks = static_cast<double>(cv::getTickCount());
-        double elapsedTime = (endTicks - startTicks) / cv::getTickFrequency();
-        std::cout << "Frame processing time: " << elapsedTime << std::endl;
-    }
+        double elapsedTime = (static_cast<double>(cv::getTickCount()) - frame.captureTicks) / cv::getTickFrequency();
+        frameSeconds.record(elapsedTime);
+
+        // check for program termination
+        return ((char) cv::waitKey(1)) != 'q';
+    };
+
+    // process data until program termination
+    FramePipeline pipeline(numWorkers, PIPELINE_QUEUE_CAPACITY);
+    pipeline.run(source, processFrame, sink);
+    pipeline.printStatistics();
 
     // release program resources before returning
     capture.release();
@@ -25,9 +25,13 @@
 #include <iostream>
 #include <cstdio>
 #include "opencv2/opencv.hpp"
+#include "FramePipeline.h"
+#include "Metrics.h"
 
 // configuration parameters
 #define NUM_COMNMAND_LINE_ARGUMENTS 1
+#define DEFAULT_NUM_WORKERS 2
+#define PIPELINE_QUEUE_CAPACITY 4
 #define DISPLAY_WINDOW_NAME "Video Frame"
 
 // declare function prototypes
@@ -42,8 +46,8 @@ bool processFrame(const cv::Mat &imageIn, cv::Mat &imageOut);
  **********************************************************************************************************************/
 bool processFrame(const cv::Mat &imageIn, cv::Mat &imageOut)
 {
-    // copy the input image frame to the ouput image (deep copy)
-    imageOut = imageIn.clone();
+    // copy the input image frame to the ouput image (deep copy, reusing the output buffer if it has the same size)
+    imageIn.copyTo(imageOut);
 
     // copy the input image frame to the ouput image (shallow copy, if you just want to display)
     //imageOut = imageIn;
@@ -63,16 +67,28 @@ int main(int argc, char **argv)
 {
     // store video capture parameters
     std::string fileName;
+    int numWorkers = DEFAULT_NUM_WORKERS;
+
+    // run without display or pacing if requested
+    bool benchMode = extractFlag(argc, argv, "--bench");
+
+    // write metrics to a file instead of printing per frame timing, if requested
+    std::string metricsPath;
+    bool metricsEnabled = extractOption(argc, argv, "--metrics", metricsPath);
 
     // validate and parse the command line arguments
-    if(argc != NUM_COMNMAND_LINE_ARGUMENTS + 1)
+    if(argc != NUM_COMNMAND_LINE_ARGUMENTS + 1 && argc != NUM_COMNMAND_LINE_ARGUMENTS + 2)
     {
-        std::printf("USAGE: %s <file_path> \n", argv[0]);
+        std::printf("USAGE: %s <file_path> [num_workers] [--bench] [--metrics=<path>] \n", argv[0]);
         return 0;
     }
     else
     {
         fileName = argv[1];
+        if(argc == NUM_COMNMAND_LINE_ARGUMENTS + 2)
+        {
+            numWorkers = atoi(argv[2]);
+        }
     }
 
     // open the video file
@@ -90,53 +106,61 @@ int main(int argc, char **argv)
     std::cout << "Video source opened successfully (width=" << captureWidth << " height=" << captureHeight << " fps=" << captureFPS << ")!" << std::endl;
 
     // create image window
-    cv::namedWindow(DISPLAY_WINDOW_NAME, cv::WINDOW_AUTOSIZE);
+    if(!benchMode)
+    {
+        cv::namedWindow(DISPLAY_WINDOW_NAME, cv::WINDOW_AUTOSIZE);
+    }
 
-    // process data until program termination
-    bool doCapture = true;
-    int frameCount = 0;
-    while(doCapture)
+    // register the frame metrics, written to a file in the background if requested
+    MetricsRegistry metrics("cv_load_video");
+    MetricsCounter &framesTotal = metrics.counter("frames_total", "Frames processed");
+    MetricsHistogram &frameSeconds = metrics.histogram("frame_seconds", "Frame processing time in seconds");
+    if(metricsEnabled)
     {
-        // get the start time
-        double startTicks = static_cast<double>(cv::getTickCount());
+        metrics.startDumping(metricsPath);
+    }
 
-        // attempt to acquire and process an image frame
-        cv::Mat captureFrame;
-        cv::Mat processedFrame;
+    // acquire frames on the decode thread
+    FramePipeline::SourceFunction source = [&capture, benchMode](cv::Mat &captureFrame)
+    {
         bool captureSuccess = capture.read(captureFrame);
-        if(captureSuccess)
-        {
-            // process the image frame
-            processFrame(captureFrame, processedFrame);
-
-            // increment the frame counter
-            frameCount++;
-        }
-        else
+        if(!captureSuccess && !benchMode)
         {
             std::printf("Unable to acquire image frame! \n");
         }
+        return captureSuccess;
+    };
+
+    // display processed frames in order on the main thread
+    int frameCount = 0;
+    FramePipeline::SinkFunction sink = [&frameCount, &framesTotal, &frameSeconds, benchMode](const PipelineFrame &frame)
+    {
+        // increment the frame counter
+        frameCount++;
+        framesTotal.add();
 
-        // update the GUI window if necessary
-        if(captureSuccess)
+        // compute the frame processing time
+        double elapsedTime = (static_cast<double>(cv::getTickCount()) - frame.captureTicks) / cv::getTickFrequency();
+        frameSeconds.record(elapsedTime);
+        if(benchMode)
         {
-            cv::imshow(DISPLAY_WINDOW_NAME, processedFrame);
+            return true;
+        }
 
-            // get the number of milliseconds per frame
-            int delayMs = (1.0 / captureFPS) * 1000;
+        // update the GUI window
+        cv::imshow(DISPLAY_WINDOW_NAME, frame.processed.mat());
 
-            // check for program termination
-            if(((char) cv::waitKey(1)) == 'q')
-            {
-                doCapture = false;
-            }
-        }
+        // check for program termination
+        return ((char) cv::waitKey(1)) != 'q';
+    };
 
-        // compute the frame processing time
-        double endTicks = static_cast<double>(cv::getTickCount());
-        double elapsedTime = (endTicks - startTicks) / cv::getTickFrequency();
-        std::cout << "Frame processing time: " << elapsedTime << std::endl;
-    }
+    // process data until program termination
+    FramePipeline pipeline(numWorkers, PIPELINE_QUEUE_CAPACITY);
+    double startTicks = static_cast<double>(cv::getTickCount());
+    pipeline.run(source, processFrame, sink);
+    double elapsedTime = (static_cast<double>(cv::getTickCount()) - startTicks) / cv::getTickFrequency();
+    pipeline.printStatistics();
+    frameSeconds.printSummary("cv_load_video", elapsedTime);
 
     // release program resources before returning
     capture.release();
@@ -0,0 +1,253 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file DetectionTracker.cpp
+ * @brief Implementation of the DetectionTracker class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#include "DetectionTracker.h"
+
+#include <cmath>
+#include <algorithm>
+
+// width of the thumbnails compared for global motion
+static const int THUMBNAIL_WIDTH = 64;
+
+/*******************************************************************************************************************//**
+ * @brief Class constructor
+ * @param[in] trackerType tracker algorithm, one of "KCF", "CSRT", or "MIL"
+ * @param[in] maxInterval largest number of frames between detector runs
+ * @param[in] motionThreshold scene motion above which the detector runs on the next frame
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+DetectionTracker::DetectionTracker(const std::string &trackerType, int maxInterval, double motionThreshold) : m_trackerType(trackerType), m_maxInterval(std::max(maxInterval, 1)), m_motionThreshold(motionThreshold), m_interval(1), m_framesSinceDetection(0), m_detectionRequested(true), m_peakMotion(0.0), m_framesTotal(0), m_detectionsTotal(0)
+{
+}
+
+/*******************************************************************************************************************//**
+ * @brief Create a tracker by name
+ * @param[in] trackerType tracker algorithm, one of "KCF", "CSRT", or "MIL"
+ * @return the tracker, empty if the name is unknown
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+cv::Ptr<cv::Tracker> DetectionTracker::createTracker(const std::string &trackerType)
+{
+    if(trackerType == "CSRT")
+    {
+        return cv::TrackerCSRT::create();
+    }
+    if(trackerType == "KCF")
+    {
+        return cv::TrackerKCF::create();
+    }
+    if(trackerType == "MIL")
+    {
+        return cv::TrackerMIL::create();
+    }
+    return cv::Ptr<cv::Tracker>();
+}
+
+/*******************************************************************************************************************//**
+ * @brief Check whether the next frame should be passed to the detector
+ * @return true if the detector should run on the next frame
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool DetectionTracker::needsDetection() const
+{
+    return m_detectionRequested || m_framesSinceDetection >= m_interval;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Pass the next frame to the detector, used when frames were skipped and the tracked boxes are stale
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void DetectionTracker::requestDetection()
+{
+    m_detectionRequested = true;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Restart tracking from the detections of a frame
+ * @param[in] frame the frame the detector ran on
+ * @param[in] detections the detections of the frame
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void DetectionTracker::reset(const cv::Mat &frame, const std::vector<Detection> &detections)
+{
+    // lengthen the interval after a quiet interval, a busy one has already shortened it
+    if(!m_detectionRequested && m_peakMotion < m_motionThreshold)
+    {
+        m_interval = std::min(m_interval + 1, m_maxInterval);
+    }
+    m_framesSinceDetection = 0;
+    m_detectionRequested = false;
+    m_peakMotion = 0.0;
+    m_framesTotal++;
+    m_detectionsTotal++;
+    measureFrameMotion(frame);
+
+    // start one tracker per detection in parallel, since initialization dominates the cost of the slower trackers
+    m_tracks.clear();
+    for(size_t i = 0; i < detections.size(); i++)
+    {
+        if(detections[i].box.area() > 0)
+        {
+            m_tracks.push_back(detections[i]);
+        }
+    }
+    m_trackers.resize(m_tracks.size());
+    m_updated.assign(m_tracks.size(), 1);
+    cv::parallel_for_(cv::Range(0, static_cast<int>(m_tracks.size())), [&](const cv::Range &range)
+    {
+        for(int i = range.start; i < range.end; i++)
+        {
+            m_trackers[i] = createTracker(m_trackerType);
+            m_trackers[i]->init(frame, m_tracks[i].box);
+        }
+    });
+}
+
+/*******************************************************************************************************************//**
+ * @brief Update every tracker with a new frame
+ * @param[in] frame the new frame
+ * @param[out] detectionsOut the tracked objects, keeping the class and confidence of their detections
+ * @return true if every tracker kept its target
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool DetectionTracker::track(const cv::Mat &frame, std::vector<Detection> &detectionsOut)
+{
+    m_framesTotal++;
+    m_framesSinceDetection++;
+
+    // update the trackers in parallel
+    m_updatedBoxes.resize(m_tracks.size());
+    m_updated.resize(m_tracks.size());
+    cv::parallel_for_(cv::Range(0, static_cast<int>(m_tracks.size())), [&](const cv::Range &range)
+    {
+        for(int i = range.start; i < range.end; i++)
+        {
+            m_updatedBoxes[i] = m_tracks[i].box;
+            m_updated[i] = m_trackers[i]->update(frame, m_updatedBoxes[i]) ? 1 : 0;
+        }
+    });
+
+    // measure how far the tracked boxes moved relative to their size
+    bool allTracked = true;
+    double motion = measureFrameMotion(frame);
+    for(size_t i = 0; i < m_tracks.size(); i++)
+    {
+        if(!m_updated[i])
+        {
+            allTracked = false;
+            continue;
+        }
+        const cv::Rect &previous = m_tracks[i].box;
+        const cv::Rect &current = m_updatedBoxes[i];
+        double dx = (current.x + current.width * 0.5) - (previous.x + previous.width * 0.5);
+        double dy = (current.y + current.height * 0.5) - (previous.y + previous.height * 0.5);
+        double size = std::sqrt(static_cast<double>(std::max(previous.area(), 1)));
+        motion = std::max(motion, std::sqrt(dx * dx + dy * dy) / size);
+        m_tracks[i].box = current;
+    }
+    m_peakMotion = std::max(m_peakMotion, motion);
+
+    // detect again on the next frame if a target was lost or the scene is changing quickly
+    if(!allTracked || motion > m_motionThreshold)
+    {
+        m_detectionRequested = true;
+        m_interval = std::max(m_interval / 2, 1);
+    }
+
+    // report the objects that are still tracked
+    detectionsOut.clear();
+    for(size_t i = 0; i < m_tracks.size(); i++)
+    {
+        if(m_updated[i])
+        {
+            detectionsOut.push_back(m_tracks[i]);
+        }
+    }
+    return allTracked;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Measure the global change between a frame and the previous frame
+ * @param[in] frame the new frame
+ * @return the mean absolute thumbnail difference, from 0 to 1
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+double DetectionTracker::measureFrameMotion(const cv::Mat &frame)
+{
+    if(frame.empty())
+    {
+        return 0.0;
+    }
+    cv::cvtColor(frame, m_grey, cv::COLOR_BGR2GRAY);
+    int thumbnailHeight = std::max(1, THUMBNAIL_WIDTH * frame.rows / std::max(frame.cols, 1));
+    cv::resize(m_grey, m_thumbnail, cv::Size(THUMBNAIL_WIDTH, thumbnailHeight), 0, 0, cv::INTER_AREA);
+
+    double motion = 0.0;
+    if(m_previousThumbnail.size() == m_thumbnail.size())
+    {
+        cv::absdiff(m_thumbnail, m_previousThumbnail, m_difference);
+        motion = cv::mean(m_difference)[0] / 255.0;
+    }
+    cv::swap(m_thumbnail, m_previousThumbnail);
+    return motion;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the current detection interval
+ * @return the number of frames between detector runs
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+int DetectionTracker::getInterval() const
+{
+    return m_interval;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the number of frames seen
+ * @return the number of detected and tracked frames
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+long long DetectionTracker::getFrameCount() const
+{
+    return m_framesTotal;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the number of frames the detector ran on
+ * @return the number of detected frames
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+long long DetectionTracker::getDetectionCount() const
+{
+    return m_detectionsTotal;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the fraction of frames the detector ran on
+ * @return the detector duty cycle, from 0 to 1
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+double DetectionTracker::getDutyCycle() const
+{
+    return m_framesTotal > 0 ? static_cast<double>(m_detectionsTotal) / m_framesTotal : 0.0;
+}
@@ -0,0 +1,100 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file DetectionTracker.h
+ * @brief Header file for the DetectionTracker class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#ifndef DETECTION_TRACKER_H
+#define DETECTION_TRACKER_H
+
+#include <vector>
+#include <string>
+#include "opencv2/opencv.hpp"
+#include <opencv2/tracking.hpp>
+#include "YoloDecoder.h"
+
+/*******************************************************************************************************************//**
+ * @class DetectionTracker
+ *
+ * @brief Class for carrying detections across the frames between detector runs with object trackers
+ *
+ * One tracker is started on every detection, and all trackers are updated in parallel on the following frames. A new
+ * detection is requested once the detection interval has passed, as soon as any tracker loses its target, or when the
+ * scene motion rises above the motion threshold. Motion is the larger of the tracked box displacement, relative to the
+ * box size, and the mean difference between thumbnails of consecutive frames, which also catches objects entering an
+ * otherwise empty scene. The interval grows by one frame after every quiet interval and halves whenever the motion
+ * threshold is exceeded, up to the configured maximum.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class DetectionTracker
+{
+private:
+
+    // tracker settings
+    std::string m_trackerType;
+    int m_maxInterval;
+    double m_motionThreshold;
+
+    // tracked objects
+    std::vector<cv::Ptr<cv::Tracker> > m_trackers;
+    std::vector<Detection> m_tracks;
+    std::vector<cv::Rect> m_updatedBoxes;
+    std::vector<unsigned char> m_updated;
+
+    // detection scheduling
+    int m_interval;
+    int m_framesSinceDetection;
+    bool m_detectionRequested;
+    double m_peakMotion;
+
+    // frame thumbnails for global motion
+    cv::Mat m_grey;
+    cv::Mat m_thumbnail;
+    cv::Mat m_previousThumbnail;
+    cv::Mat m_difference;
+
+    // statistics
+    long long m_framesTotal;
+    long long m_detectionsTotal;
+
+    // helper functions
+    double measureFrameMotion(const cv::Mat &frame);
+
+public:
+
+    // constructors
+    DetectionTracker(const std::string &trackerType="KCF", int maxInterval=10, double motionThreshold=0.05);
+
+    // tracking
+    bool needsDetection() const;
+    void requestDetection();
+    void reset(const cv::Mat &frame, const std::vector<Detection> &detections);
+    bool track(const cv::Mat &frame, std::vector<Detection> &detectionsOut);
+    static cv::Ptr<cv::Tracker> createTracker(const std::string &trackerType);
+
+    // accessors
+    int getInterval() const;
+    long long getFrameCount() const;
+    long long getDetectionCount() const;
+    double getDutyCycle() const;
+};
+
+#endif // DETECTION_TRACKER_H
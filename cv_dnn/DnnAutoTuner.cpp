@@ -0,0 +1,304 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file DnnAutoTuner.cpp
+ * @brief Implementation of the DnnAutoTuner class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#include "DnnAutoTuner.h"
+#include <opencv2/core/ocl.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+/*******************************************************************************************************************//**
+ * @brief Update a 64 bit FNV-1a hash with a block of bytes
+ * @param[in] hash the current hash value
+ * @param[in] data pointer to the bytes
+ * @param[in] size number of bytes
+ * @return the updated hash value
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+static unsigned long long updateHash(unsigned long long hash, const char *data, size_t size)
+{
+    for(size_t i = 0; i < size; i++)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Format a hash value as hexadecimal text
+ * @param[in] hash the hash value
+ * @return the hash as 16 hexadecimal digits
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+static std::string formatHash(unsigned long long hash)
+{
+    char text[17];
+    std::snprintf(text, sizeof(text), "%016llx", hash);
+    return text;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Class constructor
+ * @param[in] cachePath path of the text file storing previous tuning decisions
+ * @param[in] warmupRuns number of untimed forward passes before timing each configuration
+ * @param[in] timedRuns number of timed forward passes per configuration
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+DnnAutoTuner::DnnAutoTuner(const std::string &cachePath, int warmupRuns, int timedRuns) : m_cachePath(cachePath), m_warmupRuns(std::max(warmupRuns, 0)), m_timedRuns(std::max(timedRuns, 1))
+{
+}
+
+/*******************************************************************************************************************//**
+ * @brief Select and apply the fastest backend and target for a network
+ * @param[in,out] network the network to configure
+ * @param[in] run function running a single forward pass with a representative input
+ * @param[in] modelKey identifies the model and its input, see ModelCache::getModelKey
+ * @param[out] configOut the applied configuration
+ * @param[in] forceTuning ignore any cached decision and tune again
+ * @return true if a working configuration was applied
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool DnnAutoTuner::tune(cv::dnn::Net &network, const RunFunction &run, const std::string &modelKey, DnnConfiguration &configOut, bool forceTuning)
+{
+    const std::string key = modelKey + "-" + getMachineKey();
+
+    // apply the cached decision if there is one
+    if(!forceTuning && findCached(key, configOut))
+    {
+        network.setPreferableBackend(configOut.backend);
+        network.setPreferableTarget(configOut.target);
+        std::printf("DNN configuration loaded from %s: %s / %s (%.2f ms) \n", m_cachePath.c_str(), getBackendName(configOut.backend).c_str(), getTargetName(configOut.target).c_str(), configOut.meanSeconds * 1000.0);
+        return true;
+    }
+
+    // time every available configuration
+    std::vector<std::pair<cv::dnn::Backend, cv::dnn::Target> > available = cv::dnn::getAvailableBackends();
+    bool haveOpenCL = cv::ocl::haveOpenCL();
+    bool found = false;
+    std::printf("Tuning DNN backend and target (%d warm-up, %d timed runs each) \n", m_warmupRuns, m_timedRuns);
+    for(size_t i = 0; i < available.size(); i++)
+    {
+        int backend = available[i].first;
+        int target = available[i].second;
+        bool openCLTarget = target == cv::dnn::DNN_TARGET_OPENCL || target == cv::dnn::DNN_TARGET_OPENCL_FP16;
+        if(openCLTarget && !haveOpenCL)
+        {
+            continue;
+        }
+
+        double meanSeconds = timeConfiguration(network, run, backend, target);
+        if(meanSeconds < 0.0)
+        {
+            std::printf("  %-20s %-12s failed \n", getBackendName(backend).c_str(), getTargetName(target).c_str());
+            continue;
+        }
+        std::printf("  %-20s %-12s %10.2f ms \n", getBackendName(backend).c_str(), getTargetName(target).c_str(), meanSeconds * 1000.0);
+        if(!found || meanSeconds < configOut.meanSeconds)
+        {
+            configOut.backend = backend;
+            configOut.target = target;
+            configOut.meanSeconds = meanSeconds;
+            found = true;
+        }
+    }
+
+    // fall back to the default configuration if nothing could be timed
+    if(!found)
+    {
+        configOut.backend = cv::dnn::DNN_BACKEND_DEFAULT;
+        configOut.target = cv::dnn::DNN_TARGET_CPU;
+        configOut.meanSeconds = 0.0;
+        network.setPreferableBackend(configOut.backend);
+        network.setPreferableTarget(configOut.target);
+        std::printf("DNN tuning failed, using the default backend on the CPU \n");
+        return false;
+    }
+
+    // apply and remember the fastest configuration
+    network.setPreferableBackend(configOut.backend);
+    network.setPreferableTarget(configOut.target);
+    storeCached(key, configOut);
+    std::printf("DNN configuration selected: %s / %s \n", getBackendName(configOut.backend).c_str(), getTargetName(configOut.target).c_str());
+    return true;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Measure the mean forward time of a single configuration
+ * @param[in,out] network the network to run
+ * @param[in] run function running a single forward pass
+ * @param[in] backend the backend to use
+ * @param[in] target the target to use
+ * @return the mean forward time in seconds, or a negative value if the configuration failed
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+double DnnAutoTuner::timeConfiguration(cv::dnn::Net &network, const RunFunction &run, int backend, int target) const
+{
+    try
+    {
+        network.setPreferableBackend(backend);
+        network.setPreferableTarget(target);
+
+        // the first runs include network setup and kernel compilation
+        for(int i = 0; i < m_warmupRuns; i++)
+        {
+            run(network);
+        }
+
+        double startTicks = static_cast<double>(cv::getTickCount());
+        for(int i = 0; i < m_timedRuns; i++)
+        {
+            run(network);
+        }
+        return (static_cast<double>(cv::getTickCount()) - startTicks) / cv::getTickFrequency() / m_timedRuns;
+    }
+    catch(const cv::Exception &)
+    {
+        return -1.0;
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Look up a previous decision in the cache file
+ * @param[in] key the cache key
+ * @param[out] configOut the cached configuration
+ * @return true if the key was found
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool DnnAutoTuner::findCached(const std::string &key, DnnConfiguration &configOut) const
+{
+    std::ifstream cacheFile(m_cachePath.c_str());
+    std::string line;
+    bool found = false;
+    while(std::getline(cacheFile, line))
+    {
+        // later entries replace earlier ones for the same key
+        std::istringstream fields(line);
+        std::string entryKey;
+        DnnConfiguration entry;
+        if((fields >> entryKey >> entry.backend >> entry.target >> entry.meanSeconds) && entryKey == key)
+        {
+            configOut = entry;
+            found = true;
+        }
+    }
+    return found;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Append a decision to the cache file
+ * @param[in] key the cache key
+ * @param[in] config the configuration to store
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void DnnAutoTuner::storeCached(const std::string &key, const DnnConfiguration &config) const
+{
+    std::ofstream cacheFile(m_cachePath.c_str(), std::ios::app);
+    if(!cacheFile)
+    {
+        std::printf("Unable to write DNN tuning cache %s \n", m_cachePath.c_str());
+        return;
+    }
+    cacheFile << key << " " << config.backend << " " << config.target << " " << config.meanSeconds << std::endl;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get a key identifying the current machine and OpenCV build
+ * @return the machine key
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+std::string DnnAutoTuner::getMachineKey()
+{
+    // get the host name
+    std::string hostName = "unknown";
+#ifdef _WIN32
+    const char *computerName = std::getenv("COMPUTERNAME");
+    if(computerName != 0)
+    {
+        hostName = computerName;
+    }
+#else
+    char nameBuffer[256];
+    if(gethostname(nameBuffer, sizeof(nameBuffer)) == 0)
+    {
+        nameBuffer[sizeof(nameBuffer) - 1] = '\0';
+        hostName = nameBuffer;
+    }
+#endif
+    std::replace(hostName.begin(), hostName.end(), ' ', '_');
+
+    // combine it with the processor count and the OpenCV build configuration
+    const std::string buildInformation = cv::getBuildInformation();
+    std::ostringstream key;
+    key << hostName << "-" << cv::getNumberOfCPUs() << "cpu-" << CV_VERSION << "-" << formatHash(updateHash(14695981039346656037ULL, buildInformation.data(), buildInformation.size()));
+    return key.str();
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get a readable name for a DNN backend
+ * @param[in] backend the backend identifier
+ * @return the backend name
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+std::string DnnAutoTuner::getBackendName(int backend)
+{
+    switch(backend)
+    {
+        case cv::dnn::DNN_BACKEND_DEFAULT: return "DEFAULT";
+        case cv::dnn::DNN_BACKEND_HALIDE: return "HALIDE";
+        case cv::dnn::DNN_BACKEND_INFERENCE_ENGINE: return "INFERENCE_ENGINE";
+        case cv::dnn::DNN_BACKEND_OPENCV: return "OPENCV";
+        case cv::dnn::DNN_BACKEND_VKCOM: return "VKCOM";
+        case cv::dnn::DNN_BACKEND_CUDA: return "CUDA";
+        default: return "BACKEND_" + std::to_string(backend);
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get a readable name for a DNN target
+ * @param[in] target the target identifier
+ * @return the target name
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+std::string DnnAutoTuner::getTargetName(int target)
+{
+    switch(target)
+    {
+        case cv::dnn::DNN_TARGET_CPU: return "CPU";
+        case cv::dnn::DNN_TARGET_OPENCL: return "OPENCL";
+        case cv::dnn::DNN_TARGET_OPENCL_FP16: return "OPENCL_FP16";
+        case cv::dnn::DNN_TARGET_MYRIAD: return "MYRIAD";
+        case cv::dnn::DNN_TARGET_VULKAN: return "VULKAN";
+        case cv::dnn::DNN_TARGET_FPGA: return "FPGA";
+        case cv::dnn::DNN_TARGET_CUDA: return "CUDA";
+        case cv::dnn::DNN_TARGET_CUDA_FP16: return "CUDA_FP16";
+        default: return "TARGET_" + std::to_string(target);
+    }
+}
@@ -0,0 +1,90 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file DnnAutoTuner.h
+ * @brief Header file for the DnnAutoTuner class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#ifndef DNN_AUTO_TUNER_H
+#define DNN_AUTO_TUNER_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "opencv2/opencv.hpp"
+#include <opencv2/dnn.hpp>
+
+/*******************************************************************************************************************//**
+ * @brief A backend and target pair and its measured forward time
+ **********************************************************************************************************************/
+struct DnnConfiguration
+{
+    int backend;
+    int target;
+    double meanSeconds;
+};
+
+/*******************************************************************************************************************//**
+ * @class DnnAutoTuner
+ *
+ * @brief Class for selecting the fastest backend and target for a network on the current machine
+ *
+ * Every backend and target pair reported by OpenCV is timed on the actual network and input, after a few warm-up
+ * runs, and the fastest is applied. OpenCL targets are skipped when no OpenCL device is present, so a missing GPU never
+ * causes a silent fallback. The decision is stored in a small text cache keyed by the model file paths, sizes, and
+ * modification times, the input, and the machine, so later launches apply it without tuning.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class DnnAutoTuner
+{
+public:
+
+    // runs a single forward pass on the network, including setting its input
+    typedef std::function<void(cv::dnn::Net&)> RunFunction;
+
+private:
+
+    // tuning settings
+    std::string m_cachePath;
+    int m_warmupRuns;
+    int m_timedRuns;
+
+    // helper functions
+    bool findCached(const std::string &key, DnnConfiguration &configOut) const;
+    void storeCached(const std::string &key, const DnnConfiguration &config) const;
+    double timeConfiguration(cv::dnn::Net &network, const RunFunction &run, int backend, int target) const;
+
+public:
+
+    // constructors
+    DnnAutoTuner(const std::string &cachePath="dnn_tuning.cache", int warmupRuns=2, int timedRuns=5);
+
+    // tuning
+    bool tune(cv::dnn::Net &network, const RunFunction &run, const std::string &modelKey, DnnConfiguration &configOut, bool forceTuning=false);
+
+    // cache key helpers
+    static std::string getMachineKey();
+
+    // naming helpers
+    static std::string getBackendName(int backend);
+    static std::string getTargetName(int target);
+};
+
+#endif // DNN_AUTO_TUNER_H
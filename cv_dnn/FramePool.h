@@ -0,0 +1,128 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file FramePool.h
+ * @brief Header file for the FramePool and FrameHandle classes
+ *
+ * A pool of recycled image buffers. Each buffer keeps the size and type of its last use, so reading or copying a frame
+ * of the same shape into a recycled buffer reuses its memory instead of allocating a new one.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include "opencv2/opencv.hpp"
+
+class FramePool;
+
+/*******************************************************************************************************************//**
+ * @brief A pooled image buffer and its reference count
+ **********************************************************************************************************************/
+struct FrameSlot
+{
+    cv::Mat buffer;
+    const uchar *lastData;
+    std::atomic<int> references;
+};
+
+/*******************************************************************************************************************//**
+ * @class FrameHandle
+ *
+ * @brief Reference counted handle to a pooled image buffer, the buffer returns to the pool when the last handle is
+ * released
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class FrameHandle
+{
+    friend class FramePool;
+
+private:
+
+    FramePool *m_pool;
+    FrameSlot *m_slot;
+
+    FrameHandle(FramePool *pool, FrameSlot *slot);
+
+public:
+
+    // constructors
+    FrameHandle();
+    FrameHandle(const FrameHandle &other);
+    FrameHandle(FrameHandle &&other);
+    FrameHandle& operator=(const FrameHandle &other);
+    FrameHandle& operator=(FrameHandle &&other);
+    ~FrameHandle();
+
+    // accessors
+    cv::Mat& mat() const;
+    bool empty() const;
+
+    // utility functions
+    void release();
+};
+
+/*******************************************************************************************************************//**
+ * @class FramePool
+ *
+ * @brief Class for recycling image buffers between frames
+ *
+ * The pool grows when every buffer is in use, so the number of buffers settles at the number of frames that are alive
+ * at once. Buffers are counted as allocated whenever their data pointer changes between uses, which makes any
+ * allocation on the steady state processing path visible through getAllocationCount. Buffers of different shapes can
+ * share a pool when they are acquired with their size and type, which picks a free buffer of that shape if there is one.
+ * The pool must outlive every handle acquired from it.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class FramePool
+{
+    friend class FrameHandle;
+
+private:
+
+    // pool state
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<FrameSlot> > m_slots;
+    std::vector<FrameSlot*> m_free;
+    std::atomic<long long> m_allocations;
+
+    // helper functions
+    void release(FrameSlot *slot);
+
+public:
+
+    // constructors
+    FramePool(size_t initialSize=0);
+
+    // buffer access
+    FrameHandle acquire();
+    FrameHandle acquire(const cv::Size &size, int type);
+
+    // accessors
+    size_t getSize() const;
+    long long getAllocationCount() const;
+};
+
+#endif // FRAME_POOL_H
@@ -0,0 +1,165 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file InferencePipeline.cpp
+ * @brief Implementation of the InferencePipeline class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#include "InferencePipeline.h"
+#include "BoundedQueue.h"
+
+#include <cstdio>
+#include <thread>
+#include <algorithm>
+
+/*******************************************************************************************************************//**
+ * @brief Get the number of seconds elapsed since a tick count
+ * @param[in] startTicks the starting tick count
+ * @return the elapsed time in seconds
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+static double secondsSince(double startTicks)
+{
+    return (static_cast<double>(cv::getTickCount()) - startTicks) / cv::getTickFrequency();
+}
+
+/*******************************************************************************************************************//**
+ * @brief Class constructor
+ * @param[in] queueCapacity number of frames that may wait between two stages
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+InferencePipeline::InferencePipeline(size_t queueCapacity) : m_queueCapacity(std::max<size_t>(queueCapacity, 1)), m_stop(false), m_elapsedSeconds(0.0)
+{
+}
+
+/*******************************************************************************************************************//**
+ * @brief Run the pipeline until the source is exhausted or a stage ends the run
+ * @param[in] preprocess acquires the next frame into the frame image and fills the blob, runs on its own thread
+ * @param[in] infer runs the network on the blob and fills the outputs, runs on its own thread
+ * @param[in] postprocess consumes the outputs in frame order, runs on the calling thread
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void InferencePipeline::run(const StageFunction &preprocess, const StageFunction &infer, const StageFunction &postprocess)
+{
+    m_stop = false;
+    m_preprocessTiming.reset();
+    m_inferenceTiming.reset();
+    m_postprocessTiming.reset();
+    m_latency.reset();
+    BoundedQueue<InferenceFrame> inferQueue(m_queueCapacity);
+    BoundedQueue<InferenceFrame> postQueue(m_queueCapacity);
+    double startTicks = static_cast<double>(cv::getTickCount());
+
+    // acquire and preprocess frames until the source is exhausted
+    std::thread preprocessThread([&]()
+    {
+        long long index = 0;
+        while(!m_stop)
+        {
+            InferenceFrame frame;
+            frame.index = index++;
+            frame.image = m_pool.acquire();
+            frame.captureTicks = static_cast<double>(cv::getTickCount());
+            frame.inferenceSeconds = 0.0;
+            bool success = preprocess(frame);
+            m_preprocessTiming.record(secondsSince(frame.captureTicks));
+            if(!success || !inferQueue.push(std::move(frame)))
+            {
+                break;
+            }
+        }
+        inferQueue.close();
+    });
+
+    // run the network on each frame in turn
+    std::thread inferThread([&]()
+    {
+        InferenceFrame frame;
+        while(inferQueue.pop(frame))
+        {
+            double inferStartTicks = static_cast<double>(cv::getTickCount());
+            bool success = infer(frame);
+            frame.inferenceSeconds = secondsSince(inferStartTicks);
+            m_inferenceTiming.record(frame.inferenceSeconds);
+            if(!success)
+            {
+                m_stop = true;
+                inferQueue.abort();
+                break;
+            }
+            if(!postQueue.push(std::move(frame)))
+            {
+                break;
+            }
+        }
+        postQueue.close();
+    });
+
+    // postprocess on the calling thread so that the stage may use the GUI
+    InferenceFrame frame;
+    while(postQueue.pop(frame))
+    {
+        double postStartTicks = static_cast<double>(cv::getTickCount());
+        bool success = postprocess(frame);
+        m_postprocessTiming.record(secondsSince(postStartTicks));
+        m_latency.record(secondsSince(frame.captureTicks));
+        frame = InferenceFrame();
+        if(!success)
+        {
+            m_stop = true;
+            inferQueue.abort();
+            postQueue.abort();
+            break;
+        }
+    }
+
+    // wait for the stage threads to finish
+    preprocessThread.join();
+    inferThread.join();
+    m_elapsedSeconds = secondsSince(startTicks);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the duration of the last run
+ * @return the elapsed time in seconds
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+double InferencePipeline::getElapsedSeconds() const
+{
+    return m_elapsedSeconds;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Print the per stage timing of the last run
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void InferencePipeline::printStatistics() const
+{
+    long long frames = m_latency.getCount();
+    double fps = m_elapsedSeconds > 0.0 ? frames / m_elapsedSeconds : 0.0;
+    double slowestStage = std::max(m_preprocessTiming.getMean(), std::max(m_inferenceTiming.getMean(), m_postprocessTiming.getMean()));
+    double stageBoundFps = slowestStage > 0.0 ? 1.0 / slowestStage : 0.0;
+    std::printf("Inference pipeline: %lld frames, %.2f s, %.2f fps (slowest stage bound %.2f fps) \n", frames, m_elapsedSeconds, fps, stageBoundFps);
+    std::printf("  %-12s %10s %10s \n", "stage", "mean (ms)", "max (ms)");
+    std::printf("  %-12s %10.3f %10.3f \n", "preprocess", m_preprocessTiming.getMean() * 1000.0, m_preprocessTiming.getMax() * 1000.0);
+    std::printf("  %-12s %10.3f %10.3f \n", "forward", m_inferenceTiming.getMean() * 1000.0, m_inferenceTiming.getMax() * 1000.0);
+    std::printf("  %-12s %10.3f %10.3f \n", "postprocess", m_postprocessTiming.getMean() * 1000.0, m_postprocessTiming.getMax() * 1000.0);
+    std::printf("  %-12s %10.3f %10.3f \n", "latency", m_latency.getMean() * 1000.0, m_latency.getMax() * 1000.0);
+    std::printf("Frame buffers: %d pooled, %lld allocations \n", static_cast<int>(m_pool.getSize()), m_pool.getAllocationCount());
+}
@@ -0,0 +1,100 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file InferencePipeline.h
+ * @brief Header file for the InferencePipeline class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#ifndef INFERENCE_PIPELINE_H
+#define INFERENCE_PIPELINE_H
+
+#include <vector>
+#include <functional>
+#include <atomic>
+#include "opencv2/opencv.hpp"
+#include "FramePool.h"
+#include "Metrics.h"
+
+/*******************************************************************************************************************//**
+ * @brief A single frame passing through the inference pipeline
+ **********************************************************************************************************************/
+struct InferenceFrame
+{
+    long long index;
+    FrameHandle image;
+    cv::Mat blob;
+    std::vector<cv::Mat> outputs;
+    double captureTicks;
+    double inferenceSeconds;
+};
+
+/*******************************************************************************************************************//**
+ * @class InferencePipeline
+ *
+ * @brief Class for overlapping frame preprocessing, network inference, and postprocessing
+ *
+ * Each stage runs on its own thread: while the network runs the forward pass for frame N, the next frame is decoded
+ * and converted to a blob, and the previous frame is decoded and rendered. The postprocessing stage runs on the calling
+ * thread, so GUI functions such as imshow and waitKey may be used from it. Stages are connected by bounded queues, so
+ * sustained throughput approaches the rate of the slowest stage and the number of frames in flight stays fixed.
+ *
+ * The inference stage must leave outputs that do not alias network memory, since the next forward pass starts before
+ * the outputs are consumed.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class InferencePipeline
+{
+public:
+
+    // stage callbacks, returning false ends the run
+    typedef std::function<bool(InferenceFrame&)> StageFunction;
+
+private:
+
+    // pipeline settings
+    size_t m_queueCapacity;
+    std::atomic<bool> m_stop;
+
+    // recycled frame buffers
+    FramePool m_pool;
+
+    // stage timing, each histogram is only written by its own stage
+    MetricsHistogram m_preprocessTiming;
+    MetricsHistogram m_inferenceTiming;
+    MetricsHistogram m_postprocessTiming;
+    MetricsHistogram m_latency;
+    double m_elapsedSeconds;
+
+public:
+
+    // constructors
+    InferencePipeline(size_t queueCapacity=2);
+
+    // pipeline control
+    void run(const StageFunction &preprocess, const StageFunction &infer, const StageFunction &postprocess);
+
+    // accessors
+    double getElapsedSeconds() const;
+
+    // reporting
+    void printStatistics() const;
+};
+
+#endif // INFERENCE_PIPELINE_H
@@ -0,0 +1,167 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file LetterboxInput.cpp
+ * @brief Implementation of the LetterboxInput class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#include "LetterboxInput.h"
+#include <opencv2/dnn.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+
+/*******************************************************************************************************************//**
+ * @brief Map a box in normalized network input coordinates back to frame coordinates
+ * @param[in] left left edge as a fraction of the input width
+ * @param[in] top top edge as a fraction of the input height
+ * @param[in] right right edge as a fraction of the input width
+ * @param[in] bottom bottom edge as a fraction of the input height
+ * @return the box in frame pixels, not clipped to the frame
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+cv::Rect InputRegion::mapToFrame(float left, float top, float right, float bottom) const
+{
+    double x1 = (left * inputSize.width - padding.x) / scale + frameRect.x;
+    double y1 = (top * inputSize.height - padding.y) / scale + frameRect.y;
+    double x2 = (right * inputSize.width - padding.x) / scale + frameRect.x;
+    double y2 = (bottom * inputSize.height - padding.y) / scale + frameRect.y;
+    return cv::Rect(cv::Point(cvRound(x1), cvRound(y1)), cv::Point(cvRound(x2), cvRound(y2)));
+}
+
+/*******************************************************************************************************************//**
+ * @brief Class constructor
+ * @param[in] inputSize network input size, an empty size keeps the frame (or tile) resolution
+ * @param[in] tileCols number of tile columns
+ * @param[in] tileRows number of tile rows
+ * @param[in] overlap minimum overlap between neighbouring tiles as a fraction of the tile size
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+LetterboxInput::LetterboxInput(const cv::Size &inputSize, int tileCols, int tileRows, double overlap) : m_inputSize(inputSize), m_tileCols(std::max(tileCols, 1)), m_tileRows(std::max(tileRows, 1)), m_overlap(std::min(std::max(overlap, 0.0), 0.9))
+{
+}
+
+/*******************************************************************************************************************//**
+ * @brief Compute the input regions for a frame size
+ *
+ * Tiles are spread evenly so that the first and last tiles touch the frame edges, which gives at least the requested
+ * overlap between neighbours.
+ *
+ * @param[in] frameSize the frame size
+ * @param[out] regionsOut one region per network input image, in batch order
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void LetterboxInput::getRegions(const cv::Size &frameSize, std::vector<InputRegion> &regionsOut) const
+{
+    regionsOut.clear();
+
+    // size the tiles so that they cover the frame with the requested overlap
+    const int tileWidth = m_tileCols == 1 ? frameSize.width : static_cast<int>(std::ceil(frameSize.width / (m_tileCols - (m_tileCols - 1) * m_overlap)));
+    const int tileHeight = m_tileRows == 1 ? frameSize.height : static_cast<int>(std::ceil(frameSize.height / (m_tileRows - (m_tileRows - 1) * m_overlap)));
+    const cv::Rect frameRect(0, 0, frameSize.width, frameSize.height);
+    const cv::Size inputSize = m_inputSize.area() > 0 ? m_inputSize : cv::Size(tileWidth, tileHeight);
+
+    for(int row = 0; row < m_tileRows; row++)
+    {
+        for(int col = 0; col < m_tileCols; col++)
+        {
+            int x = m_tileCols == 1 ? 0 : cvRound(col * (frameSize.width - tileWidth) / static_cast<double>(m_tileCols - 1));
+            int y = m_tileRows == 1 ? 0 : cvRound(row * (frameSize.height - tileHeight) / static_cast<double>(m_tileRows - 1));
+
+            // fit the tile inside the input, preserving its aspect ratio, and center it
+            InputRegion region;
+            region.frameRect = cv::Rect(x, y, tileWidth, tileHeight) & frameRect;
+            region.inputSize = inputSize;
+            region.scale = std::min(inputSize.width / static_cast<double>(region.frameRect.width), inputSize.height / static_cast<double>(region.frameRect.height));
+            int scaledWidth = std::min(cvRound(region.frameRect.width * region.scale), inputSize.width);
+            int scaledHeight = std::min(cvRound(region.frameRect.height * region.scale), inputSize.height);
+            region.padding = cv::Point((inputSize.width - scaledWidth) / 2, (inputSize.height - scaledHeight) / 2);
+            regionsOut.push_back(region);
+        }
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Build the network input blob for a frame
+ * @param[in] frame the input frame
+ * @param[out] blobOut the blob holding one letterboxed image per input region
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void LetterboxInput::createBlob(const cv::Mat &frame, cv::Mat &blobOut)
+{
+    getRegions(frame.size(), m_regions);
+    m_letterboxed.resize(m_regions.size());
+    for(size_t i = 0; i < m_regions.size(); i++)
+    {
+        const InputRegion &region = m_regions[i];
+        cv::Mat &letterboxed = m_letterboxed[i];
+        letterboxed.create(region.inputSize, frame.type());
+
+        // clear the padding and scale the region into the centre of the input
+        cv::Size scaledSize(region.inputSize.width - 2 * region.padding.x, region.inputSize.height - 2 * region.padding.y);
+        if(scaledSize != region.inputSize)
+        {
+            letterboxed.setTo(cv::Scalar::all(0));
+        }
+        cv::Mat target = letterboxed(cv::Rect(region.padding, scaledSize));
+        cv::Mat source = frame(region.frameRect);
+        if(source.size() == scaledSize)
+        {
+            source.copyTo(target);
+        }
+        else
+        {
+            int interpolation = region.scale < 1.0 ? cv::INTER_AREA : cv::INTER_LINEAR;
+            cv::resize(source, target, scaledSize, 0, 0, interpolation);
+        }
+    }
+
+    // pack every region into one batch
+    cv::dnn::blobFromImages(m_letterboxed, blobOut, 1.0, cv::Size(), cv::Scalar(), true, false);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the number of tiles per frame, which is also the blob batch size
+ * @return the number of tiles
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+int LetterboxInput::getNumTiles() const
+{
+    return m_tileCols * m_tileRows;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Parse a size written as WIDTHxHEIGHT
+ * @param[in] text the size text
+ * @param[out] sizeOut the parsed size
+ * @return true if the text held two positive dimensions
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool parseSize(const std::string &text, cv::Size &sizeOut)
+{
+    int width = 0;
+    int height = 0;
+    if(std::sscanf(text.c_str(), "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)
+    {
+        return false;
+    }
+    sizeOut = cv::Size(width, height);
+    return true;
+}
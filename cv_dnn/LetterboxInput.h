@@ -0,0 +1,86 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file LetterboxInput.h
+ * @brief Header file for the LetterboxInput class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#ifndef LETTERBOX_INPUT_H
+#define LETTERBOX_INPUT_H
+
+#include <vector>
+#include <string>
+#include "opencv2/opencv.hpp"
+
+/*******************************************************************************************************************//**
+ * @brief The part of a frame fed to one image of the network input blob, and how it was scaled
+ **********************************************************************************************************************/
+struct InputRegion
+{
+    cv::Rect frameRect;
+    cv::Size inputSize;
+    double scale;
+    cv::Point padding;
+
+    cv::Rect mapToFrame(float left, float top, float right, float bottom) const;
+};
+
+/*******************************************************************************************************************//**
+ * @class LetterboxInput
+ *
+ * @brief Class for building fixed size network inputs from frames of any resolution
+ *
+ * Each frame, or each tile of a frame, is scaled to fit the network input size with its aspect ratio preserved and
+ * padded to the full input size. Tiles overlap so that objects on a tile boundary are seen whole by at least one tile,
+ * and all tiles of a frame are packed into a single blob so they run as one batch. Detections in normalized input
+ * coordinates are mapped back to the frame with InputRegion::mapToFrame.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class LetterboxInput
+{
+private:
+
+    // input settings
+    cv::Size m_inputSize;
+    int m_tileCols;
+    int m_tileRows;
+    double m_overlap;
+
+    // scratch buffers reused between frames
+    std::vector<InputRegion> m_regions;
+    std::vector<cv::Mat> m_letterboxed;
+
+public:
+
+    // constructors
+    LetterboxInput(const cv::Size &inputSize=cv::Size(), int tileCols=1, int tileRows=1, double overlap=0.2);
+
+    // input creation
+    void getRegions(const cv::Size &frameSize, std::vector<InputRegion> &regionsOut) const;
+    void createBlob(const cv::Mat &frame, cv::Mat &blobOut);
+
+    // accessors
+    int getNumTiles() const;
+};
+
+// command line helpers
+bool parseSize(const std::string &text, cv::Size &sizeOut);
+
+#endif // LETTERBOX_INPUT_H
@@ -0,0 +1,187 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file MaskCompositor.cpp
+ * @brief Implementation of the MaskCompositor class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#include "MaskCompositor.h"
+
+#include <algorithm>
+
+// label image layout: the low bits hold the instance index plus one, the high bit marks contour pixels
+static const unsigned short LABEL_EDGE_FLAG = 0x8000;
+static const unsigned short LABEL_INDEX_MASK = 0x7FFF;
+
+/*******************************************************************************************************************//**
+ * @brief Class constructor
+ * @param[in] maskThreshold mask probability above which a pixel belongs to the object
+ * @param[in] colorWeight weight of the instance color when blending it with the frame
+ * @param[in] contourThickness thickness of the mask outline in pixels
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+MaskCompositor::MaskCompositor(float maskThreshold, float colorWeight, int contourThickness) : m_maskThreshold(maskThreshold), m_colorWeight(colorWeight), m_contourThickness(contourThickness)
+{
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get a scratch image of the given size, growing the backing buffer only when it is too small
+ * @param[in, out] buffer the backing buffer
+ * @param[in] size the required size
+ * @param[in] type the required type
+ * @return a view of the top left of the buffer with the required size
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+cv::Mat MaskCompositor::getScratch(cv::Mat &buffer, const cv::Size &size, int type)
+{
+    if(buffer.type() != type || buffer.cols < size.width || buffer.rows < size.height)
+    {
+        buffer.create(std::max(buffer.rows, size.height), std::max(buffer.cols, size.width), type);
+    }
+    return buffer(cv::Rect(0, 0, size.width, size.height));
+}
+
+/*******************************************************************************************************************//**
+ * @brief Resize, threshold, and outline the mask of one instance inside its clipped box
+ * @param[in] index the instance index
+ * @param[in] instance the instance
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void MaskCompositor::prepareInstance(size_t index, const MaskInstance &instance)
+{
+    const cv::Rect &box = m_boxes[index];
+    if(box.area() <= 0)
+    {
+        return;
+    }
+
+    // resize the mask to the full box and keep the part inside the frame
+    cv::Mat resized = getScratch(m_resizedBuffers[index], instance.box.size(), CV_32F);
+    cv::resize(instance.mask, resized, instance.box.size());
+    cv::Mat visible = resized(box - instance.box.tl());
+
+    // threshold the mask
+    cv::Mat binary = getScratch(m_binaryBuffers[index], box.size(), CV_8U);
+    cv::compare(visible, m_maskThreshold, binary, cv::CMP_GT);
+
+    // outline the mask, keeping only the part of the outline inside the object
+    cv::Mat edges = getScratch(m_edgeBuffers[index], box.size(), CV_8U);
+    edges.setTo(cv::Scalar::all(0));
+    m_contours[index].clear();
+    cv::findContours(binary, m_contours[index], cv::RETR_CCOMP, cv::CHAIN_APPROX_SIMPLE);
+    cv::drawContours(edges, m_contours[index], -1, cv::Scalar::all(255), m_contourThickness, cv::LINE_8);
+    cv::bitwise_and(edges, binary, edges);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Draw the masks of all instances onto a frame
+ * @param[in, out] frame the BGR frame to draw on
+ * @param[in] instances the detected instances, drawn in order
+ * @param[in] colors the instance colors, selected by class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void MaskCompositor::composite(cv::Mat &frame, const std::vector<MaskInstance> &instances, const std::vector<cv::Scalar> &colors)
+{
+    const size_t numInstances = std::min(instances.size(), static_cast<size_t>(LABEL_INDEX_MASK));
+    if(numInstances == 0 || colors.empty())
+    {
+        return;
+    }
+
+    // clip the boxes to the frame and find the rows they cover
+    const cv::Rect frameRect(0, 0, frame.cols, frame.rows);
+    cv::Rect covered;
+    m_boxes.resize(numInstances);
+    for(size_t i = 0; i < numInstances; i++)
+    {
+        m_boxes[i] = instances[i].box & frameRect;
+        if(m_boxes[i].area() > 0)
+        {
+            covered = covered.area() > 0 ? (covered | m_boxes[i]) : m_boxes[i];
+        }
+    }
+    if(covered.area() <= 0)
+    {
+        return;
+    }
+
+    // resize, threshold, and outline every mask in parallel
+    if(m_resizedBuffers.size() < numInstances)
+    {
+        m_resizedBuffers.resize(numInstances);
+        m_binaryBuffers.resize(numInstances);
+        m_edgeBuffers.resize(numInstances);
+        m_contours.resize(numInstances);
+    }
+    cv::parallel_for_(cv::Range(0, static_cast<int>(numInstances)), [&](const cv::Range &range)
+    {
+        for(int i = range.start; i < range.end; i++)
+        {
+            prepareInstance(i, instances[i]);
+        }
+    });
+
+    // stamp the instances into the label image in drawing order
+    m_labels.create(frame.rows, frame.cols, CV_16U);
+    m_labels(covered).setTo(cv::Scalar::all(0));
+    m_labelColors.resize(numInstances + 1);
+    for(size_t i = 0; i < numInstances; i++)
+    {
+        const cv::Scalar &color = colors[instances[i].classId % colors.size()];
+        m_labelColors[i + 1] = cv::Vec3f(static_cast<float>(color[0]), static_cast<float>(color[1]), static_cast<float>(color[2]));
+        if(m_boxes[i].area() > 0)
+        {
+            cv::Mat labels = m_labels(m_boxes[i]);
+            labels.setTo(cv::Scalar::all(static_cast<double>(i + 1)), m_binaryBuffers[i](cv::Rect(cv::Point(), m_boxes[i].size())));
+            labels.setTo(cv::Scalar::all(static_cast<double>((i + 1) | LABEL_EDGE_FLAG)), m_edgeBuffers[i](cv::Rect(cv::Point(), m_boxes[i].size())));
+        }
+    }
+
+    // blend every labelled pixel with its instance color in one pass, outline pixels take the plain color
+    const float colorWeight = m_colorWeight;
+    const float frameWeight = 1.0f - m_colorWeight;
+    cv::parallel_for_(cv::Range(covered.y, covered.y + covered.height), [&](const cv::Range &range)
+    {
+        for(int y = range.start; y < range.end; y++)
+        {
+            const unsigned short *labelRow = m_labels.ptr<unsigned short>(y);
+            cv::Vec3b *pixelRow = frame.ptr<cv::Vec3b>(y);
+            for(int x = covered.x; x < covered.x + covered.width; x++)
+            {
+                const unsigned short label = labelRow[x];
+                if(label == 0)
+                {
+                    continue;
+                }
+                const cv::Vec3f &color = m_labelColors[label & LABEL_INDEX_MASK];
+                cv::Vec3b &pixel = pixelRow[x];
+                if(label & LABEL_EDGE_FLAG)
+                {
+                    pixel = cv::Vec3b(cv::saturate_cast<uchar>(color[0]), cv::saturate_cast<uchar>(color[1]), cv::saturate_cast<uchar>(color[2]));
+                }
+                else
+                {
+                    pixel[0] = cv::saturate_cast<uchar>(colorWeight * color[0] + frameWeight * pixel[0]);
+                    pixel[1] = cv::saturate_cast<uchar>(colorWeight * color[1] + frameWeight * pixel[1]);
+                    pixel[2] = cv::saturate_cast<uchar>(colorWeight * color[2] + frameWeight * pixel[2]);
+                }
+            }
+        }
+    });
+}
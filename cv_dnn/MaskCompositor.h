@@ -0,0 +1,86 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file MaskCompositor.h
+ * @brief Header file for the MaskCompositor class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#ifndef MASK_COMPOSITOR_H
+#define MASK_COMPOSITOR_H
+
+#include <vector>
+#include "opencv2/opencv.hpp"
+
+/*******************************************************************************************************************//**
+ * @brief A detected object with its box in frame coordinates and its low resolution soft mask
+ **********************************************************************************************************************/
+struct MaskInstance
+{
+    int classId;
+    float score;
+    cv::Rect box;
+    cv::Mat mask;
+};
+
+/*******************************************************************************************************************//**
+ * @class MaskCompositor
+ *
+ * @brief Class for drawing the masks of many detected objects onto a frame
+ *
+ * The masks of all instances are resized, thresholded, and outlined in parallel. Each instance then stamps its mask
+ * into a label image, and a single parallel pass over the covered rows blends every labelled pixel with its instance
+ * color. Where instances overlap, the later instance is drawn on top. All scratch images are kept between frames and
+ * only grow, so steady state compositing does not allocate.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class MaskCompositor
+{
+private:
+
+    // compositing settings
+    float m_maskThreshold;
+    float m_colorWeight;
+    int m_contourThickness;
+
+    // per instance scratch buffers, indexed by instance
+    std::vector<cv::Rect> m_boxes;
+    std::vector<cv::Mat> m_resizedBuffers;
+    std::vector<cv::Mat> m_binaryBuffers;
+    std::vector<cv::Mat> m_edgeBuffers;
+    std::vector<std::vector<std::vector<cv::Point> > > m_contours;
+
+    // frame sized label image and per label blend colors
+    cv::Mat m_labels;
+    std::vector<cv::Vec3f> m_labelColors;
+
+    // helper functions
+    static cv::Mat getScratch(cv::Mat &buffer, const cv::Size &size, int type);
+    void prepareInstance(size_t index, const MaskInstance &instance);
+
+public:
+
+    // constructors
+    MaskCompositor(float maskThreshold=0.3f, float colorWeight=0.3f, int contourThickness=5);
+
+    // compositing
+    void composite(cv::Mat &frame, const std::vector<MaskInstance> &instances, const std::vector<cv::Scalar> &colors);
+};
+
+#endif // MASK_COMPOSITOR_H
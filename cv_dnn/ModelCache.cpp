@@ -0,0 +1,380 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file ModelCache.cpp
+ * @brief Implementation of the ModelCache class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#include "ModelCache.h"
+
+#include <opencv2/core/utils/filesystem.hpp>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+// cache file layout: magic, model size, config size, model bytes, config bytes
+static const char CACHE_MAGIC[8] = {'C', 'V', 'N', 'E', 'T', 'C', '0', '1'};
+static const size_t CACHE_HEADER_SIZE = sizeof(CACHE_MAGIC) + 2 * sizeof(unsigned long long);
+
+/*******************************************************************************************************************//**
+ * @brief Read only view of a whole file, memory mapped where the platform allows it
+ **********************************************************************************************************************/
+class MappedFile
+{
+private:
+
+    const char *m_data;
+    size_t m_size;
+    std::vector<char> m_buffer;
+
+public:
+
+    MappedFile() : m_data(0), m_size(0) {}
+    ~MappedFile() { close(); }
+
+    /***************************************************************************************************************//**
+     * @brief Map a file into memory
+     * @param[in] path the file path
+     * @return true if the file was mapped
+     * @author Christopher D. McMurrough
+     ******************************************************************************************************************/
+    bool open(const std::string &path)
+    {
+        close();
+#ifndef _WIN32
+        int descriptor = ::open(path.c_str(), O_RDONLY);
+        if(descriptor < 0)
+        {
+            return false;
+        }
+        struct stat status;
+        if(fstat(descriptor, &status) != 0 || status.st_size <= 0)
+        {
+            ::close(descriptor);
+            return false;
+        }
+        void *mapping = mmap(0, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+        ::close(descriptor);
+        if(mapping == MAP_FAILED)
+        {
+            return false;
+        }
+        m_data = static_cast<const char*>(mapping);
+        m_size = static_cast<size_t>(status.st_size);
+#else
+        std::ifstream file(path.c_str(), std::ios::binary);
+        if(!file)
+        {
+            return false;
+        }
+        m_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        m_data = m_buffer.empty() ? 0 : &m_buffer[0];
+        m_size = m_buffer.size();
+#endif
+        return m_data != 0;
+    }
+
+    /***************************************************************************************************************//**
+     * @brief Release the mapping
+     * @author Christopher D. McMurrough
+     ******************************************************************************************************************/
+    void close()
+    {
+#ifndef _WIN32
+        if(m_data != 0)
+        {
+            munmap(const_cast<char*>(m_data), m_size);
+        }
+#endif
+        m_buffer.clear();
+        m_data = 0;
+        m_size = 0;
+    }
+
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+};
+
+/*******************************************************************************************************************//**
+ * @brief Class constructor
+ * @param[in] cacheDirectory directory holding the cache files
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+ModelCache::ModelCache(const std::string &cacheDirectory) : m_cacheDirectory(cacheDirectory), m_lastLoadCached(false), m_lastLoadSeconds(0.0)
+{
+}
+
+/*******************************************************************************************************************//**
+ * @brief Load a network, creating its cache entry first if there is none
+ * @param[in] framework the model framework, such as "Darknet" or "TensorFlow"
+ * @param[in] modelPath path of the model weights
+ * @param[in] configPath path of the model configuration, may be empty
+ * @return the loaded network, empty on failure
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+cv::dnn::Net ModelCache::load(const std::string &framework, const std::string &modelPath, const std::string &configPath)
+{
+    double startTicks = static_cast<double>(cv::getTickCount());
+    std::string cachePath = getCachePath(framework, modelPath, configPath);
+
+    // map the cache entry, creating it and dropping the older entries of the model if it does not exist yet
+    MappedFile mapped;
+    m_lastLoadCached = mapped.open(cachePath);
+    if(!m_lastLoadCached && cv::utils::fs::createDirectories(m_cacheDirectory) && writeCacheFile(cachePath, modelPath, configPath))
+    {
+        removeStaleEntries(modelPath, cachePath);
+        mapped.open(cachePath);
+    }
+
+    // validate the header and read the network from the mapped bytes
+    cv::dnn::Net network;
+    unsigned long long modelSize = 0;
+    unsigned long long configSize = 0;
+    if(mapped.size() >= CACHE_HEADER_SIZE && std::memcmp(mapped.data(), CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0)
+    {
+        std::memcpy(&modelSize, mapped.data() + sizeof(CACHE_MAGIC), sizeof(modelSize));
+        std::memcpy(&configSize, mapped.data() + sizeof(CACHE_MAGIC) + sizeof(modelSize), sizeof(configSize));
+    }
+    if(modelSize > 0 && CACHE_HEADER_SIZE + modelSize + configSize == mapped.size())
+    {
+        const char *model = mapped.data() + CACHE_HEADER_SIZE;
+        network = readFromBuffers(framework, model, static_cast<size_t>(modelSize), model + modelSize, static_cast<size_t>(configSize));
+    }
+    else
+    {
+        // the cache could not be used, read the source files directly
+        std::printf("Model cache %s is unusable, loading the model files directly \n", cachePath.c_str());
+        m_lastLoadCached = false;
+        network = cv::dnn::readNet(modelPath, configPath, framework);
+    }
+
+    m_lastLoadSeconds = (static_cast<double>(cv::getTickCount()) - startTicks) / cv::getTickFrequency();
+    return network;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get a key identifying a model without reading its contents
+ *
+ * The key is a hash of the framework and of the path, size, and modification time of each source file, so it changes
+ * whenever a model file is replaced and costs only a stat per file.
+ *
+ * @param[in] framework the model framework
+ * @param[in] modelPath path of the model weights
+ * @param[in] configPath path of the model configuration
+ * @return the key as hexadecimal text
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+std::string ModelCache::getModelKey(const std::string &framework, const std::string &modelPath, const std::string &configPath)
+{
+    std::ostringstream identity;
+    identity << framework;
+    const std::string *paths[2] = {&modelPath, &configPath};
+    for(int i = 0; i < 2; i++)
+    {
+        struct stat status;
+        identity << "|" << *paths[i];
+        if(!paths[i]->empty() && stat(paths[i]->c_str(), &status) == 0)
+        {
+            identity << "|" << static_cast<long long>(status.st_size) << "|" << static_cast<long long>(status.st_mtime);
+        }
+    }
+
+    // hash the identity with 64 bit FNV-1a
+    const std::string text = identity.str();
+    unsigned long long hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < text.size(); i++)
+    {
+        hash ^= static_cast<unsigned char>(text[i]);
+        hash *= 1099511628211ULL;
+    }
+
+    char hashText[17];
+    std::snprintf(hashText, sizeof(hashText), "%016llx", hash);
+    return hashText;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the cache file path for a model
+ *
+ * The name combines the model file name with the model key, see getModelKey.
+ *
+ * @param[in] framework the model framework
+ * @param[in] modelPath path of the model weights
+ * @param[in] configPath path of the model configuration
+ * @return the cache file path
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+std::string ModelCache::getCachePath(const std::string &framework, const std::string &modelPath, const std::string &configPath) const
+{
+    // name the entry after the model file
+    std::string baseName = modelPath.substr(modelPath.find_last_of("/\\") + 1);
+    return m_cacheDirectory + "/" + baseName + "-" + getModelKey(framework, modelPath, configPath) + ".netcache";
+}
+
+/*******************************************************************************************************************//**
+ * @brief Delete the cache entries of a model file other than the current one
+ *
+ * Entries of the same model file with another key were written before the model was edited or replaced, and would
+ * otherwise stay on disk as full copies of the old weights.
+ *
+ * @param[in] modelPath path of the model weights
+ * @param[in] cachePath path of the current cache entry, which is kept
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void ModelCache::removeStaleEntries(const std::string &modelPath, const std::string &cachePath) const
+{
+    // entries are named <model file>-<16 hex digit key>.netcache
+    const std::string prefix = modelPath.substr(modelPath.find_last_of("/\\") + 1) + "-";
+    const std::string suffix = ".netcache";
+    const std::string keepName = cachePath.substr(cachePath.find_last_of("/\\") + 1);
+    std::vector<cv::String> entries;
+    cv::glob(m_cacheDirectory + "/" + prefix + "*" + suffix, entries, false);
+    for(size_t i = 0; i < entries.size(); i++)
+    {
+        const std::string name = entries[i].substr(entries[i].find_last_of("/\\") + 1);
+        if(name != keepName && name.size() == prefix.size() + 16 + suffix.size() && name.compare(0, prefix.size(), prefix) == 0)
+        {
+            std::printf("Removing stale model cache %s \n", entries[i].c_str());
+            std::remove(entries[i].c_str());
+        }
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Pack the model files into a cache file
+ *
+ * The file is written under a temporary name and renamed into place, so a partially written entry is never mapped.
+ *
+ * @param[in] cachePath path of the cache file to create
+ * @param[in] modelPath path of the model weights
+ * @param[in] configPath path of the model configuration
+ * @return true if the cache file was written
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool ModelCache::writeCacheFile(const std::string &cachePath, const std::string &modelPath, const std::string &configPath)
+{
+    // read the source files
+    std::vector<char> contents[2];
+    const std::string *paths[2] = {&modelPath, &configPath};
+    for(int i = 0; i < 2; i++)
+    {
+        if(paths[i]->empty())
+        {
+            continue;
+        }
+        std::ifstream file(paths[i]->c_str(), std::ios::binary);
+        if(!file)
+        {
+            std::printf("Unable to read model file %s \n", paths[i]->c_str());
+            return false;
+        }
+        contents[i].assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    // write the packed entry
+    const std::string tempPath = cachePath + ".tmp";
+    std::ofstream output(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+    unsigned long long modelSize = contents[0].size();
+    unsigned long long configSize = contents[1].size();
+    output.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    output.write(reinterpret_cast<const char*>(&modelSize), sizeof(modelSize));
+    output.write(reinterpret_cast<const char*>(&configSize), sizeof(configSize));
+    for(int i = 0; i < 2; i++)
+    {
+        if(!contents[i].empty())
+        {
+            output.write(&contents[i][0], contents[i].size());
+        }
+    }
+    output.close();
+    if(!output)
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    if(std::rename(tempPath.c_str(), cachePath.c_str()) != 0)
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Read a network from model and configuration bytes in memory
+ * @param[in] framework the model framework
+ * @param[in] model pointer to the model weights
+ * @param[in] modelSize size of the model weights in bytes
+ * @param[in] config pointer to the model configuration
+ * @param[in] configSize size of the model configuration in bytes
+ * @return the loaded network
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+cv::dnn::Net ModelCache::readFromBuffers(const std::string &framework, const char *model, size_t modelSize, const char *config, size_t configSize)
+{
+    std::string frameworkName = framework;
+    std::transform(frameworkName.begin(), frameworkName.end(), frameworkName.begin(), ::tolower);
+
+    // the pointer based readers parse the mapped memory without copying it
+    if(frameworkName == "darknet")
+    {
+        return cv::dnn::readNetFromDarknet(config, configSize, model, modelSize);
+    }
+    if(frameworkName == "tensorflow")
+    {
+        return cv::dnn::readNetFromTensorflow(model, modelSize, configSize > 0 ? config : 0, configSize);
+    }
+
+    // other frameworks take copies of the buffers
+    std::vector<uchar> modelBuffer(model, model + modelSize);
+    std::vector<uchar> configBuffer(config, config + configSize);
+    return cv::dnn::readNet(framework, modelBuffer, configBuffer);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Check whether the last load was served from an existing cache entry
+ * @return true if the cache entry already existed
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool ModelCache::wasLastLoadCached() const
+{
+    return m_lastLoadCached;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the duration of the last load
+ * @return the load time in seconds
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+double ModelCache::getLastLoadSeconds() const
+{
+    return m_lastLoadSeconds;
+}
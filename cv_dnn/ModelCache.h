@@ -0,0 +1,76 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file ModelCache.h
+ * @brief Header file for the ModelCache class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <string>
+#include "opencv2/opencv.hpp"
+#include <opencv2/dnn.hpp>
+
+/*******************************************************************************************************************//**
+ * @class ModelCache
+ *
+ * @brief Class for loading DNN models from a packed, memory mapped cache file
+ *
+ * The model weights and configuration are packed into a single cache file the first time a model is loaded. Later
+ * launches map that file into memory and pass the mapped bytes straight to the OpenCV buffer readers, replacing
+ * separate reads of every model file. A cache entry is named after the source paths, sizes, and modification times,
+ * so editing or replacing a model file creates a new entry instead of loading stale weights. Each entry is a full copy
+ * of the weights, so the entries are kept in their own directory, and writing a new entry removes the older entries of
+ * the same model file.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class ModelCache
+{
+private:
+
+    // cache settings
+    std::string m_cacheDirectory;
+
+    // statistics of the last load
+    bool m_lastLoadCached;
+    double m_lastLoadSeconds;
+
+    // helper functions
+    std::string getCachePath(const std::string &framework, const std::string &modelPath, const std::string &configPath) const;
+    void removeStaleEntries(const std::string &modelPath, const std::string &cachePath) const;
+    static bool writeCacheFile(const std::string &cachePath, const std::string &modelPath, const std::string &configPath);
+    static cv::dnn::Net readFromBuffers(const std::string &framework, const char *model, size_t modelSize, const char *config, size_t configSize);
+
+public:
+
+    // constructors
+    ModelCache(const std::string &cacheDirectory="model_cache");
+
+    // loading
+    cv::dnn::Net load(const std::string &framework, const std::string &modelPath, const std::string &configPath);
+    static std::string getModelKey(const std::string &framework, const std::string &modelPath, const std::string &configPath);
+
+    // accessors
+    bool wasLastLoadCached() const;
+    double getLastLoadSeconds() const;
+};
+
+#endif // MODEL_CACHE_H
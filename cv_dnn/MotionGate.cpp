@@ -0,0 +1,153 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file MotionGate.cpp
+ * @brief Implementation of the MotionGate class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#include "MotionGate.h"
+
+#include <algorithm>
+
+// background filtering parameters
+static const int BG_HISTORY = 200;
+static const double BG_THRESHOLD = 16.0;
+static const bool BG_SHADOW_DETECTION = false;
+
+/*******************************************************************************************************************//**
+ * @brief Class constructor
+ * @param[in] processingWidth width the frames are downscaled to before background subtraction
+ * @param[in] minArea smallest foreground component kept, in downscaled pixels
+ * @param[in] padding padding added around each motion region, in frame pixels
+ * @param[in] minCropSize smallest width and height of a motion region, in frame pixels
+ * @param[in] fullFrameFraction fraction of the frame area above which the whole frame is returned
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+MotionGate::MotionGate(int processingWidth, int minArea, int padding, int minCropSize, double fullFrameFraction) : m_processingWidth(processingWidth), m_minArea(minArea), m_padding(padding), m_minCropSize(minCropSize), m_fullFrameFraction(fullFrameFraction)
+{
+    m_subtractor = cv::createBackgroundSubtractorMOG2(BG_HISTORY, BG_THRESHOLD, BG_SHADOW_DETECTION);
+    m_kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3));
+}
+
+/*******************************************************************************************************************//**
+ * @brief Find the moving regions of a frame
+ * @param[in] frame the BGR frame
+ * @param[out] regionsOut the non overlapping motion regions in frame coordinates
+ * @return true if anything moved
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool MotionGate::findRegions(const cv::Mat &frame, std::vector<cv::Rect> &regionsOut)
+{
+    regionsOut.clear();
+    if(frame.empty())
+    {
+        return false;
+    }
+
+    // update the background model on a downscaled copy of the frame
+    const double scale = std::min(1.0, static_cast<double>(m_processingWidth) / frame.cols);
+    cv::resize(frame, m_small, cv::Size(), scale, scale, cv::INTER_AREA);
+    cv::cvtColor(m_small, m_grey, cv::COLOR_BGR2GRAY);
+    m_subtractor->apply(m_grey, m_mask);
+
+    // remove speckle noise and label the foreground components
+    cv::morphologyEx(m_mask, m_mask, cv::MORPH_OPEN, m_kernel);
+    int numLabels = cv::connectedComponentsWithStats(m_mask, m_labels, m_stats, m_centroids, 8, CV_32S);
+
+    // scale the component boxes back to the frame and pad them, label 0 is the background
+    const cv::Size frameSize(frame.cols, frame.rows);
+    const cv::Rect frameRect(0, 0, frame.cols, frame.rows);
+    for(int i = 1; i < numLabels; i++)
+    {
+        if(m_stats.at<int>(i, cv::CC_STAT_AREA) < m_minArea)
+        {
+            continue;
+        }
+        cv::Rect region(cvFloor(m_stats.at<int>(i, cv::CC_STAT_LEFT) / scale) - m_padding,
+                        cvFloor(m_stats.at<int>(i, cv::CC_STAT_TOP) / scale) - m_padding,
+                        cvCeil(m_stats.at<int>(i, cv::CC_STAT_WIDTH) / scale) + 2 * m_padding,
+                        cvCeil(m_stats.at<int>(i, cv::CC_STAT_HEIGHT) / scale) + 2 * m_padding);
+        regionsOut.push_back(growToSize(region & frameRect, m_minCropSize, frameSize));
+    }
+    if(regionsOut.empty())
+    {
+        return false;
+    }
+
+    // merge overlapping regions so no part of the frame is detected twice
+    mergeOverlapping(regionsOut);
+
+    // fall back to the whole frame when the crops would cover most of it
+    double coveredArea = 0.0;
+    for(size_t i = 0; i < regionsOut.size(); i++)
+    {
+        coveredArea += regionsOut[i].area();
+    }
+    if(coveredArea >= m_fullFrameFraction * frameRect.area())
+    {
+        regionsOut.assign(1, frameRect);
+    }
+    return true;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Grow a region about its center to a minimum size, shifting it to stay inside the frame
+ * @param[in] region the region
+ * @param[in] minSize the minimum width and height
+ * @param[in] frameSize the frame size
+ * @return the grown region
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+cv::Rect MotionGate::growToSize(const cv::Rect &region, int minSize, const cv::Size &frameSize)
+{
+    cv::Rect grown = region;
+    const int width = std::min(std::max(region.width, minSize), frameSize.width);
+    const int height = std::min(std::max(region.height, minSize), frameSize.height);
+    grown.x = std::min(std::max(region.x + (region.width - width) / 2, 0), frameSize.width - width);
+    grown.y = std::min(std::max(region.y + (region.height - height) / 2, 0), frameSize.height - height);
+    grown.width = width;
+    grown.height = height;
+    return grown;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Replace overlapping regions with their bounding box until no two regions overlap
+ * @param[in, out] regions the regions
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void MotionGate::mergeOverlapping(std::vector<cv::Rect> &regions)
+{
+    bool merged = true;
+    while(merged)
+    {
+        merged = false;
+        for(size_t i = 0; i < regions.size() && !merged; i++)
+        {
+            for(size_t j = i + 1; j < regions.size() && !merged; j++)
+            {
+                if((regions[i] & regions[j]).area() > 0)
+                {
+                    regions[i] = regions[i] | regions[j];
+                    regions.erase(regions.begin() + j);
+                    merged = true;
+                }
+            }
+        }
+    }
+}
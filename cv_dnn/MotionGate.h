@@ -0,0 +1,79 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file MotionGate.h
+ * @brief Header file for the MotionGate class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#ifndef MOTION_GATE_H
+#define MOTION_GATE_H
+
+#include <vector>
+#include "opencv2/opencv.hpp"
+
+/*******************************************************************************************************************//**
+ * @class MotionGate
+ *
+ * @brief Class for finding the parts of a frame worth passing to a detector with background subtraction
+ *
+ * Each frame is downscaled and passed through a MOG2 background subtractor. The foreground mask is opened to remove
+ * speckle noise, and the bounding boxes of its connected components are scaled back to the frame, padded, grown to a
+ * minimum crop size so small objects keep some context, and merged until no two regions overlap. A frame without
+ * motion yields no regions and can be skipped. When the regions would cover most of the frame anyway, the whole frame
+ * is returned as a single region.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class MotionGate
+{
+private:
+
+    // gate settings
+    int m_processingWidth;
+    int m_minArea;
+    int m_padding;
+    int m_minCropSize;
+    double m_fullFrameFraction;
+
+    // background model
+    cv::Ptr<cv::BackgroundSubtractor> m_subtractor;
+
+    // scratch buffers reused between frames
+    cv::Mat m_small;
+    cv::Mat m_grey;
+    cv::Mat m_mask;
+    cv::Mat m_kernel;
+    cv::Mat m_labels;
+    cv::Mat m_stats;
+    cv::Mat m_centroids;
+
+    // helper functions
+    static cv::Rect growToSize(const cv::Rect &region, int minSize, const cv::Size &frameSize);
+    static void mergeOverlapping(std::vector<cv::Rect> &regions);
+
+public:
+
+    // constructors
+    MotionGate(int processingWidth=320, int minArea=30, int padding=16, int minCropSize=160, double fullFrameFraction=0.6);
+
+    // gating
+    bool findRegions(const cv::Mat &frame, std::vector<cv::Rect> &regionsOut);
+};
+
+#endif // MOTION_GATE_H
@@ -0,0 +1,218 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file YoloDecoder.cpp
+ * @brief Implementation of the YoloDecoder class and detection rendering
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#include "YoloDecoder.h"
+#include <algorithm>
+#include <cfloat>
+#include <opencv2/dnn.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+// number of leading columns in each output row before the class scores
+#define YOLO_BOX_COLUMNS 5
+
+/*******************************************************************************************************************//**
+ * @brief Constructor
+ * @param[in] confidenceThreshold minimum class confidence for a detection to be kept
+ * @param[in] nmsThreshold maximum overlap (intersection over union) between kept boxes of the same class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+YoloDecoder::YoloDecoder(float confidenceThreshold, float nmsThreshold) : m_confidenceThreshold(confidenceThreshold), m_nmsThreshold(nmsThreshold)
+{
+}
+
+/*******************************************************************************************************************//**
+ * @brief Decode the region layer outputs for one image
+ * @param[in] outputs the output rows of every YOLO region layer for the image
+ * @param[in] imageSize size of the image the detections are reported in
+ * @param[out] detectionsOut the detections remaining after non-maximum suppression, ordered by decreasing confidence
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void YoloDecoder::decode(const std::vector<cv::Mat> &outputs, const cv::Size &imageSize, std::vector<Detection> &detectionsOut)
+{
+    m_boxes.clear();
+    m_scores.clear();
+    m_classIds.clear();
+    detectionsOut.clear();
+
+    // collect the candidate boxes from every output layer
+    const cv::Rect imageRect(0, 0, imageSize.width, imageSize.height);
+    for(size_t i = 0; i < outputs.size(); i++)
+    {
+        const cv::Mat &output = outputs[i];
+        const int numClasses = output.cols - YOLO_BOX_COLUMNS;
+        if(output.depth() != CV_32F || numClasses <= 0)
+        {
+            continue;
+        }
+
+        for(int j = 0; j < output.rows; j++)
+        {
+            // reject the row on objectness before reading any class scores
+            const float *row = output.ptr<float>(j);
+            if(row[4] < m_confidenceThreshold)
+            {
+                continue;
+            }
+
+            // find the best class for this row
+            float confidence;
+            int classId = findMaxScore(row + YOLO_BOX_COLUMNS, numClasses, confidence);
+            if(classId < 0 || confidence < m_confidenceThreshold)
+            {
+                continue;
+            }
+
+            // convert the normalized center and size to a pixel rectangle
+            int width = static_cast<int>(row[2] * imageSize.width);
+            int height = static_cast<int>(row[3] * imageSize.height);
+            int left = static_cast<int>(row[0] * imageSize.width) - width / 2;
+            int top = static_cast<int>(row[1] * imageSize.height) - height / 2;
+            cv::Rect box = cv::Rect(left, top, width, height) & imageRect;
+            if(box.width <= 0 || box.height <= 0)
+            {
+                continue;
+            }
+
+            m_boxes.push_back(box);
+            m_scores.push_back(confidence);
+            m_classIds.push_back(classId);
+        }
+    }
+
+    // shift each class far enough apart that boxes of different classes never overlap, then suppress all at once
+    const int classOffset = std::max(imageSize.width, imageSize.height) + 1;
+    m_offsetBoxes.resize(m_boxes.size());
+    for(size_t i = 0; i < m_boxes.size(); i++)
+    {
+        m_offsetBoxes[i] = m_boxes[i] + cv::Point(m_classIds[i] * classOffset, 0);
+    }
+    cv::dnn::NMSBoxes(m_offsetBoxes, m_scores, m_confidenceThreshold, m_nmsThreshold, m_keep);
+
+    // copy out the kept detections
+    detectionsOut.reserve(m_keep.size());
+    for(size_t i = 0; i < m_keep.size(); i++)
+    {
+        Detection detection;
+        detection.box = m_boxes[m_keep[i]];
+        detection.classId = m_classIds[m_keep[i]];
+        detection.confidence = m_scores[m_keep[i]];
+        detectionsOut.push_back(detection);
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Find the highest score in a row of class scores
+ *
+ * The maximum is found four lanes at a time, and the scalar scan for its index only runs for rows that have already
+ * passed the objectness test.
+ *
+ * @param[in] scores pointer to the class scores
+ * @param[in] numScores number of class scores
+ * @param[out] maxScoreOut the highest score
+ * @return index of the first class with the highest score, or -1 if there are no scores
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+int YoloDecoder::findMaxScore(const float *scores, int numScores, float &maxScoreOut)
+{
+    maxScoreOut = 0.0f;
+    if(numScores <= 0)
+    {
+        return -1;
+    }
+
+    // find the maximum value
+    float maxScore = -FLT_MAX;
+    int i = 0;
+#if CV_SIMD128
+    const int lanes = 4;
+    if(numScores >= lanes)
+    {
+        cv::v_float32x4 maxVector = cv::v_load(scores);
+        for(i = lanes; i + lanes <= numScores; i += lanes)
+        {
+            maxVector = cv::v_max(maxVector, cv::v_load(scores + i));
+        }
+        maxScore = cv::v_reduce_max(maxVector);
+    }
+#endif
+    for(; i < numScores; i++)
+    {
+        maxScore = std::max(maxScore, scores[i]);
+    }
+
+    // locate the first class holding it
+    maxScoreOut = maxScore;
+    for(i = 0; i < numScores; i++)
+    {
+        if(scores[i] == maxScore)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the minimum class confidence for a detection to be kept
+ * @return the confidence threshold
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+float YoloDecoder::getConfidenceThreshold() const
+{
+    return m_confidenceThreshold;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the maximum overlap between kept boxes of the same class
+ * @return the non-maximum suppression threshold
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+float YoloDecoder::getNmsThreshold() const
+{
+    return m_nmsThreshold;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Draw labelled boxes for a list of detections
+ * @param[in,out] image the image to annotate
+ * @param[in] detections the detections to draw
+ * @param[in] classNames class label names, indexed by class id
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void drawDetections(cv::Mat &image, const std::vector<Detection> &detections, const std::vector<std::string> &classNames)
+{
+    for(size_t i = 0; i < detections.size(); i++)
+    {
+        const Detection &detection = detections[i];
+        cv::rectangle(image, detection.box, cv::Scalar(0, 128, 255), 2, 8, 0);
+
+        // label the box with its class and confidence
+        const char *className = "unknown";
+        if(detection.classId >= 0 && detection.classId < static_cast<int>(classNames.size()))
+        {
+            className = classNames[detection.classId].c_str();
+        }
+        std::string label = cv::format("%s %.2f", className, detection.confidence);
+        cv::putText(image, label, detection.box.tl(), cv::FONT_HERSHEY_PLAIN, 1.5, cv::Scalar(0, 255, 255), 2);
+    }
+}
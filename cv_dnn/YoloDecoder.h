@@ -0,0 +1,87 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file YoloDecoder.h
+ * @brief Header file for decoding YOLO region outputs into a compact list of detections
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#ifndef YOLO_DECODER_H
+#define YOLO_DECODER_H
+
+#include <vector>
+#include <string>
+#include "opencv2/opencv.hpp"
+
+/*******************************************************************************************************************//**
+ * @brief A single detected object in image coordinates
+ **********************************************************************************************************************/
+struct Detection
+{
+    cv::Rect box;
+    int classId;
+    float confidence;
+};
+
+/*******************************************************************************************************************//**
+ * @class YoloDecoder
+ *
+ * @brief Class for converting YOLO region layer outputs into detections
+ *
+ * Each output row is laid out as [center_x, center_y, width, height, objectness, class_1_score, ..., class_N_score]
+ * with coordinates normalized to the image size. Rows are rejected on objectness before any class score is read, since
+ * a class score can never exceed the objectness of its row. The remaining rows are scanned for their best class with
+ * SIMD instructions, and overlapping boxes of the same class are suppressed in a single batched NMS call by offsetting
+ * each class into its own region of the plane. Scratch buffers are kept between calls so steady state decoding does
+ * not allocate.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class YoloDecoder
+{
+private:
+
+    // decoding parameters
+    float m_confidenceThreshold;
+    float m_nmsThreshold;
+
+    // scratch buffers reused between calls
+    std::vector<cv::Rect> m_boxes;
+    std::vector<cv::Rect> m_offsetBoxes;
+    std::vector<float> m_scores;
+    std::vector<int> m_classIds;
+    std::vector<int> m_keep;
+
+public:
+
+    // constructors
+    YoloDecoder(float confidenceThreshold=0.5f, float nmsThreshold=0.4f);
+
+    // decoding
+    void decode(const std::vector<cv::Mat> &outputs, const cv::Size &imageSize, std::vector<Detection> &detectionsOut);
+    static int findMaxScore(const float *scores, int numScores, float &maxScoreOut);
+
+    // accessors
+    float getConfidenceThreshold() const;
+    float getNmsThreshold() const;
+};
+
+// rendering
+void drawDetections(cv::Mat &image, const std::vector<Detection> &detections, const std::vector<std::string> &classNames);
+
+#endif // YOLO_DECODER_H
@@ -27,12 +27,20 @@
 #include <sstream>
 #include <iostream>
 #include <cstdio>
+#include <algorithm>
 #include <string.h>
 
 #include <opencv2/dnn.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
 
+#include "Metrics.h"
+#include "InferencePipeline.h"
+#include "DnnAutoTuner.h"
+#include "ModelCache.h"
+#include "LetterboxInput.h"
+#include "MaskCompositor.h"
+
 
 using namespace cv;
 using namespace dnn;
@@ -41,21 +49,28 @@ using namespace std;
 // Initialize the parameters
 float confThreshold = 0.5; // Confidence threshold
 float maskThreshold = 0.3; // Mask threshold
+float tileOverlapThreshold = 0.5; // Overlap above which detections from neighbouring tiles are merged
 
 vector<string> classes;
 vector<Scalar> colors;
 
-// Draw the predicted bounding box
-void drawBox(Mat& frame, int classId, float conf, Rect box, Mat& objectMask);
+// Draw the predicted bounding box and its label
+void drawBox(Mat& frame, int classId, float conf, Rect box);
+
+// Extract the detections of every input region in frame coordinates, merging duplicates from overlapping tiles
+void extractInstances(const vector<Mat>& outs, const vector<InputRegion>& regions, vector<MaskInstance>& instances);
 
 // Postprocess the neural network's output for each frame
-void postprocess(Mat& frame, const vector<Mat>& outs);
+void postprocess(Mat& frame, const vector<Mat>& outs, const vector<InputRegion>& regions, MaskCompositor& compositor);
 
 
 
 // configuration parameters
 #define NUM_COMNMAND_LINE_ARGUMENTS 1
 #define DISPLAY_WINDOW_NAME "Video Frame"
+#define PIPELINE_QUEUE_CAPACITY 2
+#define DEFAULT_TUNING_CACHE "dnn_tuning.cache"
+#define DEFAULT_MODEL_CACHE_DIRECTORY "model_cache"
 
 /*******************************************************************************************************************//**
  * @brief program entry point
@@ -66,14 +81,63 @@ void postprocess(Mat& frame, const vector<Mat>& outs);
  **********************************************************************************************************************/
 int main(int argc, char **argv)
 {
+    // time the startup from launch to the first processed frame
+    double programStartTicks = static_cast<double>(cv::getTickCount());
+
     // store video capture parameters
     std::string fileName;
     int trackerSelection = 0;
 
+    // run without display or pacing if requested
+    bool benchMode = extractFlag(argc, argv, "--bench");
+
+    // overlap preprocessing, inference, and postprocessing on separate threads if requested
+    bool pipelineMode = extractFlag(argc, argv, "--pipeline");
+
+    // select the DNN backend and target by timing them, or reuse the cached decision
+    std::string tuningCachePath = DEFAULT_TUNING_CACHE;
+    extractOption(argc, argv, "--tuning-cache", tuningCachePath);
+    bool forceTuning = extractFlag(argc, argv, "--retune");
+
+    // load the model through the packed model cache
+    std::string modelCacheDirectory = DEFAULT_MODEL_CACHE_DIRECTORY;
+    extractOption(argc, argv, "--model-cache", modelCacheDirectory);
+
+    // set the network input size and tiling, by default the whole frame is used at its own resolution
+    std::string optionValue;
+    cv::Size inputSize;
+    int tileCols = 1;
+    int tileRows = 1;
+    double tileOverlap = 0.2;
+    if(extractOption(argc, argv, "--input-size", optionValue) && !parseSize(optionValue, inputSize))
+    {
+        std::printf("Invalid input size %s, expected <width>x<height> \n", optionValue.c_str());
+        return 0;
+    }
+    if(extractOption(argc, argv, "--tiles", optionValue))
+    {
+        cv::Size tiles;
+        if(!parseSize(optionValue, tiles))
+        {
+            std::printf("Invalid tiling %s, expected <columns>x<rows> \n", optionValue.c_str());
+            return 0;
+        }
+        tileCols = tiles.width;
+        tileRows = tiles.height;
+    }
+    if(extractOption(argc, argv, "--tile-overlap", optionValue))
+    {
+        tileOverlap = atof(optionValue.c_str());
+    }
+
+    // write metrics to a file instead of printing per frame timing, if requested
+    std::string metricsPath;
+    bool metricsEnabled = extractOption(argc, argv, "--metrics", metricsPath);
+
     // validate and parse the command line arguments
     if(argc != NUM_COMNMAND_LINE_ARGUMENTS + 1)
     {
-        std::printf("USAGE: %s <file_path> \n", argv[0]);
+        std::printf("USAGE: %s <file_path> [--input-size=<width>x<height>] [--tiles=<columns>x<rows>] [--tile-overlap=<fraction>] [--pipeline] [--tuning-cache=<path>] [--retune] [--model-cache=<dir>] [--bench] [--metrics=<path>] \n", argv[0]);
         return 0;
     }
     else
@@ -96,7 +160,10 @@ int main(int argc, char **argv)
     std::cout << "Video source opened successfully (width=" << captureWidth << " height=" << captureHeight << " fps=" << captureFPS << ")!" << std::endl;
 
     // create image window
-    cv::namedWindow(DISPLAY_WINDOW_NAME, cv::WINDOW_AUTOSIZE);
+    if(!benchMode)
+    {
+        cv::namedWindow(DISPLAY_WINDOW_NAME, cv::WINDOW_AUTOSIZE);
+    }
 
 
 
@@ -127,9 +194,33 @@ int main(int argc, char **argv)
 	std::string modelWeights = "./mask_rcnn_inception_v2_coco_2018_01_28/frozen_inference_graph.pb";
 
 	// load the DNN network
-	cv::dnn::Net network = readNetFromTensorflow(modelWeights, textGraph);
-	network.setPreferableBackend(DNN_BACKEND_OPENCV);
-	network.setPreferableTarget(DNN_TARGET_CPU);
+	ModelCache modelCache(modelCacheDirectory);
+	cv::dnn::Net network = modelCache.load("TensorFlow", modelWeights, textGraph);
+	std::printf("Model loaded in %.1f ms (%s) \n", modelCache.getLastLoadSeconds() * 1000.0, modelCache.wasLastLoadCached() ? "from cache" : "cache created");
+
+	// letterbox (and optionally tile) each frame to the network input size
+	LetterboxInput letterbox(inputSize, tileCols, tileRows, tileOverlap);
+	MaskCompositor maskCompositor(maskThreshold);
+	vector<InputRegion> inputRegions;
+	letterbox.getRegions(Size(captureWidth, captureHeight), inputRegions);
+	std::printf("Network input: %d tile(s) of %dx%d \n", letterbox.getNumTiles(), inputRegions[0].inputSize.width, inputRegions[0].inputSize.height);
+
+	// tune the backend and target on the model with the actual input blob shape
+	Mat tuningBlob;
+	letterbox.createBlob(Mat(captureHeight, captureWidth, CV_8UC3, Scalar::all(127)), tuningBlob);
+	DnnAutoTuner::RunFunction tuningRun = [&tuningBlob](Net &net)
+	{
+		std::vector<String> outNames(2);
+		outNames[0] = "detection_out_final";
+		outNames[1] = "detection_masks";
+		vector<Mat> outs;
+		net.setInput(tuningBlob);
+		net.forward(outs, outNames);
+	};
+	string modelKey = ModelCache::getModelKey("TensorFlow", modelWeights, textGraph) + "-" + format("%dx%dx%d", letterbox.getNumTiles(), inputRegions[0].inputSize.width, inputRegions[0].inputSize.height);
+	DnnAutoTuner tuner(tuningCachePath);
+	DnnConfiguration dnnConfiguration;
+	tuner.tune(network, tuningRun, modelKey, dnnConfiguration, forceTuning);
 
 	// Open a video file or an image file or a camera stream.
 	string str, outputFile;
@@ -141,9 +232,103 @@ int main(int argc, char **argv)
 	//static const string kWinName = "Deep learning object detection in OpenCV";
 	//namedWindow(DISPLAY_WINDOW_NAME, WINDOW_NORMAL);
 
-	// Process frames.
-	while (waitKey(1) < 0)
+	// register the frame metrics, written to a file in the background if requested
+	MetricsRegistry metrics("cv_maskrcnn");
+	MetricsCounter &framesTotal = metrics.counter("frames_total", "Frames processed");
+	MetricsHistogram &frameSeconds = metrics.histogram("frame_seconds", "Frame processing time in seconds");
+	MetricsHistogram &inferenceSeconds = metrics.histogram("inference_seconds", "Network forward time in seconds");
+	MetricsHistogram &overlaySeconds = metrics.histogram("overlay_seconds", "Detection extraction and mask overlay time in seconds");
+	MetricsGauge &modelLoadSeconds = metrics.gauge("model_load_seconds", "Model load time in seconds");
+	MetricsGauge &firstInferenceSeconds = metrics.gauge("first_inference_seconds", "Time from launch to the first processed frame in seconds");
+	modelLoadSeconds.set(modelCache.getLastLoadSeconds());
+	if (metricsEnabled)
+	{
+		metrics.startDumping(metricsPath);
+	}
+
+	// report the time from launch to the first processed frame once
+	bool firstInferenceReported = false;
+	auto reportFirstInference = [&]()
+	{
+		if (!firstInferenceReported)
+		{
+			firstInferenceReported = true;
+			double firstInferenceTime = (static_cast<double>(getTickCount()) - programStartTicks) / getTickFrequency();
+			firstInferenceSeconds.set(firstInferenceTime);
+			std::printf("Time to first inference: %.1f ms \n", firstInferenceTime * 1000.0);
+		}
+	};
+
+	// Run the overlapped pipeline if requested
+	if (pipelineMode)
+	{
+		// Read the next frame and create a 4D blob from it
+		InferencePipeline::StageFunction preprocessStage = [&capture, &letterbox](InferenceFrame &pipelineFrame)
+		{
+			Mat &image = pipelineFrame.image.mat();
+			if (!capture.read(image))
+			{
+				return false;
+			}
+			letterbox.createBlob(image, pipelineFrame.blob);
+			return true;
+		};
+
+		// Run the forward pass, copying the outputs out of the network before the next frame overwrites them
+		vector<Mat> networkOutputs;
+		InferencePipeline::StageFunction inferStage = [&network, &networkOutputs](InferenceFrame &pipelineFrame)
+		{
+			std::vector<String> outNames(2);
+			outNames[0] = "detection_out_final";
+			outNames[1] = "detection_masks";
+			network.setInput(pipelineFrame.blob);
+			network.forward(networkOutputs, outNames);
+			pipelineFrame.outputs.resize(networkOutputs.size());
+			for (size_t i = 0; i < networkOutputs.size(); ++i)
+			{
+				networkOutputs[i].copyTo(pipelineFrame.outputs[i]);
+			}
+			return true;
+		};
+
+		// Extract, draw, and show the detections in frame order
+		InferencePipeline::StageFunction postprocessStage = [&](InferenceFrame &pipelineFrame)
+		{
+			Mat &image = pipelineFrame.image.mat();
+			double overlayStartTicks = static_cast<double>(getTickCount());
+			letterbox.getRegions(image.size(), inputRegions);
+			postprocess(image, pipelineFrame.outputs, inputRegions, maskCompositor);
+			overlaySeconds.record((static_cast<double>(getTickCount()) - overlayStartTicks) / getTickFrequency());
+			string label = format("Mask-RCNN, Inference time for a frame : %0.0f ms", pipelineFrame.inferenceSeconds * 1000.0);
+			putText(image, label, Point(0, 15), FONT_HERSHEY_SIMPLEX, 0.5, Scalar(0, 0, 0));
+			inferenceSeconds.record(pipelineFrame.inferenceSeconds);
+			reportFirstInference();
+			frameSeconds.record((static_cast<double>(getTickCount()) - pipelineFrame.captureTicks) / getTickFrequency());
+			framesTotal.add();
+			if (benchMode)
+			{
+				return true;
+			}
+			cv::imshow(DISPLAY_WINDOW_NAME, image);
+			return waitKey(1) < 0;
+		};
+
+		InferencePipeline pipeline(PIPELINE_QUEUE_CAPACITY);
+		pipeline.run(preprocessStage, inferStage, postprocessStage);
+		frameSeconds.printSummary("cv_maskrcnn", pipeline.getElapsedSeconds());
+		pipeline.printStatistics();
+
+		capture.release();
+		return 0;
+	}
+
+	// Process frames, skipping the GUI event loop when benchmarking
+	double benchStartTicks = static_cast<double>(getTickCount());
+	while (benchMode || waitKey(1) < 0)
 	{
+		// get the start time
+		double startTicks = static_cast<double>(getTickCount());
+
 		// get frame from the video
 		capture >> frame;
 
@@ -152,12 +337,14 @@ int main(int argc, char **argv)
 		{
 			cout << "Done processing !!!" << endl;
 			cout << "Output file is stored as " << outputFile << endl;
-			waitKey(3000);
+			if (!benchMode)
+			{
+				waitKey(3000);
+			}
 			break;
 		}
-		// Create a 4D blob from a frame.
-		blobFromImage(frame, blob, 1.0, Size(frame.cols, frame.rows), Scalar(), true, false);
-		//blobFromImage(frame, blob);
+		// Create a 4D blob from the letterboxed frame or tiles
+		letterbox.createBlob(frame, blob);
 
 		//Sets the input to the network
 		network.setInput(blob);
@@ -170,12 +357,16 @@ int main(int argc, char **argv)
 		network.forward(outs, outNames);
 
 		// Extract the bounding box and mask for each of the detected objects
-		postprocess(frame, outs);
+		double overlayStartTicks = static_cast<double>(getTickCount());
+		letterbox.getRegions(frame.size(), inputRegions);
+		postprocess(frame, outs, inputRegions, maskCompositor);
+		overlaySeconds.record((static_cast<double>(getTickCount()) - overlayStartTicks) / getTickFrequency());
 
 		// Put efficiency information. The function getPerfProfile returns the overall time for inference(t) and the timings for each of the layers(in layersTimes)
 		vector<double> layersTimes;
 		double freq = getTickFrequency() / 1000;
 		double t = network.getPerfProfile(layersTimes) / freq;
+		inferenceSeconds.record(t / 1000.0);
 		string label = format("Mask-RCNN on 2.5 GHz Intel Core i7 CPU, Inference time for a frame : %0.0f ms", t);
 		putText(frame, label, Point(0, 15), FONT_HERSHEY_SIMPLEX, 0.5, Scalar(0, 0, 0));
 
@@ -183,16 +374,30 @@ int main(int argc, char **argv)
 		Mat detectedFrame;
 		frame.convertTo(detectedFrame, CV_8U);
 
-		cv::imshow(DISPLAY_WINDOW_NAME, frame);
+		// record the frame processing time
+		double elapsedTime = (static_cast<double>(getTickCount()) - startTicks) / getTickFrequency();
+		frameSeconds.record(elapsedTime);
+		framesTotal.add();
+		reportFirstInference();
 
+		if (!benchMode)
+		{
+			cv::imshow(DISPLAY_WINDOW_NAME, frame);
+		}
 	}
+
+	// report the throughput and latency distribution
+	double benchElapsedTime = (static_cast<double>(getTickCount()) - benchStartTicks) / getTickFrequency();
+	frameSeconds.printSummary("cv_maskrcnn", benchElapsedTime);
+
 	capture.release();
 	return 0;
 }
 
-// For each frame, extract the bounding box and mask for each detected object
-void postprocess(Mat& frame, const vector<Mat>& outs)
+// Extract the detections of every input region in frame coordinates, merging duplicates from overlapping tiles
+void extractInstances(const vector<Mat>& outs, const vector<InputRegion>& regions, vector<MaskInstance>& instances)
 {
+	instances.clear();
 	Mat outDetections = outs[0];
 	Mat outMasks = outs[1];
 
@@ -201,40 +406,82 @@ void postprocess(Mat& frame, const vector<Mat>& outs)
 	// C - number of classes (excluding background)
 	// HxW - segmentation shape
 	const int numDetections = outDetections.size[2];
-	const int numClasses = outMasks.size[1];
 
+	// Each detection row is [imageId, classId, score, left, top, right, bottom] in normalized input coordinates
 	outDetections = outDetections.reshape(1, outDetections.total() / 7);
+	vector<MaskInstance> candidates;
 	for (int i = 0; i < numDetections; ++i)
 	{
 		float score = outDetections.at<float>(i, 2);
-		if (score > confThreshold)
+		int imageId = static_cast<int>(outDetections.at<float>(i, 0));
+		if (score > confThreshold && imageId >= 0 && imageId < (int)regions.size())
 		{
-			// Extract the bounding box
-			int classId = static_cast<int>(outDetections.at<float>(i, 1));
-			int left = static_cast<int>(frame.cols * outDetections.at<float>(i, 3));
-			int top = static_cast<int>(frame.rows * outDetections.at<float>(i, 4));
-			int right = static_cast<int>(frame.cols * outDetections.at<float>(i, 5));
-			int bottom = static_cast<int>(frame.rows * outDetections.at<float>(i, 6));
-
-			left = max(0, min(left, frame.cols - 1));
-			top = max(0, min(top, frame.rows - 1));
-			right = max(0, min(right, frame.cols - 1));
-			bottom = max(0, min(bottom, frame.rows - 1));
-			Rect box = Rect(left, top, right - left + 1, bottom - top + 1);
+			MaskInstance instance;
+			instance.classId = static_cast<int>(outDetections.at<float>(i, 1));
+			instance.score = score;
+			instance.box = regions[imageId].mapToFrame(outDetections.at<float>(i, 3), outDetections.at<float>(i, 4), outDetections.at<float>(i, 5), outDetections.at<float>(i, 6));
+			instance.mask = Mat(outMasks.size[2], outMasks.size[3], CV_32F, outMasks.ptr<float>(i, instance.classId));
+			if (instance.box.width > 0 && instance.box.height > 0)
+			{
+				candidates.push_back(instance);
+			}
+		}
+	}
+	if (regions.size() <= 1)
+	{
+		instances.swap(candidates);
+		return;
+	}
 
-			// Extract the mask for the object
-			Mat objectMask(outMasks.size[2], outMasks.size[3], CV_32F, outMasks.ptr<float>(i, classId));
+	// Keep the highest scoring detection of each object seen by several tiles. A tile boundary can cut an object, so a
+	// box that lies mostly inside a kept box of the same class is also treated as a duplicate.
+	sort(candidates.begin(), candidates.end(), [](const MaskInstance& a, const MaskInstance& b) { return a.score > b.score; });
+	for (size_t i = 0; i < candidates.size(); ++i)
+	{
+		bool duplicate = false;
+		for (size_t j = 0; j < instances.size() && !duplicate; ++j)
+		{
+			if (instances[j].classId != candidates[i].classId)
+			{
+				continue;
+			}
+			double intersection = (candidates[i].box & instances[j].box).area();
+			double unionArea = candidates[i].box.area() + instances[j].box.area() - intersection;
+			double smallerArea = min(candidates[i].box.area(), instances[j].box.area());
+			duplicate = intersection > tileOverlapThreshold * unionArea || intersection > 0.8 * smallerArea;
+		}
+		if (!duplicate)
+		{
+			instances.push_back(candidates[i]);
+		}
+	}
+}
 
-			// Draw bounding box, colorize and show the mask on the image
-			drawBox(frame, classId, score, box, objectMask);
+// For each frame, extract the bounding box and mask for each detected object
+void postprocess(Mat& frame, const vector<Mat>& outs, const vector<InputRegion>& regions, MaskCompositor& compositor)
+{
+	// Colorize and show the masks of all objects on the image in one pass
+	static vector<MaskInstance> instances;
+	extractInstances(outs, regions, instances);
+	compositor.composite(frame, instances, colors);
 
-		}
+	// Draw the bounding boxes and labels on top of the masks
+	for (size_t i = 0; i < instances.size(); ++i)
+	{
+		drawBox(frame, instances[i].classId, instances[i].score, instances[i].box);
 	}
 }
 
-// Draw the predicted bounding box, colorize and show the mask on the image
-void drawBox(Mat& frame, int classId, float conf, Rect box, Mat& objectMask)
+// Draw the predicted bounding box and its label
+void drawBox(Mat& frame, int classId, float conf, Rect box)
 {
+	// Keep the part of the box inside the frame
+	box = box & Rect(0, 0, frame.cols, frame.rows);
+	if (box.area() <= 0)
+	{
+		return;
+	}
+
 	//Draw a rectangle displaying the bounding box
 	rectangle(frame, Point(box.x, box.y), Point(box.x + box.width, box.y + box.height), Scalar(255, 178, 50), 3);
 
@@ -252,22 +499,4 @@ void drawBox(Mat& frame, int classId, float conf, Rect box, Mat& objectMask)
 	box.y = max(box.y, labelSize.height);
 	rectangle(frame, Point(box.x, box.y - round(1.5*labelSize.height)), Point(box.x + round(1.5*labelSize.width), box.y + baseLine), Scalar(255, 255, 255), FILLED);
 	putText(frame, label, Point(box.x, box.y), FONT_HERSHEY_SIMPLEX, 0.75, Scalar(0, 0, 0), 1);
-
-	Scalar color = colors[classId%colors.size()];
-
-	// Resize the mask, threshold, color and apply it on the image
-	resize(objectMask, objectMask, Size(box.width, box.height));
-	Mat mask = (objectMask > maskThreshold);
-	Mat coloredRoi = (0.3 * color + 0.7 * frame(box));
-	coloredRoi.convertTo(coloredRoi, CV_8UC3);
-
-	// Draw the contours on the image
-	vector<Mat> contours;
-	Mat hierarchy;
-	mask.convertTo(mask, CV_8U);
-	findContours(mask, contours, hierarchy, RETR_CCOMP, CHAIN_APPROX_SIMPLE);
-	drawContours(coloredRoi, contours, -1, color, 5, LINE_8, hierarchy, 100);
-	coloredRoi.copyTo(frame(box), mask);
-
 }
-
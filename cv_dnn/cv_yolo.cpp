@@ -25,92 +25,117 @@
 #include <iostream>
 #include <cstdio>
 #include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
 #include "opencv2/opencv.hpp"
 #include <opencv2/dnn.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
+#include "FramePool.h"
+#include "Metrics.h"
+#include "YoloDecoder.h"
+#include "InferencePipeline.h"
+#include "DnnAutoTuner.h"
+#include "ModelCache.h"
+#include "DetectionTracker.h"
+#include "MotionGate.h"
 
 // configuration parameters
 #define NUM_COMNMAND_LINE_ARGUMENTS 1
 #define DISPLAY_WINDOW_NAME "Video Frame"
+#define DEFAULT_BATCH_SIZE 1
+#define DEFAULT_BATCH_WAIT_MS 50
+#define CONFIDENCE_THRESHOLD 0.5f
+#define NMS_THRESHOLD 0.4f
+#define PIPELINE_QUEUE_CAPACITY 2
+#define DEFAULT_TUNING_CACHE "dnn_tuning.cache"
+#define DEFAULT_MODEL_CACHE_DIRECTORY "model_cache"
+#define DEFAULT_DETECT_INTERVAL 1
+#define DEFAULT_TRACKER_TYPE "KCF"
+#define MOTION_THRESHOLD 0.05
 
 // define the list of class names
 std::vector<std::string> classes;
 
+/*******************************************************************************************************************/ /**
+ * @brief A captured frame waiting to be included in an inference batch
+ **********************************************************************************************************************/
+struct BatchEntry
+{
+    FrameHandle image;
+    int stream;
+    double captureTicks;
+    std::vector<cv::Rect> regions;
+};
+
 // declare function prototypes
-bool processFrame(const cv::Mat &imageIn, cv::Mat &imageOut);
+void createInputBlob(const std::vector<cv::Mat> &imagesIn, cv::Mat &blobOut);
+bool forwardBlob(const cv::Mat &blob, int numImages, std::vector<std::vector<cv::Mat> > &outputsOut, cv::dnn::Net &network);
+bool detectBatch(const std::vector<cv::Mat> &imagesIn, std::vector<std::vector<cv::Mat> > &outputsOut, cv::dnn::Net &network);
 
 /*******************************************************************************************************************/ /**
- * @brief Process a single image frame
- * @param[in] imageIn the input image frame
- * @param[out] imageOut the processed image frame
- * @param[in] network input DNN network
- * @return true if frame was processed successfully
+ * @brief Pack image frames into a single NCHW network input blob
+ * @param[in] imagesIn the input image frames
+ * @param[out] blobOut the network input blob
  * @author Christopher D. McMurrough
  **********************************************************************************************************************/
-bool processFrame(const cv::Mat &imageIn, cv::Mat &imageOut, cv::dnn::Net &network)
+void createInputBlob(const std::vector<cv::Mat> &imagesIn, cv::Mat &blobOut)
 {
-    // copy the input image frame to the ouput image (deep copy)
-    imageOut = imageIn.clone();
-
-    // create the input DNN blob from the image frame
-    static cv::Mat blobFromImg;
     const double scaleFactor = 1.0;
     const cv::Size size = cv::Size(416, 416);
     const cv::Scalar mean = cv::Scalar();
     const bool swapRB = false;
     const bool crop = false;
-    const int ddepth = CV_32F;
-    cv::dnn::blobFromImage(imageIn, blobFromImg, scaleFactor, size, mean, swapRB, crop);
+    cv::dnn::blobFromImages(imagesIn, blobOut, scaleFactor, size, mean, swapRB, crop);
+}
+
+/*******************************************************************************************************************/ /**
+ * @brief Run the network once over an input blob
+ *
+ * Each YOLO output layer stacks the rows of every image in batch order, and each image receives a view of its own rows
+ * from every layer. The views are only valid until the next forward pass.
+ *
+ * @param[in] blob the network input blob
+ * @param[in] numImages number of images packed in the blob
+ * @param[out] outputsOut the raw output rows of each output layer for each input image
+ * @param[in] network input DNN network
+ * @return true if the blob was processed successfully
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool forwardBlob(const cv::Mat &blob, int numImages, std::vector<std::vector<cv::Mat> > &outputsOut, cv::dnn::Net &network)
+{
+    if (numImages <= 0)
+    {
+        return false;
+    }
 
     // set the blob as input to the network
     const float blob_scale = 1.0 / 255.0;
     const cv::Scalar blob_mean = 0;
-    network.setInput(blobFromImg, "", blob_scale, blob_mean);
-
-    // feed forward the inputs through the network
-    cv::Mat outMat;
-    network.forward(outMat);
+    network.setInput(blob, "", blob_scale, blob_mean);
 
-    // reach row represents one result per detected object
-    int numRows = outMat.rows;
+    // feed forward the inputs through the network, collecting every YOLO output layer
+    static const std::vector<std::string> outputNames = network.getUnconnectedOutLayersNames();
+    static std::vector<cv::Mat> outMats;
+    network.forward(outMats, outputNames);
 
-    // column arrangement:
-    // [x, y, w, h, class_1_score, class_2_score, ..., ... class_N_score]
-    int numCols = outMat.cols;
-    for (int j = 0; j < numRows; ++j)
+    // scatter the stacked output rows back to their images
+    outputsOut.resize(numImages);
+    for (int i = 0; i < numImages; ++i)
     {
-        // get scores for each possible class (starting at element 5)
-        cv::Mat scores = outMat.row(j).colRange(5, numCols);
-
-        // find indexes of min and max confidence and related index of element.
-        cv::Point maxPos;
-        double confidence;
-        cv::minMaxLoc(scores, 0, &confidence, 0, &maxPos);
-
-        // consider only scores above a minimum threshold
-        const double minConfidence = 0.0001;
-        if (confidence > minConfidence)
+        outputsOut[i].clear();
+    }
+    for (size_t k = 0; k < outMats.size(); ++k)
+    {
+        if (outMats[k].rows % numImages != 0)
         {
-            // parse the coordinates and parameters of this result
-            int center_x = (int)(outMat.at<float>(j, 0) * imageOut.cols);
-            int center_y = (int)(outMat.at<float>(j, 1) * imageOut.rows);
-            int width = (int)(outMat.at<float>(j, 2) * imageOut.cols + 20);
-            int height = (int)(outMat.at<float>(j, 3) * imageOut.rows + 100);
-
-            // calculate top left
-            int left = center_x - width / 2;
-            int top = center_y - height / 2;
-
-            // annotate the image
-            std::stringstream ss;
-            ss << classes.at(maxPos.x);
-            std::string clas = ss.str();
-            cv::putText(imageOut, clas, cv::Point(left, top), 1, 2, cv::Scalar(0, 255, 255), 2, false);
-            std::stringstream ss2;
-            ss << confidence;
-            std::string conf = ss.str();
-            cv::rectangle(imageOut, cv::Rect(left, top, width, height), cv::Scalar(0, 128, 255), 2, 8, 0);
+            return false;
+        }
+        const int rowsPerImage = outMats[k].rows / numImages;
+        for (int i = 0; i < numImages; ++i)
+        {
+            outputsOut[i].push_back(outMats[k].rowRange(i * rowsPerImage, (i + 1) * rowsPerImage));
         }
     }
 
@@ -118,8 +143,34 @@ bool processFrame(const cv::Mat &imageIn, cv::Mat &imageOut, cv::dnn::Net &netwo
     return true;
 }
 
+/*******************************************************************************************************************/ /**
+ * @brief Run the network once over a batch of image frames
+ *
+ * The frames are packed into a single NCHW blob so that the backend can work on all of them in one forward pass.
+ *
+ * @param[in] imagesIn the input image frames
+ * @param[out] outputsOut the raw output rows of each output layer for each input image
+ * @param[in] network input DNN network
+ * @return true if the batch was processed successfully
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool detectBatch(const std::vector<cv::Mat> &imagesIn, std::vector<std::vector<cv::Mat> > &outputsOut, cv::dnn::Net &network)
+{
+    static cv::Mat blobFromImg;
+    createInputBlob(imagesIn, blobFromImg);
+    return forwardBlob(blobFromImg, static_cast<int>(imagesIn.size()), outputsOut, network);
+}
+
 /*******************************************************************************************************************/ /**
  * @brief program entry point
+ *
+ * Frames are read round robin from every video source and collected into batches. A batch runs as soon as it holds
+ * the requested number of frames, or once its oldest frame has waited longer than the batch timeout, so the added
+ * latency stays bounded when the sources are slow. With a detection interval above one, each stream only sends frames
+ * to the detector when its trackers ask for a new detection, and the frames in between are tracked instead. With the
+ * motion gate enabled, only the moving regions of each frame are cropped into the batch, and frames where nothing moved
+ * skip the detector entirely.
+ *
  * @param[in] argc number of command line arguments
  * @param[in] argv string array of command line arguments
  * @return return code (0 for normal termination)
@@ -127,43 +178,133 @@ bool processFrame(const cv::Mat &imageIn, cv::Mat &imageOut, cv::dnn::Net &netwo
  **********************************************************************************************************************/
 int main(int argc, char **argv)
 {
+    // time the startup from launch to the first processed frame
+    double programStartTicks = static_cast<double>(cv::getTickCount());
+
     // store video capture parameters
-    std::string videoFileName;
+    std::vector<std::string> videoFileNames;
+
+    // run without display or pacing if requested
+    bool benchMode = extractFlag(argc, argv, "--bench");
+
+    // write metrics to a file instead of printing per frame timing, if requested
+    std::string metricsPath;
+    bool metricsEnabled = extractOption(argc, argv, "--metrics", metricsPath);
+
+    // overlap preprocessing, inference, and postprocessing on separate threads if requested
+    bool pipelineMode = extractFlag(argc, argv, "--pipeline");
+
+    // select the DNN backend and target by timing them, or reuse the cached decision
+    std::string tuningCachePath = DEFAULT_TUNING_CACHE;
+    extractOption(argc, argv, "--tuning-cache", tuningCachePath);
+    bool forceTuning = extractFlag(argc, argv, "--retune");
+
+    // load the model through the packed model cache
+    std::string modelCacheDirectory = DEFAULT_MODEL_CACHE_DIRECTORY;
+    extractOption(argc, argv, "--model-cache", modelCacheDirectory);
+
+    // parse the batching options
+    std::string optionValue;
+    int batchSize = DEFAULT_BATCH_SIZE;
+    double batchWaitSeconds = DEFAULT_BATCH_WAIT_MS / 1000.0;
+    if (extractOption(argc, argv, "--batch", optionValue))
+    {
+        batchSize = std::max(1, atoi(optionValue.c_str()));
+    }
+    if (extractOption(argc, argv, "--batch-wait", optionValue))
+    {
+        batchWaitSeconds = std::max(0.0, atof(optionValue.c_str()) / 1000.0);
+    }
+
+    // parse the hybrid detection and tracking options
+    int detectInterval = DEFAULT_DETECT_INTERVAL;
+    std::string trackerType = DEFAULT_TRACKER_TYPE;
+    if (extractOption(argc, argv, "--detect-interval", optionValue))
+    {
+        detectInterval = std::max(1, atoi(optionValue.c_str()));
+    }
+    extractOption(argc, argv, "--tracker", trackerType);
+    if (DetectionTracker::createTracker(trackerType).empty())
+    {
+        std::printf("Unknown tracker type %s, expected KCF, CSRT, or MIL \n", trackerType.c_str());
+        return 0;
+    }
+    const bool hybridMode = detectInterval > 1;
+
+    // detect only on moving regions, found with background subtraction, if requested
+    bool motionGateMode = extractFlag(argc, argv, "--motion-gate");
 
     // validate and parse the command line arguments
-    if (argc != NUM_COMNMAND_LINE_ARGUMENTS + 1)
+    if (argc < NUM_COMNMAND_LINE_ARGUMENTS + 1)
     {
-        std::printf("USAGE: %s <file_path> \n", argv[0]);
+        std::printf("USAGE: %s <file_path> [file_path ...] [--batch=<frames>] [--batch-wait=<ms>] [--detect-interval=<frames>] [--tracker=<KCF|CSRT|MIL>] [--motion-gate] [--pipeline] [--tuning-cache=<path>] [--retune] [--model-cache=<dir>] [--bench] [--metrics=<path>] \n", argv[0]);
         return 0;
     }
     else
     {
-        videoFileName = argv[1];
+        for (int i = 1; i < argc; i++)
+        {
+            videoFileNames.push_back(argv[i]);
+        }
     }
 
-    // open the video file
-    cv::VideoCapture capture(videoFileName);
-    if (!capture.isOpened())
+    // open the video files
+    const int numStreams = static_cast<int>(videoFileNames.size());
+    std::vector<cv::VideoCapture> captures(numStreams);
+    std::vector<bool> streamOpen(numStreams, true);
+    std::vector<std::string> windowNames(numStreams);
+    int captureFPS = 0;
+    for (int i = 0; i < numStreams; i++)
     {
-        std::printf("Unable to open video source, terminating program! \n");
-        return 0;
-    }
+        cv::VideoCapture &capture = captures[i];
+        capture.open(videoFileNames[i]);
+        if (!capture.isOpened())
+        {
+            std::printf("Unable to open video source, terminating program! \n");
+            return 0;
+        }
 
-    // get the video source parameters
-    int captureWidth = static_cast<int>(capture.get(cv::CAP_PROP_FRAME_WIDTH));
-    int captureHeight = static_cast<int>(capture.get(cv::CAP_PROP_FRAME_HEIGHT));
-    int captureFPS = static_cast<int>(capture.get(cv::CAP_PROP_FPS));
-    std::cout << "Video source opened successfully (width=" << captureWidth << " height=" << captureHeight << " fps=" << captureFPS << ")!" << std::endl;
+        // get the video source parameters
+        int captureWidth = static_cast<int>(capture.get(cv::CAP_PROP_FRAME_WIDTH));
+        int captureHeight = static_cast<int>(capture.get(cv::CAP_PROP_FRAME_HEIGHT));
+        captureFPS = static_cast<int>(capture.get(cv::CAP_PROP_FPS));
+        std::cout << "Video source opened successfully (width=" << captureWidth << " height=" << captureHeight << " fps=" << captureFPS << ")!" << std::endl;
 
-    // create image window
-    cv::namedWindow(DISPLAY_WINDOW_NAME, cv::WINDOW_AUTOSIZE);
+        // create image window
+        windowNames[i] = DISPLAY_WINDOW_NAME;
+        if (i > 0)
+        {
+            windowNames[i] += " " + std::to_string(i);
+        }
+        if (!benchMode)
+        {
+            cv::namedWindow(windowNames[i], cv::WINDOW_AUTOSIZE);
+        }
+    }
+    std::printf("Batching up to %d frames, waiting at most %.0f ms \n", batchSize, batchWaitSeconds * 1000.0);
 
     // initialize YOLO
     std::string model_file = "yolov3-tiny.weights";
     std::string config_file = "yolov3-tiny.cfg";
-    cv::dnn::Net network = cv::dnn::readNet(model_file, config_file, "Darknet");
-    network.setPreferableBackend(cv::dnn::DNN_BACKEND_DEFAULT);
-    network.setPreferableTarget(cv::dnn::DNN_TARGET_OPENCL);
+    ModelCache modelCache(modelCacheDirectory);
+    cv::dnn::Net network = modelCache.load("Darknet", model_file, config_file);
+    std::printf("Model loaded in %.1f ms (%s) \n", modelCache.getLastLoadSeconds() * 1000.0, modelCache.wasLastLoadCached() ? "from cache" : "cache created");
+
+    // tune the backend and target on the model with the batch size and frame size that will actually be used
+    const int tuningBatchSize = pipelineMode ? 1 : batchSize;
+    const int frameWidth = static_cast<int>(captures[0].get(cv::CAP_PROP_FRAME_WIDTH));
+    const int frameHeight = static_cast<int>(captures[0].get(cv::CAP_PROP_FRAME_HEIGHT));
+    cv::Mat tuningBlob;
+    createInputBlob(std::vector<cv::Mat>(tuningBatchSize, cv::Mat(frameHeight, frameWidth, CV_8UC3, cv::Scalar::all(127))), tuningBlob);
+    std::vector<std::vector<cv::Mat> > tuningOutputs;
+    DnnAutoTuner::RunFunction tuningRun = [&tuningBlob, &tuningOutputs, tuningBatchSize](cv::dnn::Net &net)
+    {
+        forwardBlob(tuningBlob, tuningBatchSize, tuningOutputs, net);
+    };
+    std::string modelKey = ModelCache::getModelKey("Darknet", model_file, config_file) + "-" + std::to_string(tuningBatchSize) + "x416x416";
+    DnnAutoTuner tuner(tuningCachePath);
+    DnnConfiguration dnnConfiguration;
+    tuner.tune(network, tuningRun, modelKey, dnnConfiguration, forceTuning);
     
     // load the class label names
     std::string classes_file = "mscoco_labels.names.txt";
@@ -171,53 +312,367 @@ int main(int argc, char **argv)
     std::string line;
     while(std::getline(ifs, line)) classes.push_back(line);
 
+    // register the frame metrics, written to a file in the background if requested
+    MetricsRegistry metrics("cv_yolo");
+    MetricsCounter &framesTotal = metrics.counter("frames_total", "Frames processed");
+    MetricsHistogram &frameSeconds = metrics.histogram("frame_seconds", "Frame processing time in seconds");
+    MetricsCounter &captureFailures = metrics.counter("capture_failures_total", "Frames that could not be read");
+    MetricsCounter &batchesTotal = metrics.counter("batches_total", "Inference batches run");
+    MetricsHistogram &forwardSeconds = metrics.histogram("forward_seconds", "Batch forward pass time in seconds");
+    MetricsHistogram &postprocessSeconds = metrics.histogram("postprocess_seconds", "Per frame output decoding time in seconds");
+    MetricsCounter &detectionsTotal = metrics.counter("detections_total", "Objects detected");
+    MetricsCounter &trackedFramesTotal = metrics.counter("tracked_frames_total", "Frames served by the trackers instead of the detector");
+    MetricsGauge &detectorDutyCycle = metrics.gauge("detector_duty_cycle", "Fraction of frames passed to the detector");
+    MetricsCounter &gatedFramesTotal = metrics.counter("gated_frames_total", "Frames skipped because nothing moved");
+    MetricsCounter &motionRegionsTotal = metrics.counter("motion_regions_total", "Motion regions passed to the detector");
+    MetricsHistogram &gateSeconds = metrics.histogram("gate_seconds", "Per frame motion gate time in seconds");
+    MetricsGauge &modelLoadSeconds = metrics.gauge("model_load_seconds", "Model load time in seconds");
+    MetricsGauge &firstInferenceSeconds = metrics.gauge("first_inference_seconds", "Time from launch to the first processed frame in seconds");
+    modelLoadSeconds.set(modelCache.getLastLoadSeconds());
+    if (metricsEnabled)
+    {
+        metrics.startDumping(metricsPath);
+    }
+
+    // report the time from launch to the first processed frame once
+    bool firstInferenceReported = false;
+    auto reportFirstInference = [&]()
+    {
+        if (!firstInferenceReported)
+        {
+            firstInferenceReported = true;
+            double firstInferenceTime = (static_cast<double>(cv::getTickCount()) - programStartTicks) / cv::getTickFrequency();
+            firstInferenceSeconds.set(firstInferenceTime);
+            std::printf("Time to first inference: %.1f ms \n", firstInferenceTime * 1000.0);
+        }
+    };
+
+    // run the overlapped pipeline on the first video source if requested
+    if (pipelineMode)
+    {
+        if (numStreams > 1 || batchSize > 1)
+        {
+            std::printf("Pipelined mode reads only the first video source, one frame per forward pass \n");
+        }
+        if (hybridMode || motionGateMode)
+        {
+            std::printf("Pipelined mode runs the detector on every full frame \n");
+        }
+
+        // read the next frame and convert it to a network input blob
+        cv::VideoCapture &capture = captures[0];
+        InferencePipeline::StageFunction preprocess = [&capture](InferenceFrame &frame)
+        {
+            if (!capture.read(frame.image.mat()))
+            {
+                return false;
+            }
+            createInputBlob(std::vector<cv::Mat>(1, frame.image.mat()), frame.blob);
+            return true;
+        };
+
+        // run the forward pass, copying the outputs out of the network before the next frame overwrites them
+        std::vector<std::vector<cv::Mat> > networkOutputs;
+        InferencePipeline::StageFunction infer = [&network, &networkOutputs, &forwardSeconds, &batchesTotal](InferenceFrame &frame)
+        {
+            double forwardStartTicks = static_cast<double>(cv::getTickCount());
+            if (!forwardBlob(frame.blob, 1, networkOutputs, network))
+            {
+                return false;
+            }
+            frame.outputs.resize(networkOutputs[0].size());
+            for (size_t k = 0; k < networkOutputs[0].size(); ++k)
+            {
+                networkOutputs[0][k].copyTo(frame.outputs[k]);
+            }
+            forwardSeconds.record((static_cast<double>(cv::getTickCount()) - forwardStartTicks) / cv::getTickFrequency());
+            batchesTotal.add();
+            return true;
+        };
+
+        // decode, draw, and display the detections in frame order
+        std::vector<Detection> frameDetections;
+        YoloDecoder frameDecoder(CONFIDENCE_THRESHOLD, NMS_THRESHOLD);
+        cv::Mat displayFrame;
+        InferencePipeline::StageFunction postprocess = [&](InferenceFrame &frame)
+        {
+            double decodeStartTicks = static_cast<double>(cv::getTickCount());
+            const cv::Mat &image = frame.image.mat();
+            frameDecoder.decode(frame.outputs, image.size(), frameDetections);
+            postprocessSeconds.record((static_cast<double>(cv::getTickCount()) - decodeStartTicks) / cv::getTickFrequency());
+            detectionsTotal.add(static_cast<long long>(frameDetections.size()));
+            reportFirstInference();
+            double elapsedTime = (static_cast<double>(cv::getTickCount()) - frame.captureTicks) / cv::getTickFrequency();
+            frameSeconds.record(elapsedTime);
+            framesTotal.add();
+            if (benchMode)
+            {
+                return true;
+            }
+            image.copyTo(displayFrame);
+            drawDetections(displayFrame, frameDetections, classes);
+            cv::imshow(windowNames[0], displayFrame);
+            return ((char)cv::waitKey(1)) != 'q';
+        };
+
+        InferencePipeline pipeline(PIPELINE_QUEUE_CAPACITY);
+        pipeline.run(preprocess, infer, postprocess);
+        frameSeconds.printSummary("cv_yolo", pipeline.getElapsedSeconds());
+        pipeline.printStatistics();
+
+        // release program resources before returning
+        capture.release();
+        cv::destroyAllWindows();
+        return 0;
+    }
+
+    // recycle frame buffers between iterations
+    FramePool framePool;
+
+    // frames waiting for the next batch
+    std::vector<BatchEntry> pending;
+    std::vector<cv::Mat> batchImages;
+    std::vector<std::vector<cv::Mat> > batchOutputs;
+    std::vector<Detection> detections;
+    std::vector<Detection> regionDetections;
+    pending.reserve(batchSize);
+
+    // decode the network outputs, timing the forward pass and the decoding separately
+    YoloDecoder decoder(CONFIDENCE_THRESHOLD, NMS_THRESHOLD);
+
+    // carry the detections of each stream across the frames between detector runs
+    std::vector<DetectionTracker> streamTrackers(numStreams, DetectionTracker(trackerType, detectInterval, MOTION_THRESHOLD));
+    if (hybridMode)
+    {
+        std::printf("Running the detector at most every %d frames, %s trackers in between \n", detectInterval, trackerType.c_str());
+    }
+
+    // find the moving regions of each stream with its own background model
+    std::vector<MotionGate> streamGates(motionGateMode ? numStreams : 0);
+    long long gatedFrames = 0;
+
     // process data until program termination
     bool doCapture = true;
     int frameCount = 0;
+    int streamIndex = 0;
+    double benchStartTicks = static_cast<double>(cv::getTickCount());
     while (doCapture)
     {
-        // get the start time
-        double startTicks = static_cast<double>(cv::getTickCount());
+        // attempt to acquire an image frame from the next open stream
+        bool captureSuccess = false;
+        if (streamOpen[streamIndex])
+        {
+            BatchEntry entry;
+            entry.image = framePool.acquire();
+            entry.stream = streamIndex;
+            entry.captureTicks = static_cast<double>(cv::getTickCount());
+            captureSuccess = captures[streamIndex].read(entry.image.mat());
 
-        // attempt to acquire and process an image frame
-        cv::Mat captureFrame;
-        cv::Mat processedFrame;
-        bool captureSuccess = capture.read(captureFrame);
-        if (captureSuccess)
+            // update the motion gate on every frame so its background model stays current
+            bool frameMoving = true;
+            if (captureSuccess && motionGateMode)
+            {
+                double gateStartTicks = static_cast<double>(cv::getTickCount());
+                frameMoving = streamGates[streamIndex].findRegions(entry.image.mat(), entry.regions);
+                gateSeconds.record((static_cast<double>(cv::getTickCount()) - gateStartTicks) / cv::getTickFrequency());
+            }
+
+            // track the frame instead of detecting on it when the stream's trackers allow it
+            bool streamPending = false;
+            for (size_t i = 0; i < pending.size(); i++)
+            {
+                streamPending = streamPending || pending[i].stream == streamIndex;
+            }
+            DetectionTracker &streamTracker = streamTrackers[streamIndex];
+            if (captureSuccess && !frameMoving)
+            {
+                // skip the detector when nothing moved, the trackers did not see this frame so detect when motion resumes
+                gatedFramesTotal.add();
+                gatedFrames++;
+                streamTracker.requestDetection();
+                double elapsedTime = (static_cast<double>(cv::getTickCount()) - entry.captureTicks) / cv::getTickFrequency();
+                frameSeconds.record(elapsedTime);
+                framesTotal.add();
+                frameCount++;
+                if (!benchMode)
+                {
+                    cv::imshow(windowNames[streamIndex], entry.image.mat());
+                }
+            }
+            else if (captureSuccess && hybridMode && !streamPending && !streamTracker.needsDetection())
+            {
+                const cv::Mat &image = entry.image.mat();
+                streamTracker.track(image, detections);
+                trackedFramesTotal.add();
+                detectorDutyCycle.set(streamTracker.getDutyCycle());
+
+                // compute the frame processing time
+                double elapsedTime = (static_cast<double>(cv::getTickCount()) - entry.captureTicks) / cv::getTickFrequency();
+                frameSeconds.record(elapsedTime);
+                framesTotal.add();
+                frameCount++;
+
+                // draw the tracked objects and update the GUI window if necessary
+                if (!benchMode)
+                {
+                    FrameHandle processedFrame = framePool.acquire();
+                    image.copyTo(processedFrame.mat());
+                    drawDetections(processedFrame.mat(), detections, classes);
+                    cv::imshow(windowNames[streamIndex], processedFrame.mat());
+                }
+            }
+            else if (captureSuccess)
+            {
+                // without the motion gate the whole frame is a single region
+                if (entry.regions.empty())
+                {
+                    entry.regions.assign(1, cv::Rect(0, 0, entry.image.mat().cols, entry.image.mat().rows));
+                }
+                motionRegionsTotal.add(static_cast<long long>(entry.regions.size()));
+                pending.push_back(entry);
+
+                // increment the frame counter
+                frameCount++;
+            }
+            else if (benchMode)
+            {
+                // stop reading this stream at the end of the video when benchmarking
+                streamOpen[streamIndex] = false;
+            }
+            else
+            {
+                captureFailures.add();
+                std::printf("Unable to acquire image frame! \n");
+            }
+        }
+        streamIndex = (streamIndex + 1) % numStreams;
+
+        // stop once every stream has ended
+        bool anyStreamOpen = false;
+        for (int i = 0; i < numStreams; i++)
         {
-            // process the image frame
-            processFrame(captureFrame, processedFrame, network);
+            anyStreamOpen = anyStreamOpen || streamOpen[i];
+        }
+        if (!anyStreamOpen)
+        {
+            doCapture = false;
+        }
 
-            // increment the frame counter
-            frameCount++;
+        // check for program termination, gated and tracked frames are shown above and batched frames on the next pass
+        if (!benchMode && ((char)cv::waitKey(1)) == 'q')
+        {
+            doCapture = false;
         }
-        else
+
+        // run the batch when it is full, when its oldest frame has waited too long, or when the input is exhausted
+        if (pending.empty())
         {
-            std::printf("Unable to acquire image frame! \n");
+            continue;
+        }
+        double nowTicks = static_cast<double>(cv::getTickCount());
+        double waitedTime = (nowTicks - pending.front().captureTicks) / cv::getTickFrequency();
+        if (static_cast<int>(pending.size()) < batchSize && waitedTime < batchWaitSeconds && doCapture)
+        {
+            continue;
         }
 
-        // update the GUI window if necessary
-        if (captureSuccess)
+        // process the regions of every frame of the batch with a single forward pass
+        batchImages.clear();
+        for (size_t i = 0; i < pending.size(); i++)
         {
-            cv::imshow(DISPLAY_WINDOW_NAME, processedFrame);
+            for (size_t r = 0; r < pending[i].regions.size(); r++)
+            {
+                batchImages.push_back(pending[i].image.mat()(pending[i].regions[r]));
+            }
+        }
+        double batchStartTicks = static_cast<double>(cv::getTickCount());
+        bool batchSuccess = detectBatch(batchImages, batchOutputs, network);
+        double forwardTime = (static_cast<double>(cv::getTickCount()) - batchStartTicks) / cv::getTickFrequency();
+        forwardSeconds.record(forwardTime);
+        batchesTotal.add();
 
-            // get the number of milliseconds per frame
-            int delayMs = (1.0 / captureFPS) * 1000;
+        // annotate and display each frame of the batch
+        size_t batchImageIndex = 0;
+        for (size_t i = 0; batchSuccess && i < pending.size(); i++)
+        {
+            // decode the detections of each region of this frame into frame coordinates
+            double decodeStartTicks = static_cast<double>(cv::getTickCount());
+            const cv::Mat &image = pending[i].image.mat();
+            detections.clear();
+            for (size_t r = 0; r < pending[i].regions.size(); r++, batchImageIndex++)
+            {
+                const cv::Rect &region = pending[i].regions[r];
+                decoder.decode(batchOutputs[batchImageIndex], region.size(), regionDetections);
+                for (size_t k = 0; k < regionDetections.size(); k++)
+                {
+                    regionDetections[k].box += region.tl();
+                    detections.push_back(regionDetections[k]);
+                }
+            }
+            double postprocessTime = (static_cast<double>(cv::getTickCount()) - decodeStartTicks) / cv::getTickFrequency();
+            postprocessSeconds.record(postprocessTime);
+            detectionsTotal.add(static_cast<long long>(detections.size()));
 
-            // check for program termination
-            if (((char)cv::waitKey(1)) == 'q')
+            // restart the stream's trackers from the new detections
+            if (hybridMode)
             {
-                doCapture = false;
+                DetectionTracker &streamTracker = streamTrackers[pending[i].stream];
+                streamTracker.reset(image, detections);
+                detectorDutyCycle.set(streamTracker.getDutyCycle());
+            }
+
+            // compute the frame processing time, including the time spent waiting for the batch
+            double elapsedTime = (static_cast<double>(cv::getTickCount()) - pending[i].captureTicks) / cv::getTickFrequency();
+            frameSeconds.record(elapsedTime);
+            framesTotal.add();
+            reportFirstInference();
+
+            // draw the detections and update the GUI window if necessary
+            if (!benchMode)
+            {
+                FrameHandle processedFrame = framePool.acquire();
+                image.copyTo(processedFrame.mat());
+                drawDetections(processedFrame.mat(), detections, classes);
+                cv::imshow(windowNames[pending[i].stream], processedFrame.mat());
             }
         }
+        pending.clear();
+    }
+
+    // report the throughput and latency distribution
+    double benchElapsedTime = (static_cast<double>(cv::getTickCount()) - benchStartTicks) / cv::getTickFrequency();
+    frameSeconds.printSummary("cv_yolo", benchElapsedTime);
+    std::printf("Stage timing: forward %.2f ms per batch, postprocess %.2f ms per frame \n", forwardSeconds.getMean() * 1000.0, postprocessSeconds.getMean() * 1000.0);
 
-        // compute the frame processing time
-        double endTicks = static_cast<double>(cv::getTickCount());
-        double elapsedTime = (endTicks - startTicks) / cv::getTickFrequency();
-        std::cout << "Frame processing time: " << elapsedTime << std::endl;
+    // report how often the motion gate skipped the detector
+    if (motionGateMode)
+    {
+        std::printf("Motion gate: skipped %lld of %d frames (%.1f%%) \n", gatedFrames, frameCount, frameCount > 0 ? 100.0 * gatedFrames / frameCount : 0.0);
     }
 
+    // report how often the detector actually ran
+    if (hybridMode)
+    {
+        long long detectedFrames = 0;
+        long long seenFrames = 0;
+        for (int i = 0; i < numStreams; i++)
+        {
+            detectedFrames += streamTrackers[i].getDetectionCount();
+            seenFrames += streamTrackers[i].getFrameCount();
+            std::printf("Stream %d: detection interval %d frames at exit \n", i, streamTrackers[i].getInterval());
+        }
+        double dutyCycle = seenFrames > 0 ? static_cast<double>(detectedFrames) / seenFrames : 0.0;
+        detectorDutyCycle.set(dutyCycle);
+        std::printf("Detector duty cycle: %lld of %lld frames (%.1f%%) \n", detectedFrames, seenFrames, dutyCycle * 100.0);
+    }
+
+    // report frame buffer reuse
+    std::printf("Frame buffers: %d pooled, %lld allocations over %d frames \n", static_cast<int>(framePool.getSize()), framePool.getAllocationCount(), frameCount);
+
     // release program resources before returning
-    capture.release();
+    for (int i = 0; i < numStreams; i++)
+    {
+        captures[i].release();
+    }
     cv::destroyAllWindows();
 }
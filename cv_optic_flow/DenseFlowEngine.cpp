@@ -0,0 +1,171 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file DenseFlowEngine.cpp
+ * @brief Implementation of the DenseFlowEngine class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#include "DenseFlowEngine.h"
+
+#include <algorithm>
+
+// number of hue values in an 8 bit OpenCV HSV image, two degrees each
+#define NUM_HUES 180
+
+/*******************************************************************************************************************//**
+ * @brief Class constructor
+ * @param[in] preset DIS preset, one of PRESET_ULTRAFAST, PRESET_FAST, or PRESET_MEDIUM
+ * @param[in] warmStart whether the previous flow initializes the next flow computation
+ * @param[in] maxMagnitude flow magnitude in pixels rendered at full brightness, 0 uses the largest of each frame
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+DenseFlowEngine::DenseFlowEngine(int preset, bool warmStart, double maxMagnitude) : m_warmStart(warmStart), m_maxMagnitude(maxMagnitude), m_framePairs(0)
+{
+    m_algorithm = cv::DISOpticalFlow::create(preset);
+
+    // the BGR color of every hue and brightness at full saturation
+    cv::Mat hsv(NUM_HUES, 256, CV_8UC3);
+    for(int hue = 0; hue < NUM_HUES; hue++)
+    {
+        cv::Vec3b *row = hsv.ptr<cv::Vec3b>(hue);
+        for(int value = 0; value < 256; value++)
+        {
+            row[value] = cv::Vec3b(static_cast<uchar>(hue), 255, static_cast<uchar>(value));
+        }
+    }
+    cv::cvtColor(hsv, m_colorTable, cv::COLOR_HSV2BGR);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Compute the flow between the previous frame and a new frame
+ * @param[in] frame the new BGR or grey frame
+ * @return true if flow was computed, false for the first frame or after the frame size changes
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool DenseFlowEngine::compute(const cv::Mat &frame)
+{
+    if(frame.channels() == 3)
+    {
+        cv::cvtColor(frame, m_gray, cv::COLOR_BGR2GRAY);
+    }
+    else
+    {
+        frame.copyTo(m_gray);
+    }
+
+    // start over when there is no previous frame to compare with
+    if(m_prevGray.empty() || m_prevGray.size() != m_gray.size())
+    {
+        cv::swap(m_prevGray, m_gray);
+        m_flow.release();
+        return false;
+    }
+
+    // DIS refines a flow field of the right size instead of starting from zero motion, a cleared field starts cold
+    if(!m_warmStart && !m_flow.empty())
+    {
+        m_flow.setTo(cv::Scalar::all(0));
+    }
+    m_algorithm->calc(m_prevGray, m_gray, m_flow);
+    cv::swap(m_prevGray, m_gray);
+    m_framePairs++;
+    return true;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Render the last flow field with its angle as hue and its magnitude as brightness
+ * @param[out] bgrOut the rendered flow
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void DenseFlowEngine::render(cv::Mat &bgrOut)
+{
+    if(m_flow.empty())
+    {
+        return;
+    }
+
+    // convert the flow vectors to angle in degrees and magnitude
+    cv::split(m_flow, m_flowUV);
+    cv::cartToPolar(m_flowUV[0], m_flowUV[1], m_magnitude, m_angle, true);
+    double maxMagnitude = m_maxMagnitude;
+    if(maxMagnitude <= 0.0)
+    {
+        cv::minMaxLoc(m_magnitude, 0, &maxMagnitude);
+    }
+    const float magnitudeScale = static_cast<float>(255.0 / std::max(maxMagnitude, 1e-3));
+
+    // look up the color of every pixel in parallel
+    bgrOut.create(m_flow.rows, m_flow.cols, CV_8UC3);
+    cv::parallel_for_(cv::Range(0, m_flow.rows), [&](const cv::Range &range)
+    {
+        for(int y = range.start; y < range.end; y++)
+        {
+            const float *magnitude = m_magnitude.ptr<float>(y);
+            const float *angle = m_angle.ptr<float>(y);
+            cv::Vec3b *out = bgrOut.ptr<cv::Vec3b>(y);
+            for(int x = 0; x < m_flow.cols; x++)
+            {
+                int hue = static_cast<int>(angle[x] * 0.5f);
+                hue = hue < NUM_HUES ? hue : hue - NUM_HUES;
+                int value = std::min(255, static_cast<int>(magnitude[x] * magnitudeScale + 0.5f));
+                out[x] = m_colorTable.ptr<cv::Vec3b>(hue)[value];
+            }
+        }
+    });
+}
+
+/*******************************************************************************************************************//**
+ * @brief Forget the previous frame and flow, so the next frame starts a new sequence
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void DenseFlowEngine::reset()
+{
+    m_prevGray.release();
+    m_flow.release();
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the last flow field
+ * @return the flow in pixels as CV_32FC2, empty until two frames have been seen
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+const cv::Mat& DenseFlowEngine::getFlow() const
+{
+    return m_flow;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the number of frame pairs flow was computed for
+ * @return the number of flow fields
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+long long DenseFlowEngine::getFramePairs() const
+{
+    return m_framePairs;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get whether the previous flow initializes the next flow computation
+ * @return true if warm starting
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool DenseFlowEngine::isWarmStart() const
+{
+    return m_warmStart;
+}
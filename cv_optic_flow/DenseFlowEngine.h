@@ -0,0 +1,79 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file DenseFlowEngine.h
+ * @brief Header file for the DenseFlowEngine class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#ifndef DENSE_FLOW_ENGINE_H
+#define DENSE_FLOW_ENGINE_H
+
+#include "opencv2/opencv.hpp"
+#include <opencv2/tracking.hpp>
+
+/*******************************************************************************************************************//**
+ * @class DenseFlowEngine
+ *
+ * @brief Class for computing and rendering dense optical flow between consecutive frames
+ *
+ * Flow is computed with DIS. When warm starting, the flow of the previous frame pair is passed back to DIS, which uses
+ * it to initialize the search instead of starting from zero motion. The grey frames, flow field, and rendering buffers
+ * are allocated once and reused for every frame. Rendering maps the flow angle to hue and the magnitude to brightness
+ * through a table of BGR colors computed once, so no per pixel color conversion is needed.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class DenseFlowEngine
+{
+private:
+
+    // engine settings
+    cv::Ptr<cv::DISOpticalFlow> m_algorithm;
+    bool m_warmStart;
+    double m_maxMagnitude;
+
+    // flow state
+    cv::Mat m_gray;
+    cv::Mat m_prevGray;
+    cv::Mat m_flow;
+    long long m_framePairs;
+
+    // rendering buffers and the hue by brightness color table
+    cv::Mat m_flowUV[2];
+    cv::Mat m_magnitude;
+    cv::Mat m_angle;
+    cv::Mat m_colorTable;
+
+public:
+
+    // constructors
+    DenseFlowEngine(int preset=cv::DISOpticalFlow::PRESET_MEDIUM, bool warmStart=true, double maxMagnitude=0.0);
+
+    // flow computation
+    bool compute(const cv::Mat &frame);
+    void render(cv::Mat &bgrOut);
+    void reset();
+
+    // accessors
+    const cv::Mat& getFlow() const;
+    long long getFramePairs() const;
+    bool isWarmStart() const;
+};
+
+#endif // DENSE_FLOW_ENGINE_H
@@ -0,0 +1,219 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file Metrics.h
+ * @brief Header file for the metrics registry and its counter, gauge, and histogram types
+ *
+ * Metrics are updated on the processing path with relaxed atomic operations on per thread shards, and a background
+ * thread periodically writes a snapshot to a local file. Files ending in .jsonl receive one JSON object per line,
+ * any other file is rewritten in the Prometheus text exposition format, suitable for the node exporter textfile
+ * collector.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// number of independent shards per metric, threads are assigned to shards round robin
+#define METRICS_NUM_SHARDS 8
+
+// histogram layout: values are recorded in microseconds with 32 linear sub-buckets per power of two
+#define METRICS_SUB_BUCKET_BITS 5
+#define METRICS_MAX_EXPONENT 40
+
+/*******************************************************************************************************************//**
+ * @class MetricsCounter
+ *
+ * @brief Monotonic counter
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class MetricsCounter
+{
+private:
+
+    // counter shard padded to its own cache line
+    struct Shard
+    {
+        std::atomic<long long> value;
+        char padding[64 - sizeof(std::atomic<long long>)];
+    };
+    Shard m_shards[METRICS_NUM_SHARDS];
+
+public:
+
+    // constructors
+    MetricsCounter();
+
+    // recording
+    void add(long long amount=1);
+
+    // accessors
+    long long get() const;
+};
+
+/*******************************************************************************************************************//**
+ * @class MetricsGauge
+ *
+ * @brief Value that can move up and down, the last write wins
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class MetricsGauge
+{
+private:
+
+    std::atomic<double> m_value;
+
+public:
+
+    // constructors
+    MetricsGauge();
+
+    // recording
+    void set(double value);
+
+    // accessors
+    double get() const;
+};
+
+/*******************************************************************************************************************//**
+ * @class MetricsHistogram
+ *
+ * @brief Latency histogram with bounded relative error
+ *
+ * Durations are stored in microseconds. Each power of two range is split into linear sub-buckets, so every recorded
+ * value is resolved to within about 3% using only integer operations on the recording path. The same histogram backs
+ * the exported metrics and the throughput and latency summary printed by the benchmark modes.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class MetricsHistogram
+{
+private:
+
+    // histogram shard, allocated separately so shards do not share cache lines
+    struct Shard
+    {
+        std::atomic<long long> count;
+        std::atomic<long long> sumMicroseconds;
+        std::atomic<long long> maxMicroseconds;
+        std::vector<std::atomic<long long> > buckets;
+
+        Shard();
+    };
+    std::unique_ptr<Shard> m_shards[METRICS_NUM_SHARDS];
+
+    // helper functions
+    static size_t getBucket(unsigned long long microseconds);
+    static double getBucketValue(size_t bucket);
+
+public:
+
+    // constructors
+    MetricsHistogram();
+
+    // recording
+    void record(double seconds);
+    void reset();
+
+    // accessors
+    long long getCount() const;
+    double getSum() const;
+    double getMean() const;
+    double getMax() const;
+    double getPercentile(double percentile) const;
+
+    // reporting
+    void printSummary(const char *label, double elapsedSeconds) const;
+};
+
+/*******************************************************************************************************************//**
+ * @class MetricsRegistry
+ *
+ * @brief Class for registering metrics and writing snapshots of them to a file
+ *
+ * Metrics should be registered once at startup; the returned references remain valid for the lifetime of the
+ * registry and can be updated from any thread without locking.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class MetricsRegistry
+{
+private:
+
+    // registered metric
+    struct Entry
+    {
+        std::string name;
+        std::string help;
+        std::unique_ptr<MetricsCounter> counter;
+        std::unique_ptr<MetricsGauge> gauge;
+        std::unique_ptr<MetricsHistogram> histogram;
+    };
+
+    // registered metrics
+    std::string m_prefix;
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<Entry> > m_entries;
+
+    // dump thread state
+    std::string m_path;
+    double m_intervalSeconds;
+    std::thread m_thread;
+    std::mutex m_dumpMutex;
+    std::condition_variable m_dumpCondition;
+    bool m_stop;
+
+    // helper functions
+    Entry& findOrCreate(const std::string &name, const std::string &help);
+    void runDumper();
+
+public:
+
+    // constructors
+    MetricsRegistry(const std::string &prefix="");
+    ~MetricsRegistry();
+
+    // registration
+    MetricsCounter& counter(const std::string &name, const std::string &help="");
+    MetricsGauge& gauge(const std::string &name, const std::string &help="");
+    MetricsHistogram& histogram(const std::string &name, const std::string &help="");
+
+    // output
+    std::string formatPrometheus() const;
+    std::string formatJson() const;
+    bool dump(const std::string &path) const;
+    bool startDumping(const std::string &path, double intervalSeconds=1.0);
+    void stopDumping();
+};
+
+// command line helpers
+bool extractFlag(int &argc, char **argv, const char *flag);
+bool extractOption(int &argc, char **argv, const char *name, std::string &valueOut);
+
+#endif // METRICS_H
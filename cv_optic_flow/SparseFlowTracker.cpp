@@ -0,0 +1,280 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file SparseFlowTracker.cpp
+ * @brief Implementation of the SparseFlowTracker class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#include "SparseFlowTracker.h"
+
+#include <algorithm>
+
+// longest number of frames an empty cell is skipped before it is searched again
+#define MAX_CELL_BACKOFF 32
+
+/*******************************************************************************************************************//**
+ * @brief Class constructor
+ * @param[in] maxPoints number of points to keep tracking
+ * @param[in] winSize size of the Lucas-Kanade search window in pixels
+ * @param[in] maxLevel deepest pyramid level, 0 tracks at full resolution only
+ * @param[in] gridSize number of redetection cells along each side of the frame
+ * @param[in] qualityLevel minimum corner strength relative to the strongest corner of a cell
+ * @param[in] minDistance minimum distance in pixels between points
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+SparseFlowTracker::SparseFlowTracker(int maxPoints, int winSize, int maxLevel, int gridSize, double qualityLevel, int minDistance) : m_maxPoints(maxPoints), m_winSize(winSize, winSize), m_maxLevel(maxLevel), m_gridSize(std::max(1, gridSize)), m_qualityLevel(qualityLevel), m_minDistance(minDistance), m_lostPoints(0), m_detectedPoints(0)
+{
+    // a few iterations are enough when the previous pyramid already has the gradients
+    m_criteria = cv::TermCriteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, 10, 0.03);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the rectangle of a grid cell
+ * @param[in] cell the cell index, in row major order
+ * @return the cell rectangle in the current frame
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+cv::Rect SparseFlowTracker::getCellRect(int cell) const
+{
+    const int col = cell % m_gridSize;
+    const int row = cell / m_gridSize;
+    const int x = col * m_gray.cols / m_gridSize;
+    const int y = row * m_gray.rows / m_gridSize;
+    return cv::Rect(x, y, (col + 1) * m_gray.cols / m_gridSize - x, (row + 1) * m_gray.rows / m_gridSize - y);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the grid cell that contains a point
+ * @param[in] point a point inside the current frame
+ * @return the cell index, in row major order
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+int SparseFlowTracker::getCell(const cv::Point2f &point) const
+{
+    const int col = std::min(m_gridSize - 1, static_cast<int>(point.x * m_gridSize / m_gray.cols));
+    const int row = std::min(m_gridSize - 1, static_cast<int>(point.y * m_gridSize / m_gray.rows));
+    return row * m_gridSize + col;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Detect new corners in the grid cells that have lost too many points
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void SparseFlowTracker::detectPoints()
+{
+    // count the points in each cell, a cell is refilled once it has lost more than half of its share
+    const int numCells = m_gridSize * m_gridSize;
+    const int cellTarget = std::max(1, m_maxPoints / numCells);
+    m_cellCounts.assign(numCells, 0);
+    for(size_t i = 0; i < m_points.size(); i++)
+    {
+        m_cellCounts[getCell(m_points[i])]++;
+    }
+    if(static_cast<int>(m_cellCooldown.size()) != numCells)
+    {
+        m_cellBackoff.assign(numCells, 0);
+        m_cellCooldown.assign(numCells, 0);
+    }
+
+    // search the cells that need points, except the ones backing off after coming back empty
+    bool refill = false;
+    m_cellSearched.assign(numCells, 0);
+    for(int cell = 0; cell < numCells; cell++)
+    {
+        if(m_cellCooldown[cell] > 0)
+        {
+            m_cellCooldown[cell]--;
+            continue;
+        }
+        m_cellSearched[cell] = m_cellCounts[cell] * 2 < cellTarget ? 1 : 0;
+        refill = refill || m_cellSearched[cell];
+    }
+    if(!refill)
+    {
+        return;
+    }
+
+    // keep new corners away from the points that are still tracked, the mask is only read inside the searched cells
+    m_mask.create(m_gray.rows, m_gray.cols, CV_8UC1);
+    for(int cell = 0; cell < numCells; cell++)
+    {
+        if(m_cellSearched[cell])
+        {
+            m_mask(getCellRect(cell)).setTo(cv::Scalar(255));
+        }
+    }
+    const float radius = static_cast<float>(m_minDistance);
+    const float maxX = static_cast<float>(m_gray.cols - 1);
+    const float maxY = static_cast<float>(m_gray.rows - 1);
+    for(size_t i = 0; i < m_points.size(); i++)
+    {
+        const cv::Point2f &point = m_points[i];
+        const float left = std::max(0.0f, point.x - radius);
+        const float right = std::min(maxX, point.x + radius);
+        const float top = std::max(0.0f, point.y - radius);
+        const float bottom = std::min(maxY, point.y + radius);
+
+        // the circle may span several cells when they are narrower than its diameter, check every cell it overlaps
+        const int firstCell = getCell(cv::Point2f(left, top));
+        const int lastCell = getCell(cv::Point2f(right, bottom));
+        bool overlapsSearched = false;
+        for(int row = firstCell / m_gridSize; row <= lastCell / m_gridSize && !overlapsSearched; row++)
+        {
+            for(int col = firstCell % m_gridSize; col <= lastCell % m_gridSize && !overlapsSearched; col++)
+            {
+                overlapsSearched = m_cellSearched[row * m_gridSize + col] != 0;
+            }
+        }
+        if(overlapsSearched)
+        {
+            cv::circle(m_mask, point, m_minDistance, cv::Scalar(0), cv::FILLED);
+        }
+    }
+
+    // detect only inside the searched cells, so the corner response is not computed for the whole frame
+    for(int cell = 0; cell < numCells; cell++)
+    {
+        if(!m_cellSearched[cell])
+        {
+            continue;
+        }
+        cv::Rect cellRect = getCellRect(cell);
+        cv::goodFeaturesToTrack(m_gray(cellRect), m_corners, cellTarget - m_cellCounts[cell], m_qualityLevel, m_minDistance, m_mask(cellRect));
+        for(size_t i = 0; i < m_corners.size(); i++)
+        {
+            cv::Point2f point(m_corners[i].x + cellRect.x, m_corners[i].y + cellRect.y);
+            m_points.push_back(point);
+            m_trackedPoints.push_back(point);
+        }
+        m_detectedPoints += static_cast<int>(m_corners.size());
+
+        // wait twice as long before searching a cell again each time it has no corners
+        m_cellBackoff[cell] = m_corners.empty() ? std::min(std::max(1, m_cellBackoff[cell] * 2), MAX_CELL_BACKOFF) : 0;
+        m_cellCooldown[cell] = m_cellBackoff[cell];
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Track the points into a new frame and replace the lost ones
+ * @param[in] frame the new BGR or grey frame
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void SparseFlowTracker::track(const cv::Mat &frame)
+{
+    if(frame.channels() == 3)
+    {
+        cv::cvtColor(frame, m_gray, cv::COLOR_BGR2GRAY);
+    }
+    else
+    {
+        frame.copyTo(m_gray);
+    }
+    if(m_prevGray.size() != m_gray.size())
+    {
+        reset();
+    }
+
+    // build the pyramid of this frame once, it is the previous pyramid of the next frame
+    cv::buildOpticalFlowPyramid(m_gray, m_pyramid, m_winSize, m_maxLevel);
+
+    // track the points from the previous frame and drop the ones that were lost or left the frame
+    m_lostPoints = 0;
+    m_detectedPoints = 0;
+    m_trackedPoints.clear();
+    m_points.clear();
+    if(!m_prevPoints.empty())
+    {
+        cv::calcOpticalFlowPyrLK(m_prevPyramid, m_pyramid, m_prevPoints, m_points, m_status, m_error, m_winSize, m_maxLevel, m_criteria);
+        const cv::Rect2f frameRect(0.0f, 0.0f, static_cast<float>(m_gray.cols), static_cast<float>(m_gray.rows));
+        size_t kept = 0;
+        for(size_t i = 0; i < m_points.size(); i++)
+        {
+            if(m_status[i] && frameRect.contains(m_points[i]))
+            {
+                m_points[kept++] = m_points[i];
+                m_trackedPoints.push_back(m_prevPoints[i]);
+            }
+        }
+        m_lostPoints = static_cast<int>(m_points.size() - kept);
+        m_points.resize(kept);
+    }
+
+    // refill the cells that lost points, new points start where they are detected
+    detectPoints();
+
+    // keep this frame for the next one
+    cv::swap(m_prevGray, m_gray);
+    m_prevPyramid.swap(m_pyramid);
+    m_prevPoints = m_points;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Forget the previous frame and points, so the next frame starts with new detections
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void SparseFlowTracker::reset()
+{
+    m_prevGray.release();
+    m_prevPyramid.clear();
+    m_prevPoints.clear();
+    m_points.clear();
+    m_trackedPoints.clear();
+    m_cellBackoff.clear();
+    m_cellCooldown.clear();
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the tracked points
+ * @return the point positions in the last frame
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+const std::vector<cv::Point2f>& SparseFlowTracker::getPoints() const
+{
+    return m_points;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the positions of the tracked points in the frame before the last one
+ * @return the previous positions, in the same order as the points, new points are at their detected position
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+const std::vector<cv::Point2f>& SparseFlowTracker::getPreviousPoints() const
+{
+    return m_trackedPoints;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the number of points lost in the last frame
+ * @return the number of lost points
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+int SparseFlowTracker::getLostPoints() const
+{
+    return m_lostPoints;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the number of points detected in the last frame
+ * @return the number of new points
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+int SparseFlowTracker::getDetectedPoints() const
+{
+    return m_detectedPoints;
+}
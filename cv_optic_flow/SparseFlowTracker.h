@@ -0,0 +1,103 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file SparseFlowTracker.h
+ * @brief Header file for the SparseFlowTracker class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#ifndef SPARSE_FLOW_TRACKER_H
+#define SPARSE_FLOW_TRACKER_H
+
+#include <vector>
+#include "opencv2/opencv.hpp"
+
+/*******************************************************************************************************************//**
+ * @class SparseFlowTracker
+ *
+ * @brief Class for tracking corner features between frames with pyramidal Lucas-Kanade flow
+ *
+ * The image pyramid of each frame, with its gradients, is built once and kept as the previous pyramid for the next
+ * frame, so every pyramid is built once instead of twice. The frame is divided into a grid, and new corners are only
+ * detected in the cells that have lost more than half of their share of the points, using a mask that keeps the new
+ * corners away from the points still being tracked. A cell where detection finds no corners, such as sky or a blank
+ * wall, is skipped for a number of frames that doubles every time it comes back empty, and the mask is only prepared
+ * inside the cells being searched.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class SparseFlowTracker
+{
+private:
+
+    // tracker settings
+    int m_maxPoints;
+    cv::Size m_winSize;
+    int m_maxLevel;
+    int m_gridSize;
+    double m_qualityLevel;
+    int m_minDistance;
+    cv::TermCriteria m_criteria;
+
+    // current and previous frames, the pyramids may refer to the grey images
+    cv::Mat m_gray;
+    cv::Mat m_prevGray;
+    std::vector<cv::Mat> m_pyramid;
+    std::vector<cv::Mat> m_prevPyramid;
+
+    // tracked points and their positions in the previous frame
+    std::vector<cv::Point2f> m_points;
+    std::vector<cv::Point2f> m_prevPoints;
+    std::vector<cv::Point2f> m_trackedPoints;
+    std::vector<uchar> m_status;
+    std::vector<float> m_error;
+
+    // redetection buffers and the per cell back off
+    cv::Mat m_mask;
+    std::vector<int> m_cellCounts;
+    std::vector<int> m_cellBackoff;
+    std::vector<int> m_cellCooldown;
+    std::vector<uchar> m_cellSearched;
+    std::vector<cv::Point2f> m_corners;
+
+    // statistics of the last frame
+    int m_lostPoints;
+    int m_detectedPoints;
+
+    // helper functions
+    cv::Rect getCellRect(int cell) const;
+    int getCell(const cv::Point2f &point) const;
+    void detectPoints();
+
+public:
+
+    // constructors
+    SparseFlowTracker(int maxPoints=2000, int winSize=21, int maxLevel=3, int gridSize=8, double qualityLevel=0.01, int minDistance=7);
+
+    // tracking
+    void track(const cv::Mat &frame);
+    void reset();
+
+    // accessors
+    const std::vector<cv::Point2f>& getPoints() const;
+    const std::vector<cv::Point2f>& getPreviousPoints() const;
+    int getLostPoints() const;
+    int getDetectedPoints() const;
+};
+
+#endif // SPARSE_FLOW_TRACKER_H
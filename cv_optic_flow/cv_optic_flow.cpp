@@ -24,16 +24,31 @@
 // include necessary dependencies
 #include <iostream>
 #include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
 #include "opencv2/opencv.hpp"
 #include <opencv2/tracking.hpp>
 #include <opencv2/core/ocl.hpp>
+#include "Metrics.h"
+#include "DenseFlowEngine.h"
+#include "SparseFlowTracker.h"
 
 // configuration parameters
 #define NUM_COMNMAND_LINE_ARGUMENTS 1
 #define DISPLAY_WINDOW_NAME "Video Frame"
+#define FLOW_WINDOW_NAME "Optic Flow"
+#define DEFAULT_MAX_FLOW 0.0
+#define DEFAULT_MAX_POINTS 2000
 
 /*******************************************************************************************************************//**
  * @brief program entry point
+ *
+ * Dense flow is computed between every pair of consecutive frames. It is shown with its angle as hue and magnitude as
+ * brightness, or in headless mode each flow field can be written to disk in the Middlebury .flo format. In sparse mode
+ * corner features are tracked instead, and drawn with their motion since the previous frame.
+ *
  * @param[in] argc number of command line arguments
  * @param[in] argv string array of command line arguments
  * @return return code (0 for normal termination)
@@ -44,10 +59,54 @@ int main(int argc, char **argv)
     // store video capture parameters
     std::string fileName;
 
+    // run without display or pacing if requested
+    bool benchMode = extractFlag(argc, argv, "--bench");
+
+    // write metrics to a file instead of printing per frame timing, if requested
+    std::string metricsPath;
+    bool metricsEnabled = extractOption(argc, argv, "--metrics", metricsPath);
+
+    // write every flow field to a directory, if requested
+    std::string flowDirectory;
+    bool writeFlow = extractOption(argc, argv, "--write-flow", flowDirectory);
+
+    // parse the flow options
+    std::string optionValue;
+    int preset = cv::DISOpticalFlow::PRESET_MEDIUM;
+    if(extractOption(argc, argv, "--preset", optionValue))
+    {
+        if(optionValue == "ultrafast")
+        {
+            preset = cv::DISOpticalFlow::PRESET_ULTRAFAST;
+        }
+        else if(optionValue == "fast")
+        {
+            preset = cv::DISOpticalFlow::PRESET_FAST;
+        }
+    }
+    double maxFlow = DEFAULT_MAX_FLOW;
+    if(extractOption(argc, argv, "--max-flow", optionValue))
+    {
+        maxFlow = std::atof(optionValue.c_str());
+    }
+    bool coldStart = extractFlag(argc, argv, "--cold-start");
+
+    // track sparse features instead of computing dense flow, if requested
+    bool sparseMode = extractFlag(argc, argv, "--sparse");
+    int maxPoints = DEFAULT_MAX_POINTS;
+    if(extractOption(argc, argv, "--points", optionValue))
+    {
+        maxPoints = std::max(1, std::atoi(optionValue.c_str()));
+    }
+    if(extractOption(argc, argv, "--threads", optionValue))
+    {
+        cv::setNumThreads(std::atoi(optionValue.c_str()));
+    }
+
     // validate and parse the command line arguments
     if(argc != NUM_COMNMAND_LINE_ARGUMENTS + 1)
     {
-        std::cout << "USAGE:" << argv[0] << " <file_path" << std::endl;
+        std::cout << "USAGE:" << argv[0] << " <file_path> [--preset=ultrafast|fast|medium] [--max-flow=<pixels>] [--cold-start] [--write-flow=<directory>] [--sparse] [--points=<count>] [--threads=<count>] [--bench] [--metrics=<path>]" << std::endl;
         return 0;
     }
     else
@@ -70,74 +129,142 @@ int main(int argc, char **argv)
     int captureFPS = static_cast<int>(capture.get(cv::CAP_PROP_FPS));
     std::cout << "Video source opened successfully (width=" << captureWidth << " height=" << captureHeight << " fps=" << captureFPS << ")!" << std::endl;
 
-    // create image window
-    cv::namedWindow(DISPLAY_WINDOW_NAME, cv::WINDOW_AUTOSIZE);
-
-    /*
-    // create the tracker object
-    std::string trackerTypes[9] = {"CSRT", "GOTURN", "KCF", "MIL"};
-    std::string trackerType = trackerTypes[trackerSelection];
-    cv::Ptr<cv::Tracker> tracker;
-    if (trackerType == "CSRT")
-        tracker = cv::TrackerCSRT::create();
-    if (trackerType == "GOTURN")
-        tracker = cv::TrackerGOTURN::create();
-    if (trackerType == "KCF")
-        tracker = cv::TrackerKCF::create();
-    if (trackerType == "MIL")
-        tracker = cv::TrackerMIL::create();
-    */
-
-    // declare variables for tracking
-    //cv::Rect roi;
-    //cv::Mat frame;
-
-    // get bounding box
-    //bool captureSuccess = capture.read(frame);
-    //roi = cv::selectROI(DISPLAY_WINDOW_NAME, frame);
-    /*
-    // exit if ROI was not selected
-    if(roi.width==0 || roi.height==0)
+    // flow fields are only written in dense mode
+    if(sparseMode && writeFlow)
     {
-        return 0;
+        std::printf("Flow fields are not written in sparse mode \n");
+        writeFlow = false;
     }
 
-    // initialize the tracker
-    tracker->init(frame,roi);
-    */
+    // create image windows
+    if(!benchMode)
+    {
+        cv::namedWindow(DISPLAY_WINDOW_NAME, cv::WINDOW_AUTOSIZE);
+        if(!sparseMode)
+        {
+            cv::namedWindow(FLOW_WINDOW_NAME, cv::WINDOW_AUTOSIZE);
+        }
+    }
 
-    // declare variables for tracking
+    // create the flow engine, its buffers are reused for every frame
+    DenseFlowEngine flowEngine(preset, !coldStart, maxFlow);
+    SparseFlowTracker pointTracker(maxPoints);
     cv::Mat frame;
-    cv::Mat frameGray;
-    cv::Mat prevGray;
-    
-    cv::Mat prevgray, gray, rgb;
-    cv::Mat flow, flow_uv[2];
-    cv::Mat mag, ang;
-    cv::Mat hsv_split[3], hsv;
-    char ret;
-
-    cv::Ptr<cv::DenseOpticalFlow> algorithm = cv::DISOpticalFlow::create(cv::DISOpticalFlow::PRESET_MEDIUM);
+    cv::Mat flowImage;
+    char flowPath[1024];
 
+    // register the frame metrics, written to a file in the background if requested
+    MetricsRegistry metrics("cv_optic_flow");
+    MetricsCounter &framesTotal = metrics.counter("frames_total", "Frames processed");
+    MetricsHistogram &frameSeconds = metrics.histogram("frame_seconds", "Frame processing time in seconds");
+    MetricsHistogram &flowSeconds = metrics.histogram("flow_seconds", "Dense flow computation time in seconds");
+    MetricsHistogram &trackSeconds = metrics.histogram("track_seconds", "Sparse point tracking time in seconds");
+    MetricsHistogram &renderSeconds = metrics.histogram("render_seconds", "Flow rendering time in seconds");
+    MetricsHistogram &writeSeconds = metrics.histogram("write_seconds", "Flow file writing time in seconds");
+    MetricsGauge &trackedPoints = metrics.gauge("tracked_points", "Sparse feature points being tracked");
+    MetricsCounter &lostPointsTotal = metrics.counter("lost_points_total", "Sparse feature points lost");
+    MetricsCounter &detectedPointsTotal = metrics.counter("detected_points_total", "Sparse feature points detected");
+    if(metricsEnabled)
+    {
+        metrics.startDumping(metricsPath);
+    }
 
-    // perform tracking iterations on each frame
-    std::cout << "Starting tracker, press 'q' to quit" << std::endl;
+    // compute flow on each frame
+    if(sparseMode)
+    {
+        std::cout << "Starting sparse flow with up to " << maxPoints << " points, press 'q' to quit" << std::endl;
+    }
+    else
+    {
+        std::cout << "Starting " << (flowEngine.isWarmStart() ? "warm" : "cold") << " started dense flow, press 'q' to quit" << std::endl;
+    }
     bool tracking = true;
+    double benchStartTicks = static_cast<double>(cv::getTickCount());
     while(tracking)
     {
+        // get the start time
+        double startTicks = static_cast<double>(cv::getTickCount());
+
         // get frame from the video
         bool captureSuccess = capture.read(frame);
-        if(captureSuccess)
+        bool flowReady = false;
+        if(captureSuccess && sparseMode)
+        {
+            // track the points from the previous frame and refill the areas that lost them
+            double stageTicks = static_cast<double>(cv::getTickCount());
+            pointTracker.track(frame);
+            trackSeconds.record((static_cast<double>(cv::getTickCount()) - stageTicks) / cv::getTickFrequency());
+            trackedPoints.set(static_cast<double>(pointTracker.getPoints().size()));
+            lostPointsTotal.add(pointTracker.getLostPoints());
+            detectedPointsTotal.add(pointTracker.getDetectedPoints());
+
+            // record the frame processing time
+            double elapsedTime = (static_cast<double>(cv::getTickCount()) - startTicks) / cv::getTickFrequency();
+            frameSeconds.record(elapsedTime);
+            framesTotal.add();
+        }
+        else if(captureSuccess)
         {
-            // convert the frame to grayscale
-            cv::cvtColor(frame, frameGray, cv::COLOR_BGR2GRAY);
+            // compute the flow from the previous frame
+            double stageTicks = static_cast<double>(cv::getTickCount());
+            flowReady = flowEngine.compute(frame);
+            if(flowReady)
+            {
+                flowSeconds.record((static_cast<double>(cv::getTickCount()) - stageTicks) / cv::getTickFrequency());
+            }
 
-            // update the tracking result
-            //tracker->update(frame,roi);
+            // render the flow for display
+            if(flowReady && !benchMode)
+            {
+                stageTicks = static_cast<double>(cv::getTickCount());
+                flowEngine.render(flowImage);
+                renderSeconds.record((static_cast<double>(cv::getTickCount()) - stageTicks) / cv::getTickFrequency());
+            }
+
+            // write the flow field, numbered by the frame it ends on
+            if(flowReady && writeFlow)
+            {
+                stageTicks = static_cast<double>(cv::getTickCount());
+                std::snprintf(flowPath, sizeof(flowPath), "%s/flow_%06lld.flo", flowDirectory.c_str(), flowEngine.getFramePairs());
+                if(!cv::writeOpticalFlow(flowPath, flowEngine.getFlow()))
+                {
+                    std::printf("Unable to write %s, terminating program! \n", flowPath);
+                    tracking = false;
+                }
+                writeSeconds.record((static_cast<double>(cv::getTickCount()) - stageTicks) / cv::getTickFrequency());
+            }
 
-            // annotate and show the frame
-            //cv::rectangle(frame, roi, cv::Scalar( 255, 0, 0 ), 2, 1 );
+            // record the frame processing time
+            double elapsedTime = (static_cast<double>(cv::getTickCount()) - startTicks) / cv::getTickFrequency();
+            frameSeconds.record(elapsedTime);
+            framesTotal.add();
+        }
+        else if(benchMode)
+        {
+            // stop at the end of the video when benchmarking
+            tracking = false;
+        }
+
+        if(captureSuccess && !benchMode)
+        {
+            // draw the motion of every sparse point since the previous frame
+            if(sparseMode)
+            {
+                const std::vector<cv::Point2f> &points = pointTracker.getPoints();
+                const std::vector<cv::Point2f> &previousPoints = pointTracker.getPreviousPoints();
+                for(size_t i = 0; i < points.size(); i++)
+                {
+                    cv::line(frame, previousPoints[i], points[i], cv::Scalar(0, 255, 0), 1);
+                    cv::circle(frame, points[i], 2, cv::Scalar(0, 0, 255), cv::FILLED);
+                }
+            }
+
+            // show the frame and its flow
             cv::imshow(DISPLAY_WINDOW_NAME, frame);
+            if(flowReady)
+            {
+                cv::imshow(FLOW_WINDOW_NAME, flowImage);
+            }
 
             // check for user termination
             if(cv::waitKey(1)=='q')
@@ -147,6 +274,14 @@ int main(int argc, char **argv)
         }
     }
 
+    // report the throughput and latency distribution
+    double benchElapsedTime = (static_cast<double>(cv::getTickCount()) - benchStartTicks) / cv::getTickFrequency();
+    frameSeconds.printSummary("cv_optic_flow", benchElapsedTime);
+    if(!sparseMode)
+    {
+        std::printf("Computed %lld flow fields \n", flowEngine.getFramePairs());
+    }
+
     // release program resources before returning
     capture.release();
 }
@@ -0,0 +1,266 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file ScaledTracker.cpp
+ * @brief Implementation of the ScaledTracker class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#include "ScaledTracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+// deepest pyramid level, 1/64 scale
+#define MAX_LEVEL 6
+
+// side of the search region around the target, in target sizes
+#define SEARCH_SCALE 3
+
+// minimum correlation for the refined position to be used, and to replace the template
+#define REFINE_MIN_SCORE 0.6
+#define TEMPLATE_UPDATE_SCORE 0.8
+
+/*******************************************************************************************************************//**
+ * @brief Class constructor
+ * @param[in] tracker the tracker to run on the downscaled frames
+ * @param[in] targetSize longest side of the target in pixels on the tracked pyramid level
+ * @param[in] refine whether to refine the scaled box at full resolution
+ * @param[in] patchSize longest side of the full resolution patch used for refinement
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+ScaledTracker::ScaledTracker(const cv::Ptr<cv::Tracker> &tracker, int targetSize, bool refine, int patchSize) : m_tracker(tracker), m_targetSize(std::max(8, targetSize)), m_refine(refine), m_patchSize(std::max(8, patchSize)), m_level(0), m_scale(1.0), m_refineScore(0.0)
+{
+}
+
+/*******************************************************************************************************************//**
+ * @brief Choose the pyramid level for a target size
+ * @param[in] boxSize the target size at full resolution
+ * @return the deepest level where the longest side of the target is at least the target size
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+int ScaledTracker::chooseLevel(const cv::Size &boxSize) const
+{
+    const int side = std::max(boxSize.width, boxSize.height);
+    int level = 0;
+    while(level < MAX_LEVEL && (side >> (level + 1)) >= m_targetSize)
+    {
+        level++;
+    }
+    return level;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Crop the search region from a frame and shrink it to the current pyramid level
+ * @param[in] frame the full resolution frame
+ * @return the search region at the current level
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+const cv::Mat& ScaledTracker::downscaleRegion(const cv::Mat &frame)
+{
+    // only the region is filtered, so the cost depends on the target size and not on the frame size
+    m_pyramid.resize(m_level + 1);
+    m_pyramid[0] = frame(m_region);
+    for(int level = 1; level <= m_level; level++)
+    {
+        cv::pyrDown(m_pyramid[level - 1], m_pyramid[level]);
+    }
+    return m_pyramid[m_level];
+}
+
+/*******************************************************************************************************************//**
+ * @brief Choose the level and search region for a box and initialize the wrapped tracker on them
+ * @param[in] frame the full resolution frame
+ * @param[in] box the target box at full resolution
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void ScaledTracker::initLevel(const cv::Mat &frame, const cv::Rect &box)
+{
+    m_level = chooseLevel(box.size());
+    m_scale = 1.0 / (1 << m_level);
+
+    // center the search region on the target, clamped to the frame
+    const int width = std::max(1, box.width * SEARCH_SCALE);
+    const int height = std::max(1, box.height * SEARCH_SCALE);
+    m_anchor = cv::Point2d(box.x + box.width * 0.5, box.y + box.height * 0.5);
+    m_region = cv::Rect(cvRound(m_anchor.x - width * 0.5), cvRound(m_anchor.y - height * 0.5), width, height) & cv::Rect(0, 0, frame.cols, frame.rows);
+    if(m_region.area() <= 0)
+    {
+        m_region = cv::Rect(0, 0, frame.cols, frame.rows);
+    }
+
+    // initialize on the region, in region coordinates
+    const cv::Rect localBox = (box & m_region) - m_region.tl();
+    cv::Rect scaledBox(cvRound(localBox.x * m_scale), cvRound(localBox.y * m_scale), std::max(1, cvRound(localBox.width * m_scale)), std::max(1, cvRound(localBox.height * m_scale)));
+    m_tracker->init(downscaleRegion(frame), scaledBox);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the full resolution refinement patch at the center of a box
+ * @param[in] box the target box
+ * @return the patch rectangle
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+cv::Rect ScaledTracker::getPatchRect(const cv::Rect &box) const
+{
+    const int width = std::min(box.width, m_patchSize);
+    const int height = std::min(box.height, m_patchSize);
+    return cv::Rect(box.x + (box.width - width) / 2, box.y + (box.height - height) / 2, width, height);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Move a box to the best match of the template within the rounding error of the pyramid level
+ * @param[in] frame the full resolution frame
+ * @param[in,out] box the scaled box at full resolution, moved to the refined position
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void ScaledTracker::refineBox(const cv::Mat &frame, cv::Rect &box)
+{
+    m_refineScore = 0.0;
+    if(m_template.empty())
+    {
+        return;
+    }
+
+    // search one coarse pixel around the expected patch position
+    const cv::Rect frameRect(0, 0, frame.cols, frame.rows);
+    const int radius = (1 << m_level) + 1;
+    cv::Rect patch = getPatchRect(box);
+    cv::Rect expected(patch.x, patch.y, m_template.cols, m_template.rows);
+    cv::Rect window = cv::Rect(expected.x - radius, expected.y - radius, expected.width + 2 * radius, expected.height + 2 * radius) & frameRect;
+    if(window.width < m_template.cols || window.height < m_template.rows)
+    {
+        return;
+    }
+    cv::matchTemplate(frame(window), m_template, m_response, cv::TM_CCOEFF_NORMED);
+    cv::Point bestLoc;
+    cv::minMaxLoc(m_response, 0, &m_refineScore, 0, &bestLoc);
+    if(m_refineScore < REFINE_MIN_SCORE)
+    {
+        return;
+    }
+    box.x += window.x + bestLoc.x - expected.x;
+    box.y += window.y + bestLoc.y - expected.y;
+
+    // follow slow appearance changes while the match is strong
+    if(m_refineScore >= TEMPLATE_UPDATE_SCORE)
+    {
+        cv::Rect refined(window.x + bestLoc.x, window.y + bestLoc.y, m_template.cols, m_template.rows);
+        frame(refined).copyTo(m_template);
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Initialize the tracker with a target
+ * @param[in] image the full resolution frame
+ * @param[in] boundingBox the target box at full resolution
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void ScaledTracker::init(cv::InputArray image, const cv::Rect &boundingBox)
+{
+    cv::Mat frame = image.getMat();
+    initLevel(frame, boundingBox);
+
+    // refinement is only needed when the box is rounded to a coarse level
+    m_template.release();
+    cv::Rect patch = getPatchRect(boundingBox);
+    if(m_refine && patch.area() > 0 && (patch & cv::Rect(0, 0, frame.cols, frame.rows)) == patch)
+    {
+        frame(patch).copyTo(m_template);
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Update the tracker with a new frame
+ * @param[in] image the full resolution frame
+ * @param[out] boundingBox the target box at full resolution
+ * @return true if the target was found
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool ScaledTracker::update(cv::InputArray image, cv::Rect &boundingBox)
+{
+    // track on the search region at the pyramid level and move the box back to the full frame
+    cv::Mat frame = image.getMat();
+    if((m_region & cv::Rect(0, 0, frame.cols, frame.rows)) != m_region)
+    {
+        return false;
+    }
+    cv::Rect scaledBox;
+    if(!m_tracker->update(downscaleRegion(frame), scaledBox))
+    {
+        return false;
+    }
+    cv::Rect box(cvRound(scaledBox.x / m_scale) + m_region.x, cvRound(scaledBox.y / m_scale) + m_region.y, cvRound(scaledBox.width / m_scale), cvRound(scaledBox.height / m_scale));
+    if(m_refine && m_level > 0)
+    {
+        refineBox(frame, box);
+    }
+    boundingBox = box;
+
+    // move to another level when the target has grown or shrunk too far, with hysteresis to avoid switching back, and
+    // recenter the search region once the target has moved a third of the way from its center toward its edge
+    const double side = std::max(box.width, box.height) * m_scale;
+    const double dx = std::abs(box.x + box.width * 0.5 - m_anchor.x);
+    const double dy = std::abs(box.y + box.height * 0.5 - m_anchor.y);
+    const bool drifted = dx > m_region.width / 6.0 || dy > m_region.height / 6.0;
+    if(drifted || side >= 4.0 * m_targetSize || (m_level > 0 && side < 0.5 * m_targetSize))
+    {
+        initLevel(frame, box);
+    }
+    return true;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the tracked pyramid level
+ * @return the level, 0 is full resolution
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+int ScaledTracker::getLevel() const
+{
+    return m_level;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the scale of the tracked pyramid level
+ * @return the scale relative to the full resolution frame
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+double ScaledTracker::getScale() const
+{
+    return m_scale;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the search region the wrapped tracker runs on
+ * @return the region in full resolution frame coordinates
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+const cv::Rect& ScaledTracker::getSearchRegion() const
+{
+    return m_region;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the correlation of the last refinement
+ * @return the normalized correlation, 0 if the box was not refined
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+double ScaledTracker::getRefineScore() const
+{
+    return m_refineScore;
+}
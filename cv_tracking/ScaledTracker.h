@@ -0,0 +1,94 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file ScaledTracker.h
+ * @brief Header file for the ScaledTracker class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#ifndef SCALED_TRACKER_H
+#define SCALED_TRACKER_H
+
+#include <vector>
+#include "opencv2/opencv.hpp"
+#include <opencv2/tracking.hpp>
+
+/*******************************************************************************************************************//**
+ * @class ScaledTracker
+ *
+ * @brief Class for running a tracker on a downscaled copy of the neighbourhood of its target
+ *
+ * The cost of CSRT and KCF grows with the size of the target, so the wrapped tracker runs on the pyramid level where the
+ * longest side of the target is between one and two times the target size, and the resulting box is scaled back to full
+ * resolution. Only a search region of three times the target size around the target is cropped and downscaled, so the
+ * cost per frame stays roughly constant as the input resolution grows. Levels are built from the crop with repeated
+ * Gaussian pyrDown steps, which low pass filter each halving instead of aliasing like a single large resize. The search
+ * region stays fixed while the target moves inside it, since the wrapped tracker keeps its state in region
+ * coordinates, and is centered on the target again when the target drifts toward its edge. The level is chosen again
+ * when the target grows or shrinks by more than a factor of two. The optional refinement matches a small
+ * full resolution patch from the center of the target within a few pixels of the scaled box, which removes the error
+ * from rounding the box to the coarse level.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class ScaledTracker : public cv::Tracker
+{
+private:
+
+    // tracker settings
+    cv::Ptr<cv::Tracker> m_tracker;
+    int m_targetSize;
+    bool m_refine;
+    int m_patchSize;
+
+    // tracking state, the search region and its anchor are in full resolution frame coordinates
+    int m_level;
+    double m_scale;
+    cv::Rect m_region;
+    cv::Point2d m_anchor;
+    double m_refineScore;
+
+    // scratch buffers
+    std::vector<cv::Mat> m_pyramid;
+    cv::Mat m_template;
+    cv::Mat m_response;
+
+    // helper functions
+    int chooseLevel(const cv::Size &boxSize) const;
+    const cv::Mat& downscaleRegion(const cv::Mat &frame);
+    void initLevel(const cv::Mat &frame, const cv::Rect &box);
+    cv::Rect getPatchRect(const cv::Rect &box) const;
+    void refineBox(const cv::Mat &frame, cv::Rect &box);
+
+public:
+
+    // constructors
+    ScaledTracker(const cv::Ptr<cv::Tracker> &tracker, int targetSize=64, bool refine=false, int patchSize=32);
+
+    // tracking
+    void init(cv::InputArray image, const cv::Rect &boundingBox);
+    bool update(cv::InputArray image, cv::Rect &boundingBox);
+
+    // accessors
+    int getLevel() const;
+    double getScale() const;
+    const cv::Rect& getSearchRegion() const;
+    double getRefineScore() const;
+};
+
+#endif // SCALED_TRACKER_H
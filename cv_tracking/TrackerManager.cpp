@@ -0,0 +1,228 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file TrackerManager.cpp
+ * @brief Implementation of the TrackerManager class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#include "TrackerManager.h"
+#include "ScaledTracker.h"
+
+#include <cstdio>
+#include <algorithm>
+
+/*******************************************************************************************************************//**
+ * @brief Class constructor
+ * @param[in] trackerType tracker algorithm, one of "CSRT", "GOTURN", "KCF", or "MIL"
+ * @param[in] scaledTargetSize target size in pixels on the downscaled frames, 0 tracks at full resolution
+ * @param[in] refine whether scaled boxes are refined at full resolution
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+TrackerManager::TrackerManager(const std::string &trackerType, int scaledTargetSize, bool refine) : m_trackerType(trackerType), m_scaledTargetSize(scaledTargetSize), m_refine(refine), m_nextId(0), m_frames(0), m_totalUpdateSeconds(0.0)
+{
+}
+
+/*******************************************************************************************************************//**
+ * @brief Create a tracker by name
+ * @param[in] trackerType tracker algorithm, one of "CSRT", "GOTURN", "KCF", or "MIL"
+ * @param[in] scaledTargetSize target size in pixels on the downscaled frames, 0 tracks at full resolution
+ * @param[in] refine whether scaled boxes are refined at full resolution
+ * @return the tracker, empty if the name is unknown
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+cv::Ptr<cv::Tracker> TrackerManager::createTracker(const std::string &trackerType, int scaledTargetSize, bool refine)
+{
+    cv::Ptr<cv::Tracker> tracker;
+    if(trackerType == "CSRT")
+    {
+        tracker = cv::TrackerCSRT::create();
+    }
+    else if(trackerType == "GOTURN")
+    {
+        tracker = cv::TrackerGOTURN::create();
+    }
+    else if(trackerType == "KCF")
+    {
+        tracker = cv::TrackerKCF::create();
+    }
+    else if(trackerType == "MIL")
+    {
+        tracker = cv::TrackerMIL::create();
+    }
+    if(tracker.empty() || scaledTargetSize <= 0)
+    {
+        return tracker;
+    }
+    return cv::makePtr<ScaledTracker>(tracker, scaledTargetSize, refine);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Start tracking a new target
+ * @param[in] frame the frame the target is selected in
+ * @param[in] box the target bounding box
+ * @return the target id, or -1 if the tracker could not be created
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+int TrackerManager::addTarget(const cv::Mat &frame, const cv::Rect &box)
+{
+    TrackedTarget target;
+    target.tracker = createTracker(m_trackerType, m_scaledTargetSize, m_refine);
+    if(target.tracker.empty() || box.area() <= 0)
+    {
+        return -1;
+    }
+    target.tracker->init(frame, box);
+    target.id = m_nextId++;
+    target.box = box;
+    target.tracked = true;
+    target.lastUpdateSeconds = 0.0;
+    target.totalUpdateSeconds = 0.0;
+    target.updates = 0;
+    target.failures = 0;
+    m_targets.push_back(target);
+    return target.id;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Stop tracking a target
+ * @param[in] id the target id
+ * @return true if the target existed
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool TrackerManager::removeTarget(int id)
+{
+    for(size_t i = 0; i < m_targets.size(); i++)
+    {
+        if(m_targets[i].id == id)
+        {
+            m_targets.erase(m_targets.begin() + i);
+            return true;
+        }
+    }
+    return false;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Stop tracking every target whose tracker lost it on the last update
+ * @return the number of targets removed
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+int TrackerManager::removeLostTargets()
+{
+    size_t numTargets = m_targets.size();
+    m_targets.erase(std::remove_if(m_targets.begin(), m_targets.end(), [](const TrackedTarget &target) { return !target.tracked; }), m_targets.end());
+    return static_cast<int>(numTargets - m_targets.size());
+}
+
+/*******************************************************************************************************************//**
+ * @brief Update every target with a new frame
+ * @param[in] frame the new frame, shared read only by all trackers
+ * @return the number of targets that were lost on this frame
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+int TrackerManager::update(const cv::Mat &frame)
+{
+    // update the trackers concurrently, one work item per target so idle threads pick up the remaining targets
+    double startTicks = static_cast<double>(cv::getTickCount());
+    const int numTargets = static_cast<int>(m_targets.size());
+    cv::parallel_for_(cv::Range(0, numTargets), [&](const cv::Range &range)
+    {
+        for(int i = range.start; i < range.end; i++)
+        {
+            TrackedTarget &target = m_targets[i];
+            double targetStartTicks = static_cast<double>(cv::getTickCount());
+            target.tracked = target.tracker->update(frame, target.box);
+            target.lastUpdateSeconds = (static_cast<double>(cv::getTickCount()) - targetStartTicks) / cv::getTickFrequency();
+            target.totalUpdateSeconds += target.lastUpdateSeconds;
+            target.updates++;
+            if(!target.tracked)
+            {
+                target.failures++;
+            }
+        }
+    }, numTargets);
+    m_totalUpdateSeconds += (static_cast<double>(cv::getTickCount()) - startTicks) / cv::getTickFrequency();
+    m_frames++;
+
+    // count the targets lost on this frame
+    int lost = 0;
+    for(int i = 0; i < numTargets; i++)
+    {
+        lost += m_targets[i].tracked ? 0 : 1;
+    }
+    return lost;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the tracked targets
+ * @return the targets in the order they were added
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+const std::vector<TrackedTarget>& TrackerManager::getTargets() const
+{
+    return m_targets;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the number of tracked targets
+ * @return the number of targets
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+size_t TrackerManager::getNumTargets() const
+{
+    return m_targets.size();
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the tracker algorithm name
+ * @return the tracker type
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+const std::string& TrackerManager::getTrackerType() const
+{
+    return m_trackerType;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the mean wall clock time of a whole frame update
+ * @return the mean update time in seconds
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+double TrackerManager::getMeanUpdateSeconds() const
+{
+    return m_frames > 0 ? m_totalUpdateSeconds / m_frames : 0.0;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Print the update cost of every target and the speedup of the concurrent update
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void TrackerManager::printStatistics() const
+{
+    double serialSeconds = 0.0;
+    for(size_t i = 0; i < m_targets.size(); i++)
+    {
+        const TrackedTarget &target = m_targets[i];
+        double meanSeconds = target.updates > 0 ? target.totalUpdateSeconds / target.updates : 0.0;
+        serialSeconds += meanSeconds;
+        std::printf("Target %d: %lld updates, %.3f ms mean update, %lld failures \n", target.id, target.updates, meanSeconds * 1000.0, target.failures);
+    }
+    double frameSeconds = getMeanUpdateSeconds();
+    std::printf("%s trackers: %d targets, %.3f ms per frame update, %.3f ms if updated one after another (%.1fx on %d threads) \n", m_trackerType.c_str(), static_cast<int>(m_targets.size()), frameSeconds * 1000.0, serialSeconds * 1000.0, frameSeconds > 0.0 ? serialSeconds / frameSeconds : 0.0, cv::getNumThreads());
+}
@@ -0,0 +1,99 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file TrackerManager.h
+ * @brief Header file for the TrackerManager class
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#ifndef TRACKER_MANAGER_H
+#define TRACKER_MANAGER_H
+
+#include <vector>
+#include <string>
+#include "opencv2/opencv.hpp"
+#include <opencv2/tracking.hpp>
+
+/*******************************************************************************************************************//**
+ * @brief A tracked target, its tracker state, and its update statistics
+ **********************************************************************************************************************/
+struct TrackedTarget
+{
+    int id;
+    cv::Ptr<cv::Tracker> tracker;
+    cv::Rect box;
+    bool tracked;
+    double lastUpdateSeconds;
+    double totalUpdateSeconds;
+    long long updates;
+    long long failures;
+};
+
+/*******************************************************************************************************************//**
+ * @class TrackerManager
+ *
+ * @brief Class for tracking many targets at once, each with its own tracker
+ *
+ * Every frame, the trackers of all targets are updated concurrently on the OpenCV thread pool. Each target is its own
+ * work item, so idle threads pick up the remaining targets when some trackers are slower than others. All trackers read
+ * the same decoded frame, which is never copied or written. Targets can be added and removed between frames, and the
+ * update time of every target is recorded. With a scaled target size, each tracker runs through ScaledTracker on a
+ * downscaled copy of the neighbourhood of its own target, so the cost of a target does not depend on the frame size.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class TrackerManager
+{
+private:
+
+    // manager settings
+    std::string m_trackerType;
+    int m_scaledTargetSize;
+    bool m_refine;
+
+    // targets
+    std::vector<TrackedTarget> m_targets;
+    int m_nextId;
+
+    // statistics
+    long long m_frames;
+    double m_totalUpdateSeconds;
+
+public:
+
+    // constructors
+    TrackerManager(const std::string &trackerType="KCF", int scaledTargetSize=0, bool refine=false);
+
+    // target management
+    int addTarget(const cv::Mat &frame, const cv::Rect &box);
+    bool removeTarget(int id);
+    int removeLostTargets();
+
+    // tracking
+    int update(const cv::Mat &frame);
+    static cv::Ptr<cv::Tracker> createTracker(const std::string &trackerType, int scaledTargetSize=0, bool refine=false);
+
+    // accessors
+    const std::vector<TrackedTarget>& getTargets() const;
+    size_t getNumTargets() const;
+    const std::string& getTrackerType() const;
+    double getMeanUpdateSeconds() const;
+    void printStatistics() const;
+};
+
+#endif // TRACKER_MANAGER_H
@@ -0,0 +1,350 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file cv_tracker_benchmark.cpp
+ * @brief C++ example for comparing the throughput and accuracy of tracking algorithms with OpenCV
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+// include necessary dependencies
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include "opencv2/opencv.hpp"
+#include <opencv2/tracking.hpp>
+#include "Metrics.h"
+#include "TrackerManager.h"
+
+// configuration parameters
+#define NUM_COMNMAND_LINE_ARGUMENTS 2
+#define DEFAULT_MAX_FRAMES 0
+#define DEFAULT_TRACKER_TYPES "CSRT,GOTURN,KCF,MIL"
+#define MISS_IOU_THRESHOLD 0.1
+#define SUCCESS_IOU_THRESHOLD 0.5
+
+/*******************************************************************************************************************//**
+ * @brief Results of running one tracker over the whole sequence
+ **********************************************************************************************************************/
+struct TrackerResult
+{
+    std::string trackerType;
+    bool available;
+    MetricsHistogram latency;
+    double totalSeconds;
+    int frames;
+    int scoredFrames;
+    double iouSum;
+    int successes;
+    int failures;
+    int misses;
+};
+
+/*******************************************************************************************************************//**
+ * @brief Read ground truth boxes, one "x,y,width,height" line per frame
+ *
+ * Values may be separated by commas, tabs, or spaces. A line that can not be parsed or that has an empty box marks a
+ * frame where the target is not visible, and is stored as an empty rectangle.
+ *
+ * @param[in] path path of the ground truth file
+ * @param[out] boxesOut the box of every frame
+ * @return true if the file was read
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool readGroundTruth(const std::string &path, std::vector<cv::Rect> &boxesOut)
+{
+    std::ifstream file(path.c_str());
+    if(!file.is_open())
+    {
+        return false;
+    }
+    boxesOut.clear();
+    std::string line;
+    while(std::getline(file, line))
+    {
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::istringstream values(line);
+        double x = 0.0, y = 0.0, width = 0.0, height = 0.0;
+        if(values >> x >> y >> width >> height && width > 0.0 && height > 0.0)
+        {
+            boxesOut.push_back(cv::Rect(cvRound(x), cvRound(y), cvRound(width), cvRound(height)));
+        }
+        else
+        {
+            boxesOut.push_back(cv::Rect());
+        }
+    }
+    return true;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Compute the intersection over union of two boxes
+ * @param[in] a the first box
+ * @param[in] b the second box
+ * @return the intersection over union, 0 if either box is empty
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+double computeIoU(const cv::Rect &a, const cv::Rect &b)
+{
+    const double intersection = static_cast<double>((a & b).area());
+    const double unionArea = static_cast<double>(a.area()) + b.area() - intersection;
+    return unionArea > 0.0 ? intersection / unionArea : 0.0;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Run one tracker over the video and score it against the ground truth
+ *
+ * The video is decoded as the tracker runs, so memory does not grow with its length, and only the tracker updates are
+ * timed.
+ *
+ * @param[in] fileName path of the video file
+ * @param[in] maxFrames maximum number of frames to read, 0 reads the whole video
+ * @param[in] groundTruth the ground truth box of every frame, the first box initializes the tracker
+ * @param[in] scaledTargetSize target size in pixels on the downscaled frames, 0 tracks at full resolution
+ * @param[in] refine whether scaled boxes are refined at full resolution
+ * @param[in,out] result the tracker type to run, updated with its results
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void runTracker(const std::string &fileName, int maxFrames, const std::vector<cv::Rect> &groundTruth, int scaledTargetSize, bool refine, TrackerResult &result)
+{
+    // trackers that need model files (GOTURN) throw when the files are missing
+    cv::Ptr<cv::Tracker> tracker;
+    try
+    {
+        tracker = TrackerManager::createTracker(result.trackerType, scaledTargetSize, refine);
+    }
+    catch(const cv::Exception &)
+    {
+        return;
+    }
+    result.available = !tracker.empty();
+    if(!result.available)
+    {
+        return;
+    }
+
+    // each run decodes its own copy of the video, so concurrent runs do not share a capture
+    cv::VideoCapture capture(fileName);
+    cv::Mat frame;
+    if(!capture.isOpened() || !capture.read(frame))
+    {
+        return;
+    }
+
+    // initialize on the first frame, it is not timed or scored
+    cv::Rect box = groundTruth[0];
+    tracker->init(frame, box);
+
+    // update on every following frame, only the updates are timed
+    for(size_t i = 1; (maxFrames <= 0 || static_cast<int>(i) < maxFrames) && capture.read(frame); i++)
+    {
+        double frameStartTicks = static_cast<double>(cv::getTickCount());
+        bool tracked = tracker->update(frame, box);
+        double frameSeconds = (static_cast<double>(cv::getTickCount()) - frameStartTicks) / cv::getTickFrequency();
+        result.latency.record(frameSeconds);
+        result.totalSeconds += frameSeconds;
+        result.frames++;
+        if(!tracked)
+        {
+            result.failures++;
+        }
+
+        // score the frames where the target is visible, a lost target scores zero
+        if(i >= groundTruth.size() || groundTruth[i].area() <= 0)
+        {
+            continue;
+        }
+        double iou = tracked ? computeIoU(box, groundTruth[i]) : 0.0;
+        result.iouSum += iou;
+        result.scoredFrames++;
+        result.successes += iou >= SUCCESS_IOU_THRESHOLD ? 1 : 0;
+        result.misses += tracked && iou < MISS_IOU_THRESHOLD ? 1 : 0;
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief program entry point
+ *
+ * Every tracker run decodes the video as it goes instead of holding all of its frames in memory, and only the tracker
+ * updates are timed, so every tracker sees the same frames and decoding does not count against it. With --parallel
+ * the tracker types run concurrently, which finishes sooner but makes their timings and decoding compete for the CPU,
+ * so sequential runs should be used when comparing latency.
+ *
+ * @param[in] argc number of command line arguments
+ * @param[in] argv string array of command line arguments
+ * @return return code (0 for normal termination)
+ * @author Christoper D. McMurrough
+ **********************************************************************************************************************/
+int main(int argc, char **argv)
+{
+    // store video capture parameters
+    std::string fileName;
+    std::string groundTruthName;
+
+    // parse the benchmark options
+    std::string optionValue;
+    int maxFrames = DEFAULT_MAX_FRAMES;
+    if(extractOption(argc, argv, "--frames", optionValue))
+    {
+        maxFrames = std::atoi(optionValue.c_str());
+    }
+    if(extractOption(argc, argv, "--threads", optionValue))
+    {
+        cv::setNumThreads(std::atoi(optionValue.c_str()));
+    }
+    std::string trackerList = DEFAULT_TRACKER_TYPES;
+    extractOption(argc, argv, "--trackers", trackerList);
+    std::string csvPath;
+    bool csvEnabled = extractOption(argc, argv, "--csv", csvPath);
+    bool parallelMode = extractFlag(argc, argv, "--parallel");
+    int scaledTargetSize = 0;
+    if(extractOption(argc, argv, "--scaled", optionValue))
+    {
+        scaledTargetSize = std::max(0, std::atoi(optionValue.c_str()));
+    }
+    bool refineEnabled = extractFlag(argc, argv, "--refine");
+
+    // validate and parse the command line arguments
+    if(argc != NUM_COMNMAND_LINE_ARGUMENTS + 1)
+    {
+        std::printf("USAGE: %s <file_path> <ground_truth_path> [--trackers=<type,...>] [--frames=<count>] [--threads=<count>] [--parallel] [--scaled=<pixels>] [--refine] [--csv=<path>] \n", argv[0]);
+        std::printf("The ground truth file has one x,y,width,height line per frame, the first box initializes the trackers \n");
+        return 0;
+    }
+    else
+    {
+        fileName = argv[1];
+        groundTruthName = argv[2];
+    }
+
+    // read the ground truth boxes
+    std::vector<cv::Rect> groundTruth;
+    if(!readGroundTruth(groundTruthName, groundTruth) || groundTruth.empty() || groundTruth[0].area() <= 0)
+    {
+        std::printf("Unable to read an initial box from the ground truth file, terminating program! \n");
+        return 0;
+    }
+
+    // open the video file
+    cv::VideoCapture capture(fileName);
+    if(!capture.isOpened())
+    {
+        std::printf("Unable to open video source, terminating program! \n");
+        return 0;
+    }
+
+    // check that the video has frames to track, each tracker run reads it again
+    cv::Mat firstFrame;
+    cv::Mat secondFrame;
+    if(!capture.read(firstFrame) || !capture.read(secondFrame))
+    {
+        std::printf("The video has too few frames to benchmark, terminating program! \n");
+        return 0;
+    }
+    capture.release();
+    std::cout << "Benchmarking " << fileName << " (width=" << firstFrame.cols << " height=" << firstFrame.rows << "), " << groundTruth.size() << " ground truth boxes" << std::endl;
+
+    // create a result for each requested tracker type
+    std::vector<TrackerResult> results;
+    std::istringstream trackerTypes(trackerList);
+    std::string trackerType;
+    while(std::getline(trackerTypes, trackerType, ','))
+    {
+        if(trackerType.empty())
+        {
+            continue;
+        }
+        results.push_back(TrackerResult());
+        TrackerResult &result = results.back();
+        result.trackerType = trackerType;
+        result.available = false;
+        result.totalSeconds = 0.0;
+        result.frames = 0;
+        result.scoredFrames = 0;
+        result.iouSum = 0.0;
+        result.successes = 0;
+        result.failures = 0;
+        result.misses = 0;
+    }
+
+    // run the trackers one after another, or concurrently with one work item per tracker type
+    const int numTrackers = static_cast<int>(results.size());
+    if(parallelMode)
+    {
+        cv::parallel_for_(cv::Range(0, numTrackers), [&](const cv::Range &range)
+        {
+            for(int i = range.start; i < range.end; i++)
+            {
+                runTracker(fileName, maxFrames, groundTruth, scaledTargetSize, refineEnabled, results[i]);
+            }
+        }, numTrackers);
+    }
+    else
+    {
+        for(int i = 0; i < numTrackers; i++)
+        {
+            std::cout << "Running " << results[i].trackerType << "..." << std::endl;
+            runTracker(fileName, maxFrames, groundTruth, scaledTargetSize, refineEnabled, results[i]);
+        }
+    }
+
+    // format the results as CSV
+    std::ostringstream csv;
+    csv << "tracker,frames,fps,mean_ms,p50_ms,p90_ms,p99_ms,max_ms,mean_iou,success_rate,failures,misses" << std::endl;
+    for(int i = 0; i < numTrackers; i++)
+    {
+        const TrackerResult &result = results[i];
+        if(!result.available)
+        {
+            std::printf("Skipping %s, the tracker could not be created \n", result.trackerType.c_str());
+            continue;
+        }
+        char row[512];
+        std::snprintf(row, sizeof(row), "%s,%d,%.1f,%.3f,%.3f,%.3f,%.3f,%.3f,%.4f,%.4f,%d,%d",
+                      result.trackerType.c_str(),
+                      result.frames,
+                      result.totalSeconds > 0.0 ? result.frames / result.totalSeconds : 0.0,
+                      result.latency.getMean() * 1000.0,
+                      result.latency.getPercentile(50.0) * 1000.0,
+                      result.latency.getPercentile(90.0) * 1000.0,
+                      result.latency.getPercentile(99.0) * 1000.0,
+                      result.latency.getMax() * 1000.0,
+                      result.scoredFrames > 0 ? result.iouSum / result.scoredFrames : 0.0,
+                      result.scoredFrames > 0 ? static_cast<double>(result.successes) / result.scoredFrames : 0.0,
+                      result.failures,
+                      result.misses);
+        csv << row << std::endl;
+    }
+
+    // write the results to the file if requested, and always to the console
+    std::cout << csv.str();
+    if(csvEnabled)
+    {
+        std::ofstream csvFile(csvPath.c_str());
+        if(!csvFile.is_open())
+        {
+            std::printf("Unable to write %s \n", csvPath.c_str());
+            return 0;
+        }
+        csvFile << csv.str();
+    }
+}
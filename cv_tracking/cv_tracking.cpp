@@ -24,16 +24,47 @@
 // include necessary dependencies
 #include <iostream>
 #include <cstdio>
+#include <cmath>
+#include <vector>
+#include <string>
 #include "opencv2/opencv.hpp"
 #include <opencv2/tracking.hpp>
 #include <opencv2/core/ocl.hpp>
+#include "Metrics.h"
+#include "TrackerManager.h"
 
 // configuration parameters
 #define NUM_COMNMAND_LINE_ARGUMENTS 2
 #define DISPLAY_WINDOW_NAME "Video Frame"
+#define DEFAULT_NUM_TARGETS 1
+
+/*******************************************************************************************************************//**
+ * @brief Lay out benchmark targets on a grid over the center of the frame
+ * @param[in] frameSize the frame size
+ * @param[in] numTargets number of targets
+ * @param[out] boxesOut the target boxes
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void createBenchmarkTargets(const cv::Size &frameSize, int numTargets, std::vector<cv::Rect> &boxesOut)
+{
+    // a single target covers the center quarter of the frame, more targets share that area on a grid
+    boxesOut.clear();
+    int gridSize = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(numTargets))));
+    cv::Rect area(frameSize.width / 4, frameSize.height / 4, frameSize.width / 2, frameSize.height / 2);
+    int cellWidth = area.width / gridSize;
+    int cellHeight = area.height / gridSize;
+    for(int i = 0; i < numTargets; i++)
+    {
+        boxesOut.push_back(cv::Rect(area.x + (i % gridSize) * cellWidth, area.y + (i / gridSize) * cellHeight, cellWidth, cellHeight));
+    }
+}
 
 /*******************************************************************************************************************//**
  * @brief program entry point
+ *
+ * Targets are selected in the first frame and tracked concurrently. While the video plays, 'a' pauses to select more
+ * targets, 'd' removes the most recently added target, 'r' removes the targets that were lost, and 'q' quits.
+ *
  * @param[in] argc number of command line arguments
  * @param[in] argv string array of command line arguments
  * @return return code (0 for normal termination)
@@ -45,10 +76,33 @@ int main(int argc, char **argv)
     std::string fileName;
     int trackerSelection = 0;
 
+    // run without display or pacing if requested
+    bool benchMode = extractFlag(argc, argv, "--bench");
+
+    // write metrics to a file instead of printing per frame timing, if requested
+    std::string metricsPath;
+    bool metricsEnabled = extractOption(argc, argv, "--metrics", metricsPath);
+
+    // number of targets tracked when benchmarking
+    std::string optionValue;
+    int numBenchTargets = DEFAULT_NUM_TARGETS;
+    if(extractOption(argc, argv, "--targets", optionValue))
+    {
+        numBenchTargets = std::max(1, std::atoi(optionValue.c_str()));
+    }
+
+    // track on downscaled frames where the targets are this many pixels across, optionally refined at full resolution
+    int scaledTargetSize = 0;
+    if(extractOption(argc, argv, "--scaled", optionValue))
+    {
+        scaledTargetSize = std::max(0, std::atoi(optionValue.c_str()));
+    }
+    bool refineEnabled = extractFlag(argc, argv, "--refine");
+
     // validate and parse the command line arguments
     if(argc != NUM_COMNMAND_LINE_ARGUMENTS + 1)
     {
-        std::printf("USAGE: %s <file_path> <tracker_type> \n", argv[0]);
+        std::printf("USAGE: %s <file_path> <tracker_type> [--targets=<count>] [--scaled=<pixels>] [--refine] [--bench] [--metrics=<path>] \n", argv[0]);
         return 0;
     }
     else
@@ -72,63 +126,137 @@ int main(int argc, char **argv)
     std::cout << "Video source opened successfully (width=" << captureWidth << " height=" << captureHeight << " fps=" << captureFPS << ")!" << std::endl;
 
     // create image window
-    cv::namedWindow(DISPLAY_WINDOW_NAME, cv::WINDOW_AUTOSIZE);
-
-    // create the tracker object
-    std::string trackerTypes[9] = {"CSRT", "GOTURN", "KCF", "MIL"};
-    std::string trackerType = trackerTypes[trackerSelection];
-    cv::Ptr<cv::Tracker> tracker;
-    if (trackerType == "CSRT")
-        tracker = cv::TrackerCSRT::create();
-    if (trackerType == "GOTURN")
-        tracker = cv::TrackerGOTURN::create();
-    if (trackerType == "KCF")
-        tracker = cv::TrackerKCF::create();
-    if (trackerType == "MIL")
-        tracker = cv::TrackerMIL::create();
+    if(!benchMode)
+    {
+        cv::namedWindow(DISPLAY_WINDOW_NAME, cv::WINDOW_AUTOSIZE);
+    }
+
+    // create the tracker manager
+    std::string trackerTypes[4] = {"CSRT", "GOTURN", "KCF", "MIL"};
+    if(trackerSelection < 0 || trackerSelection >= 4)
+    {
+        std::printf("Unknown tracker type %d, expected 0 (CSRT), 1 (GOTURN), 2 (KCF), or 3 (MIL) \n", trackerSelection);
+        return 0;
+    }
+    TrackerManager trackers(trackerTypes[trackerSelection], scaledTargetSize, refineEnabled);
 
     // declare variables for tracking
-    cv::Rect roi;
+    std::vector<cv::Rect> rois;
     cv::Mat frame;
+    cv::Mat displayFrame;
 
-    // get bounding box
+    // get bounding boxes, benchmarks track a grid over the center quarter of the first frame so they run unattended
     bool captureSuccess = capture.read(frame);
-    roi = cv::selectROI(DISPLAY_WINDOW_NAME, frame);
+    if(benchMode)
+    {
+        createBenchmarkTargets(frame.size(), numBenchTargets, rois);
+    }
+    else
+    {
+        cv::selectROIs(DISPLAY_WINDOW_NAME, frame, rois);
+    }
+
+    // initialize a tracker for each target
+    for(size_t i = 0; i < rois.size(); i++)
+    {
+        trackers.addTarget(frame, rois[i]);
+    }
 
-    // exit if ROI was not selected
-    if(roi.width==0 || roi.height==0)
+    // exit if no ROI was selected
+    if(trackers.getNumTargets() == 0)
     {
         return 0;
     }
 
-    // initialize the tracker
-    tracker->init(frame,roi);
+    // register the frame metrics, written to a file in the background if requested
+    MetricsRegistry metrics("cv_tracking");
+    MetricsCounter &framesTotal = metrics.counter("frames_total", "Frames processed");
+    MetricsHistogram &frameSeconds = metrics.histogram("frame_seconds", "Frame processing time in seconds");
+    MetricsCounter &trackingFailures = metrics.counter("tracking_failures_total", "Target updates where the tracker lost the target");
+    MetricsHistogram &targetUpdateSeconds = metrics.histogram("target_update_seconds", "Per target tracker update time in seconds");
+    MetricsGauge &targetsGauge = metrics.gauge("targets", "Targets being tracked");
+    if(metricsEnabled)
+    {
+        metrics.startDumping(metricsPath);
+    }
 
     // perform tracking iterations on each frame
-    std::cout << "Starting tracker, press 'q' to quit" << std::endl;
+    std::cout << "Starting " << trackers.getNumTargets() << " " << trackers.getTrackerType() << " trackers, press 'a' to add targets, 'd' to remove the last target, 'r' to remove lost targets, 'q' to quit" << std::endl;
     bool tracking = true;
+    double benchStartTicks = static_cast<double>(cv::getTickCount());
     while(tracking)
     {
+        // get the start time
+        double startTicks = static_cast<double>(cv::getTickCount());
+
         // get frame from the video
         captureSuccess = capture.read(frame);
 
         if(captureSuccess)
         {
-            // update the tracking result
-            tracker->update(frame,roi);
+            // update every target concurrently
+            trackingFailures.add(trackers.update(frame));
+            const std::vector<TrackedTarget> &targets = trackers.getTargets();
+            for(size_t i = 0; i < targets.size(); i++)
+            {
+                targetUpdateSeconds.record(targets[i].lastUpdateSeconds);
+            }
+            targetsGauge.set(static_cast<double>(targets.size()));
+
+            // record the frame processing time
+            double elapsedTime = (static_cast<double>(cv::getTickCount()) - startTicks) / cv::getTickFrequency();
+            frameSeconds.record(elapsedTime);
+            framesTotal.add();
+        }
+        else if(benchMode)
+        {
+            // stop at the end of the video when benchmarking
+            tracking = false;
+        }
 
-            // annotate and show the frame
-            cv::rectangle(frame, roi, cv::Scalar( 255, 0, 0 ), 2, 1 );
-            cv::imshow(DISPLAY_WINDOW_NAME, frame);
+        if(captureSuccess && !benchMode)
+        {
+            // annotate and show a copy of the frame, lost targets are drawn in red and new targets start from the clean frame
+            const std::vector<TrackedTarget> &targets = trackers.getTargets();
+            frame.copyTo(displayFrame);
+            for(size_t i = 0; i < targets.size(); i++)
+            {
+                cv::Scalar color = targets[i].tracked ? cv::Scalar(255, 0, 0) : cv::Scalar(0, 0, 255);
+                cv::rectangle(displayFrame, targets[i].box, color, 2, 1);
+                cv::putText(displayFrame, std::to_string(targets[i].id), targets[i].box.tl() + cv::Point(2, 14), cv::FONT_HERSHEY_SIMPLEX, 0.5, color, 1);
+            }
+            cv::imshow(DISPLAY_WINDOW_NAME, displayFrame);
 
-            // check for user termination
-            if(cv::waitKey(1)=='q')
+            // check for target changes and user termination
+            char key = static_cast<char>(cv::waitKey(1));
+            if(key == 'q')
             {
                 tracking = false;
             }
+            else if(key == 'a')
+            {
+                cv::selectROIs(DISPLAY_WINDOW_NAME, displayFrame, rois);
+                for(size_t i = 0; i < rois.size(); i++)
+                {
+                    trackers.addTarget(frame, rois[i]);
+                }
+            }
+            else if(key == 'd' && !targets.empty())
+            {
+                trackers.removeTarget(targets.back().id);
+            }
+            else if(key == 'r')
+            {
+                trackers.removeLostTargets();
+            }
         }
     }
 
+    // report the throughput and latency distribution
+    double benchElapsedTime = (static_cast<double>(cv::getTickCount()) - benchStartTicks) / cv::getTickFrequency();
+    frameSeconds.printSummary("cv_tracking", benchElapsedTime);
+    trackers.printStatistics();
+
     // release program resources before returning
     capture.release();
 }
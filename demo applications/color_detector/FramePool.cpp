@@ -0,0 +1,286 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file FramePool.cpp
+ * @brief Implementation of the FramePool and FrameHandle classes
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#include "FramePool.h"
+
+/*******************************************************************************************************************//**
+ * @brief Construct an empty handle
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+FrameHandle::FrameHandle() : m_pool(0), m_slot(0)
+{
+}
+
+/*******************************************************************************************************************//**
+ * @brief Construct a handle to a pooled buffer, the caller has already counted the reference
+ * @param[in] pool the owning pool
+ * @param[in] slot the pooled buffer
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+FrameHandle::FrameHandle(FramePool *pool, FrameSlot *slot) : m_pool(pool), m_slot(slot)
+{
+}
+
+/*******************************************************************************************************************//**
+ * @brief Copy constructor, shares the buffer of another handle
+ * @param[in] other the handle to copy
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+FrameHandle::FrameHandle(const FrameHandle &other) : m_pool(other.m_pool), m_slot(other.m_slot)
+{
+    if(m_slot)
+    {
+        m_slot->references++;
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Move constructor, takes the buffer of another handle
+ * @param[in] other the handle to move from
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+FrameHandle::FrameHandle(FrameHandle &&other) : m_pool(other.m_pool), m_slot(other.m_slot)
+{
+    other.m_pool = 0;
+    other.m_slot = 0;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Copy assignment, releases the current buffer and shares the buffer of another handle
+ * @param[in] other the handle to copy
+ * @return reference to this handle
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+FrameHandle& FrameHandle::operator=(const FrameHandle &other)
+{
+    if(m_slot != other.m_slot)
+    {
+        release();
+        m_pool = other.m_pool;
+        m_slot = other.m_slot;
+        if(m_slot)
+        {
+            m_slot->references++;
+        }
+    }
+    return *this;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Move assignment, releases the current buffer and takes the buffer of another handle
+ * @param[in] other the handle to move from
+ * @return reference to this handle
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+FrameHandle& FrameHandle::operator=(FrameHandle &&other)
+{
+    if(this != &other)
+    {
+        release();
+        m_pool = other.m_pool;
+        m_slot = other.m_slot;
+        other.m_pool = 0;
+        other.m_slot = 0;
+    }
+    return *this;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Class destructor, returns the buffer to the pool if this was the last handle
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+FrameHandle::~FrameHandle()
+{
+    release();
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the pooled image buffer
+ * @return reference to the buffer, which may be written with any OpenCV function
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+cv::Mat& FrameHandle::mat() const
+{
+    return m_slot->buffer;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Check if the handle refers to a buffer
+ * @return true if the handle is empty
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool FrameHandle::empty() const
+{
+    return m_slot == 0;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Drop this handle's reference to its buffer
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void FrameHandle::release()
+{
+    if(m_slot)
+    {
+        FrameSlot *slot = m_slot;
+        if(--slot->references == 0)
+        {
+            m_pool->release(slot);
+        }
+        m_pool = 0;
+        m_slot = 0;
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Class constructor
+ * @param[in] initialSize number of empty buffers to create up front (default: 0)
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+FramePool::FramePool(size_t initialSize)
+{
+    m_allocations = 0;
+    for(size_t i = 0; i < initialSize; i++)
+    {
+        m_slots.push_back(std::unique_ptr<FrameSlot>(new FrameSlot()));
+        m_slots.back()->lastData = 0;
+        m_slots.back()->references = 0;
+        m_free.push_back(m_slots.back().get());
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get an unused buffer from the pool, creating a new one if every buffer is in use
+ *
+ * The buffer keeps the contents, size, and type of its previous use.
+ *
+ * @return handle to the buffer
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+FrameHandle FramePool::acquire()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FrameSlot *slot;
+    if(m_free.empty())
+    {
+        m_slots.push_back(std::unique_ptr<FrameSlot>(new FrameSlot()));
+        slot = m_slots.back().get();
+        slot->lastData = 0;
+    }
+    else
+    {
+        slot = m_free.back();
+        m_free.pop_back();
+    }
+    slot->references = 1;
+    return FrameHandle(this, slot);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get an unused buffer of a given shape from the pool
+ *
+ * A free buffer that already has the size and type is preferred, then a buffer that was never written, so buffers of
+ * different shapes sharing the pool are not reallocated for each other whatever order they were released in.
+ *
+ * @param[in] size the image size the buffer will be written with
+ * @param[in] type the image type the buffer will be written with
+ * @return handle to the buffer
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+FrameHandle FramePool::acquire(const cv::Size &size, int type)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t best = m_free.size();
+    for(size_t i = m_free.size(); i-- > 0; )
+    {
+        const cv::Mat &buffer = m_free[i]->buffer;
+        if(buffer.size() == size && buffer.type() == type)
+        {
+            best = i;
+            break;
+        }
+        if(best == m_free.size() && buffer.empty())
+        {
+            best = i;
+        }
+    }
+
+    // create a new buffer rather than reshaping one that belongs to another shape
+    FrameSlot *slot;
+    if(best == m_free.size())
+    {
+        m_slots.push_back(std::unique_ptr<FrameSlot>(new FrameSlot()));
+        slot = m_slots.back().get();
+        slot->lastData = 0;
+    }
+    else
+    {
+        slot = m_free[best];
+        m_free[best] = m_free.back();
+        m_free.pop_back();
+    }
+    slot->buffer.create(size, type);
+    slot->references = 1;
+    return FrameHandle(this, slot);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Return a buffer to the pool, counting an allocation if its memory changed during the last use
+ * @param[in] slot the buffer to return
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void FramePool::release(FrameSlot *slot)
+{
+    if(slot->buffer.data != slot->lastData)
+    {
+        if(slot->buffer.data)
+        {
+            m_allocations++;
+        }
+        slot->lastData = slot->buffer.data;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_free.push_back(slot);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the number of buffers owned by the pool
+ * @return the number of buffers
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+size_t FramePool::getSize() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_slots.size();
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the number of buffer allocations observed so far
+ * @return the number of allocations
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+long long FramePool::getAllocationCount() const
+{
+    return m_allocations;
+}
@@ -25,6 +25,8 @@
 #include <iostream>
 #include <cstdio>
 #include "opencv2/opencv.hpp"
+#include "FramePool.h"
+#include "Metrics.h"
 
 // configuration parameters
 #define NUM_COMNMAND_LINE_ARGUMENTS 2
@@ -38,19 +40,30 @@
 #define COLOR_YELLOW 'y'
 #define COLOR_WHITE 'w'
 
+/*******************************************************************************************************************//**
+ * @brief Scratch images for labeling a region, kept between frames so their memory is reused
+ **********************************************************************************************************************/
+struct LabelBuffers
+{
+    cv::Mat channels[3];
+    cv::Mat intensity;
+    cv::Mat normalized;
+};
+
 // declare function prototypes
-bool processFrame(const cv::Mat &imageIn, cv::Mat &imageOut);
-char labelColor(const cv::Mat &imageIn);
+bool processFrame(const cv::Mat &imageIn, cv::Mat &imageOut, LabelBuffers &buffers);
+char labelColor(const cv::Mat &imageIn, LabelBuffers &buffers);
 double normSqr(double x1, double y1, double z1, double x2, double y2, double z2);
 
 /*******************************************************************************************************************//**
  * @brief Process a single image frame
  * @param[in] imageIn the input image frame
  * @param[out] imageOut the processed image frame
+ * @param[in,out] buffers scratch images reused between frames
  * @return true if frame was processed successfully
  * @author Christopher D. McMurrough
  **********************************************************************************************************************/
-bool processFrame(const cv::Mat &imageIn, cv::Mat &imageOut)
+bool processFrame(const cv::Mat &imageIn, cv::Mat &imageOut, LabelBuffers &buffers)
 {
     // get the region of interest
     cv::Point p1(imageIn.cols / 2 - 50, imageIn.rows / 2 - 50);
@@ -59,7 +72,7 @@ bool processFrame(const cv::Mat &imageIn, cv::Mat &imageOut)
     cv::Mat imageROI = imageIn(boundingRectangle);
 
     // compute the color label for the region of interest
-    char color = labelColor(imageROI);
+    char color = labelColor(imageROI, buffers);
 
     // copy the input image frame to the ouput image
     imageIn.copyTo(imageOut);
@@ -97,33 +110,30 @@ bool processFrame(const cv::Mat &imageIn, cv::Mat &imageOut)
 /*******************************************************************************************************************//**
 * @brief Process a single image frame
 * @param[in] imageIn the input image region of interest
+* @param[in,out] buffers scratch images reused between frames
 * @return the label char describing the ROI color
 * @author Christopher D. McMurrough
  **********************************************************************************************************************/
-char labelColor(const cv::Mat &imageIn)
+char labelColor(const cv::Mat &imageIn, LabelBuffers &buffers)
 {
     // split the BGR image into individual channels
-    cv::Mat img_b(imageIn.rows, imageIn.cols, CV_8UC1);
-    cv::Mat img_g(imageIn.rows, imageIn.cols, CV_8UC1);
-    cv::Mat img_r(imageIn.rows, imageIn.cols, CV_8UC1);
-    cv::Mat channels[] = {img_b, img_g, img_r};
-    cv::split(imageIn, channels);
-
-    // compute the overall intensity for each pixel as (b + g + r)
-    cv::Mat intensity(imageIn.rows, imageIn.cols, CV_32F);
-    cv::add(img_b, img_g, intensity);
-    cv::add(intensity, img_r, intensity);
-    intensity = intensity / 3.0;
-
-    // compute the normalized color values for each channel
-    cv::Mat norm_b = img_b / intensity;
-    cv::Mat norm_g = img_g / intensity;
-    cv::Mat norm_r = img_r / intensity;
-
-    // compute the average normalized color value of each channel
-    double avg_b = cv::mean(norm_b)[0];
-    double avg_g = cv::mean(norm_g)[0];
-    double avg_r = cv::mean(norm_r)[0];
+    cv::split(imageIn, buffers.channels);
+    const cv::Mat &img_b = buffers.channels[0];
+    const cv::Mat &img_g = buffers.channels[1];
+    const cv::Mat &img_r = buffers.channels[2];
+
+    // compute the overall intensity for each pixel as (b + g + r) / 3
+    cv::add(img_b, img_g, buffers.intensity);
+    cv::add(buffers.intensity, img_r, buffers.intensity);
+    buffers.intensity.convertTo(buffers.intensity, buffers.intensity.type(), 1.0 / 3.0);
+
+    // compute the average normalized color value of each channel, reusing one buffer for the normalized values
+    cv::divide(img_b, buffers.intensity, buffers.normalized);
+    double avg_b = cv::mean(buffers.normalized)[0];
+    cv::divide(img_g, buffers.intensity, buffers.normalized);
+    double avg_g = cv::mean(buffers.normalized)[0];
+    cv::divide(img_r, buffers.intensity, buffers.normalized);
+    double avg_r = cv::mean(buffers.normalized)[0];
 
     // print the color values to console
     std::printf("B: %f     G: %f     R: %f \n", avg_b, avg_g, avg_r);
@@ -217,10 +227,14 @@ int main(int argc, char **argv)
     int cameraIndex = 0;
     bool showFrames = false;
 
+    // write metrics to a file instead of printing per frame timing, if requested
+    std::string metricsPath;
+    bool metricsEnabled = extractOption(argc, argv, "--metrics", metricsPath);
+
     // validate and parse the command line arguments
     if(argc != NUM_COMNMAND_LINE_ARGUMENTS + 1)
     {
-        std::printf("USAGE: %s <camera_index> <display_mode> \n", argv[0]);
+        std::printf("USAGE: %s <camera_index> <display_mode> [--metrics=<path>] \n", argv[0]);
         std::printf("WARNING: Proceeding with default execution parameters... \n");
         cameraIndex = 0;
         showFrames = true;
@@ -250,6 +264,21 @@ int main(int argc, char **argv)
         cv::namedWindow(DISPLAY_WINDOW_NAME, cv::WINDOW_AUTOSIZE);
     }
 
+    // register the frame metrics, written to a file in the background if requested
+    MetricsRegistry metrics("cv_color_detector");
+    MetricsCounter &framesTotal = metrics.counter("frames_total", "Frames processed");
+    MetricsHistogram &frameSeconds = metrics.histogram("frame_seconds", "Frame processing time in seconds");
+    MetricsCounter &captureFailures = metrics.counter("capture_failures_total", "Frames that could not be read");
+    if(metricsEnabled)
+    {
+        metrics.startDumping(metricsPath);
+    }
+
+    // recycle frame buffers and labeling scratch images between iterations
+    FramePool framePool;
+    LabelBuffers labelBuffers;
+    const cv::Size frameSize(captureWidth, captureHeight);
+
     // process data until program termination
     bool doCapture = true;
     int frameCount = 0;
@@ -259,26 +288,27 @@ int main(int argc, char **argv)
         double startTicks = static_cast<double>(cv::getTickCount());
 
         // attempt to acquire and process an image frame
-        cv::Mat captureFrame;
-        cv::Mat processedFrame;
-        bool captureSuccess = capture.read(captureFrame);
+        FrameHandle captureFrame = framePool.acquire(frameSize, CV_8UC3);
+        FrameHandle processedFrame = framePool.acquire(frameSize, CV_8UC3);
+        bool captureSuccess = capture.read(captureFrame.mat());
         if(captureSuccess)
         {
             // process the image frame
-            processFrame(captureFrame, processedFrame);
+            processFrame(captureFrame.mat(), processedFrame.mat(), labelBuffers);
 
             // increment the frame counter
             frameCount++;
         }
         else
         {
+            captureFailures.add();
             std::printf("Unable to acquire image frame! \n");
         }
 
         // update the GUI window if necessary
         if(showFrames && captureSuccess)
         {
-            cv::imshow(DISPLAY_WINDOW_NAME, processedFrame);
+            cv::imshow(DISPLAY_WINDOW_NAME, processedFrame.mat());
 
             // check for program termination
             if(((char) cv::waitKey(1)) == 'q')
@@ -290,9 +320,16 @@ int main(int argc, char **argv)
         // compute the frame processing time
         double endTicks = static_cast<double>(cv::getTickCount());
         double elapsedTime = (endTicks - startTicks) / cv::getTickFrequency();
-        std::printf("Frame processing time: %f \n", elapsedTime);
+        if(captureSuccess)
+        {
+            frameSeconds.record(elapsedTime);
+            framesTotal.add();
+        }
     }
 
+    // report frame buffer reuse
+    std::printf("Frame buffers: %d pooled, %lld allocations over %d frames \n", static_cast<int>(framePool.getSize()), framePool.getAllocationCount(), frameCount);
+
     // release program resources before returning
     capture.release();
     cv::destroyAllWindows();
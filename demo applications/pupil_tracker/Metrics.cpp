@@ -0,0 +1,694 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*******************************************************************************************************************//**
+ * @file Metrics.cpp
+ * @brief Implementation of the metrics registry and its counter, gauge, and histogram types
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#include "Metrics.h"
+
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+#include <intrin.h>
+#endif
+
+#define METRICS_SUB_BUCKETS (1 << METRICS_SUB_BUCKET_BITS)
+#define METRICS_NUM_BUCKETS (METRICS_SUB_BUCKETS * (METRICS_MAX_EXPONENT - METRICS_SUB_BUCKET_BITS + 2))
+
+/*******************************************************************************************************************//**
+ * @brief Get the shard used by the calling thread
+ * @return the shard index
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+static int getThreadShard()
+{
+    static std::atomic<int> nextShard(0);
+    static thread_local int shard = nextShard++ % METRICS_NUM_SHARDS;
+    return shard;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Class constructor
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+MetricsCounter::MetricsCounter()
+{
+    for(int i = 0; i < METRICS_NUM_SHARDS; i++)
+    {
+        m_shards[i].value = 0;
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Increment the counter
+ * @param[in] amount the increment (default: 1)
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void MetricsCounter::add(long long amount)
+{
+    m_shards[getThreadShard()].value.fetch_add(amount, std::memory_order_relaxed);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the counter value
+ * @return the sum over every shard
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+long long MetricsCounter::get() const
+{
+    long long total = 0;
+    for(int i = 0; i < METRICS_NUM_SHARDS; i++)
+    {
+        total += m_shards[i].value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Class constructor
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+MetricsGauge::MetricsGauge()
+{
+    m_value = 0.0;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Set the gauge value
+ * @param[in] value the new value
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void MetricsGauge::set(double value)
+{
+    m_value.store(value, std::memory_order_relaxed);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the gauge value
+ * @return the last value written
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+double MetricsGauge::get() const
+{
+    return m_value.load(std::memory_order_relaxed);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Histogram shard constructor
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+MetricsHistogram::Shard::Shard() : buckets(METRICS_NUM_BUCKETS)
+{
+    count = 0;
+    sumMicroseconds = 0;
+    maxMicroseconds = 0;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Class constructor
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+MetricsHistogram::MetricsHistogram()
+{
+    for(int i = 0; i < METRICS_NUM_SHARDS; i++)
+    {
+        m_shards[i].reset(new Shard());
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the position of the highest set bit of a value
+ * @param[in] value the value, which must not be zero
+ * @return the bit position, 0 for the least significant bit
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+static int highestBit(unsigned long long value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<int>(index);
+#else
+    int bit = 0;
+    while(value >>= 1)
+    {
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the bucket holding a value
+ *
+ * Values below the sub-bucket count map directly to their own bucket. Larger values are grouped by the position of
+ * their highest set bit, and the next bits select the linear sub-bucket within that power of two.
+ *
+ * @param[in] microseconds the value
+ * @return the bucket index
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+size_t MetricsHistogram::getBucket(unsigned long long microseconds)
+{
+    if(microseconds < METRICS_SUB_BUCKETS)
+    {
+        return static_cast<size_t>(microseconds);
+    }
+
+    int exponent = highestBit(microseconds);
+    if(exponent > METRICS_MAX_EXPONENT)
+    {
+        return METRICS_NUM_BUCKETS - 1;
+    }
+    int shift = exponent - METRICS_SUB_BUCKET_BITS;
+    size_t subBucket = static_cast<size_t>((microseconds >> shift) & (METRICS_SUB_BUCKETS - 1));
+    return METRICS_SUB_BUCKETS + static_cast<size_t>(shift) * METRICS_SUB_BUCKETS + subBucket;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the representative value of a bucket
+ * @param[in] bucket the bucket index
+ * @return the center of the bucket in microseconds
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+double MetricsHistogram::getBucketValue(size_t bucket)
+{
+    if(bucket < METRICS_SUB_BUCKETS)
+    {
+        return static_cast<double>(bucket);
+    }
+
+    size_t shift = bucket / METRICS_SUB_BUCKETS - 1;
+    size_t subBucket = bucket % METRICS_SUB_BUCKETS;
+    double lower = static_cast<double>((METRICS_SUB_BUCKETS + subBucket) << shift);
+    double width = static_cast<double>(1ULL << shift);
+    return lower + 0.5 * width;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Record a single duration
+ * @param[in] seconds the duration in seconds
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void MetricsHistogram::record(double seconds)
+{
+    unsigned long long microseconds = seconds > 0.0 ? static_cast<unsigned long long>(seconds * 1e6 + 0.5) : 0;
+    Shard &shard = *m_shards[getThreadShard()];
+    shard.buckets[getBucket(microseconds)].fetch_add(1, std::memory_order_relaxed);
+    shard.count.fetch_add(1, std::memory_order_relaxed);
+    shard.sumMicroseconds.fetch_add(static_cast<long long>(microseconds), std::memory_order_relaxed);
+
+    // several threads may share a shard, so the maximum is updated with a compare and swap loop
+    long long previous = shard.maxMicroseconds.load(std::memory_order_relaxed);
+    while(static_cast<long long>(microseconds) > previous && !shard.maxMicroseconds.compare_exchange_weak(previous, static_cast<long long>(microseconds), std::memory_order_relaxed))
+    {
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Discard every recorded duration, must not be called while other threads are recording
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void MetricsHistogram::reset()
+{
+    for(int i = 0; i < METRICS_NUM_SHARDS; i++)
+    {
+        Shard &shard = *m_shards[i];
+        for(size_t j = 0; j < shard.buckets.size(); j++)
+        {
+            shard.buckets[j].store(0, std::memory_order_relaxed);
+        }
+        shard.count.store(0, std::memory_order_relaxed);
+        shard.sumMicroseconds.store(0, std::memory_order_relaxed);
+        shard.maxMicroseconds.store(0, std::memory_order_relaxed);
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the number of recorded durations
+ * @return the count
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+long long MetricsHistogram::getCount() const
+{
+    long long total = 0;
+    for(int i = 0; i < METRICS_NUM_SHARDS; i++)
+    {
+        total += m_shards[i]->count.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the sum of the recorded durations
+ * @return the sum in seconds
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+double MetricsHistogram::getSum() const
+{
+    long long total = 0;
+    for(int i = 0; i < METRICS_NUM_SHARDS; i++)
+    {
+        total += m_shards[i]->sumMicroseconds.load(std::memory_order_relaxed);
+    }
+    return total * 1e-6;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the mean of the recorded durations
+ * @return the mean in seconds
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+double MetricsHistogram::getMean() const
+{
+    long long count = getCount();
+    return count > 0 ? getSum() / count : 0.0;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get the largest recorded duration
+ * @return the maximum in seconds
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+double MetricsHistogram::getMax() const
+{
+    long long maximum = 0;
+    for(int i = 0; i < METRICS_NUM_SHARDS; i++)
+    {
+        maximum = std::max(maximum, m_shards[i]->maxMicroseconds.load(std::memory_order_relaxed));
+    }
+    return maximum * 1e-6;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Get a duration percentile
+ * @param[in] percentile the requested percentile in the range [0, 100]
+ * @return the duration in seconds below which the given percentage of samples fall
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+double MetricsHistogram::getPercentile(double percentile) const
+{
+    // merge the shards into a single snapshot
+    std::vector<long long> buckets(METRICS_NUM_BUCKETS, 0);
+    long long count = 0;
+    for(int i = 0; i < METRICS_NUM_SHARDS; i++)
+    {
+        for(size_t j = 0; j < buckets.size(); j++)
+        {
+            long long value = m_shards[i]->buckets[j].load(std::memory_order_relaxed);
+            buckets[j] += value;
+            count += value;
+        }
+    }
+    if(count == 0)
+    {
+        return 0.0;
+    }
+
+    // find the bucket holding the requested rank
+    long long rank = std::max(1LL, static_cast<long long>(percentile / 100.0 * count + 0.5));
+    long long cumulative = 0;
+    for(size_t j = 0; j < buckets.size(); j++)
+    {
+        cumulative += buckets[j];
+        if(cumulative >= rank)
+        {
+            return std::min(getBucketValue(j) * 1e-6, getMax());
+        }
+    }
+    return getMax();
+}
+
+/*******************************************************************************************************************//**
+ * @brief Print the throughput and latency percentiles
+ * @param[in] label name printed at the start of the summary
+ * @param[in] elapsedSeconds wall clock time over which the durations were recorded
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void MetricsHistogram::printSummary(const char *label, double elapsedSeconds) const
+{
+    long long count = getCount();
+    double fps = elapsedSeconds > 0.0 ? count / elapsedSeconds : 0.0;
+    std::printf("%s: %lld frames in %.3f s (%.2f fps) \n", label, count, elapsedSeconds, fps);
+    std::printf("%s: latency ms mean=%.3f p50=%.3f p95=%.3f p99=%.3f max=%.3f \n", label, getMean() * 1000.0, getPercentile(50.0) * 1000.0, getPercentile(95.0) * 1000.0, getPercentile(99.0) * 1000.0, getMax() * 1000.0);
+}
+
+/*******************************************************************************************************************//**
+ * @brief Class constructor
+ * @param[in] prefix string prepended to every metric name, such as the program name (default: none)
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+MetricsRegistry::MetricsRegistry(const std::string &prefix)
+{
+    m_prefix = prefix;
+    m_intervalSeconds = 1.0;
+    m_stop = false;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Class destructor, writes a final snapshot if dumping was started
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+MetricsRegistry::~MetricsRegistry()
+{
+    stopDumping();
+}
+
+/*******************************************************************************************************************//**
+ * @brief Find a registered metric, registering it if necessary
+ * @param[in] name the metric name
+ * @param[in] help the metric description
+ * @return the registry entry
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+MetricsRegistry::Entry& MetricsRegistry::findOrCreate(const std::string &name, const std::string &help)
+{
+    std::string fullName = m_prefix.empty() ? name : m_prefix + "_" + name;
+    for(size_t i = 0; i < m_entries.size(); i++)
+    {
+        if(m_entries[i]->name == fullName)
+        {
+            return *m_entries[i];
+        }
+    }
+    m_entries.push_back(std::unique_ptr<Entry>(new Entry()));
+    m_entries.back()->name = fullName;
+    m_entries.back()->help = help;
+    return *m_entries.back();
+}
+
+/*******************************************************************************************************************//**
+ * @brief Register a counter
+ * @param[in] name the metric name, by convention ending in _total
+ * @param[in] help the metric description (default: none)
+ * @return reference to the counter
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+MetricsCounter& MetricsRegistry::counter(const std::string &name, const std::string &help)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry &entry = findOrCreate(name, help);
+    if(!entry.counter)
+    {
+        entry.counter.reset(new MetricsCounter());
+    }
+    return *entry.counter;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Register a gauge
+ * @param[in] name the metric name
+ * @param[in] help the metric description (default: none)
+ * @return reference to the gauge
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+MetricsGauge& MetricsRegistry::gauge(const std::string &name, const std::string &help)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry &entry = findOrCreate(name, help);
+    if(!entry.gauge)
+    {
+        entry.gauge.reset(new MetricsGauge());
+    }
+    return *entry.gauge;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Register a duration histogram
+ * @param[in] name the metric name, by convention ending in _seconds
+ * @param[in] help the metric description (default: none)
+ * @return reference to the histogram
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+MetricsHistogram& MetricsRegistry::histogram(const std::string &name, const std::string &help)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry &entry = findOrCreate(name, help);
+    if(!entry.histogram)
+    {
+        entry.histogram.reset(new MetricsHistogram());
+    }
+    return *entry.histogram;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Format every metric in the Prometheus text exposition format, histograms are exposed as summaries
+ * @return the formatted metrics
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+std::string MetricsRegistry::formatPrometheus() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::ostringstream out;
+    for(size_t i = 0; i < m_entries.size(); i++)
+    {
+        const Entry &entry = *m_entries[i];
+        if(!entry.help.empty())
+        {
+            out << "# HELP " << entry.name << " " << entry.help << "\n";
+        }
+        if(entry.counter)
+        {
+            out << "# TYPE " << entry.name << " counter\n";
+            out << entry.name << " " << entry.counter->get() << "\n";
+        }
+        else if(entry.gauge)
+        {
+            out << "# TYPE " << entry.name << " gauge\n";
+            out << entry.name << " " << entry.gauge->get() << "\n";
+        }
+        else if(entry.histogram)
+        {
+            const MetricsHistogram &histogram = *entry.histogram;
+            out << "# TYPE " << entry.name << " summary\n";
+            out << entry.name << "{quantile=\"0.5\"} " << histogram.getPercentile(50.0) << "\n";
+            out << entry.name << "{quantile=\"0.95\"} " << histogram.getPercentile(95.0) << "\n";
+            out << entry.name << "{quantile=\"0.99\"} " << histogram.getPercentile(99.0) << "\n";
+            out << entry.name << "{quantile=\"1\"} " << histogram.getMax() << "\n";
+            out << entry.name << "_sum " << histogram.getSum() << "\n";
+            out << entry.name << "_count " << histogram.getCount() << "\n";
+        }
+    }
+    return out.str();
+}
+
+/*******************************************************************************************************************//**
+ * @brief Format every metric as a single line JSON object
+ * @return the formatted metrics, without a trailing newline
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+std::string MetricsRegistry::formatJson() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::ostringstream out;
+    double timestamp = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+    out.precision(15);
+    out << "{\"timestamp\":" << timestamp;
+    out.precision(6);
+    for(size_t i = 0; i < m_entries.size(); i++)
+    {
+        const Entry &entry = *m_entries[i];
+        out << ",\"" << entry.name << "\":";
+        if(entry.counter)
+        {
+            out << entry.counter->get();
+        }
+        else if(entry.gauge)
+        {
+            out << entry.gauge->get();
+        }
+        else if(entry.histogram)
+        {
+            const MetricsHistogram &histogram = *entry.histogram;
+            out << "{\"count\":" << histogram.getCount() << ",\"sum\":" << histogram.getSum();
+            out << ",\"p50\":" << histogram.getPercentile(50.0) << ",\"p95\":" << histogram.getPercentile(95.0);
+            out << ",\"p99\":" << histogram.getPercentile(99.0) << ",\"max\":" << histogram.getMax() << "}";
+        }
+        else
+        {
+            out << "null";
+        }
+    }
+    out << "}";
+    return out.str();
+}
+
+/*******************************************************************************************************************//**
+ * @brief Write a snapshot of every metric to a file
+ *
+ * Files ending in .jsonl have a line appended. Other files are written to a temporary file that is then renamed over
+ * the target, so readers never observe a partially written file.
+ *
+ * @param[in] path the output file
+ * @return false if the file could not be written
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool MetricsRegistry::dump(const std::string &path) const
+{
+    const std::string jsonExtension = ".jsonl";
+    bool isJson = path.size() >= jsonExtension.size() && path.compare(path.size() - jsonExtension.size(), jsonExtension.size(), jsonExtension) == 0;
+    if(isJson)
+    {
+        std::ofstream file(path.c_str(), std::ios::app);
+        file << formatJson() << "\n";
+        return file.good();
+    }
+
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath.c_str(), std::ios::trunc);
+        file << formatPrometheus();
+        if(!file.good())
+        {
+            return false;
+        }
+    }
+    return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Background thread entry point, writes a snapshot every interval until stopped
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void MetricsRegistry::runDumper()
+{
+    std::unique_lock<std::mutex> lock(m_dumpMutex);
+    while(!m_stop)
+    {
+        m_dumpCondition.wait_for(lock, std::chrono::duration<double>(m_intervalSeconds));
+        lock.unlock();
+        if(!dump(m_path))
+        {
+            std::fprintf(stderr, "Unable to write metrics to %s \n", m_path.c_str());
+        }
+        lock.lock();
+    }
+}
+
+/*******************************************************************************************************************//**
+ * @brief Start writing snapshots to a file on a background thread
+ * @param[in] path the output file
+ * @param[in] intervalSeconds time between snapshots (default: 1 second)
+ * @return false if dumping was already started
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool MetricsRegistry::startDumping(const std::string &path, double intervalSeconds)
+{
+    if(m_thread.joinable())
+    {
+        return false;
+    }
+    m_path = path;
+    m_intervalSeconds = intervalSeconds;
+    m_stop = false;
+    m_thread = std::thread(&MetricsRegistry::runDumper, this);
+    return true;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Stop the background thread after it writes a final snapshot
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void MetricsRegistry::stopDumping()
+{
+    if(!m_thread.joinable())
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_dumpMutex);
+        m_stop = true;
+        m_dumpCondition.notify_all();
+    }
+    m_thread.join();
+}
+
+/*******************************************************************************************************************//**
+ * @brief Check for an optional command line flag and remove it from the argument list
+ * @param[in,out] argc number of command line arguments
+ * @param[in,out] argv string array of command line arguments
+ * @param[in] flag the flag to look for, such as "--bench"
+ * @return true if the flag was present
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool extractFlag(int &argc, char **argv, const char *flag)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        if(std::strcmp(argv[i], flag) == 0)
+        {
+            for(int j = i; j < argc - 1; j++)
+            {
+                argv[j] = argv[j + 1];
+            }
+            argc--;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*******************************************************************************************************************//**
+ * @brief Check for an optional command line option with a value and remove it from the argument list
+ *
+ * The value may be given in the same argument (--name=value) or in the next argument (--name value).
+ *
+ * @param[in,out] argc number of command line arguments
+ * @param[in,out] argv string array of command line arguments
+ * @param[in] name the option to look for, such as "--metrics"
+ * @param[out] valueOut the option value
+ * @return true if the option was present
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool extractOption(int &argc, char **argv, const char *name, std::string &valueOut)
+{
+    size_t nameLength = std::strlen(name);
+    for(int i = 1; i < argc; i++)
+    {
+        int consumed = 0;
+        if(std::strncmp(argv[i], name, nameLength) == 0 && argv[i][nameLength] == '=')
+        {
+            valueOut = argv[i] + nameLength + 1;
+            consumed = 1;
+        }
+        else if(std::strcmp(argv[i], name) == 0 && i + 1 < argc)
+        {
+            valueOut = argv[i + 1];
+            consumed = 2;
+        }
+
+        if(consumed > 0)
+        {
+            for(int j = i; j + consumed < argc; j++)
+            {
+                argv[j] = argv[j + consumed];
+            }
+            argc -= consumed;
+            return true;
+        }
+    }
+    return false;
+}
@@ -9,10 +9,10 @@
 
 #include <iostream>
 #include <stdio.h>
-#include <time.h>
 #include <string>
 #include "opencv2/opencv.hpp"
 #include "PupilTracker.h"
+#include "Metrics.h"
 
 // configuration parameters
 #define NUM_COMNMAND_LINE_ARGUMENTS 2
@@ -48,13 +48,17 @@ cv::Scalar COLOR_MAGENTA = CV_RGB(255, 0, 255);
  **********************************************************************************************************************/
 int main(int argc, char** argv)
 {
+    // write metrics to a file instead of printing per frame timing, if requested
+    std::string metricsPath;
+    bool metricsEnabled = extractOption(argc, argv, "--metrics", metricsPath);
+
     // validate and parse the command line arguments
     std::string videoSource = "0";
     bool displayMode = true;
     bool flipDisplay = false;
     if(argc != NUM_COMNMAND_LINE_ARGUMENTS + 1)
     {
-        std::cout << "USAGE: <video_source> <display_mode>" << std::endl;
+        std::cout << "USAGE: <video_source> <display_mode> [--metrics=<path>]" << std::endl;
         std::cout << "Running with default parameters..." << std::endl;
     }
     else
@@ -123,30 +127,44 @@ int main(int argc, char** argv)
     // store the frame data
     cv::Mat eyeImage;
 
-    // store the time between frames
-    int frameStartTicks, frameEndTicks, processStartTicks, processEndTicks;
-    float processTime, totalTime;
+    // register the tracking metrics, written to a file in the background if requested
+    MetricsRegistry metrics("pupil_demo");
+    MetricsCounter &framesTotal = metrics.counter("frames_total", "Frames processed");
+    MetricsCounter &trackingFailures = metrics.counter("tracking_failures_total", "Frames where the pupil was not found");
+    MetricsHistogram &pupilSeconds = metrics.histogram("pupil_seconds", "Pupil detection time in seconds");
+    MetricsHistogram &frameSeconds = metrics.histogram("frame_seconds", "Frame processing time in seconds");
+    MetricsGauge &pupilX = metrics.gauge("pupil_x", "Horizontal pupil centroid in pixels");
+    MetricsGauge &pupilY = metrics.gauge("pupil_y", "Vertical pupil centroid in pixels");
+    if(metricsEnabled)
+    {
+        metrics.startDumping(metricsPath);
+    }
 
     // process data until program termination
     bool isRunning = true;
     while(isRunning)
     {
         // start the timer
-        frameStartTicks = clock();
+        double frameStartTicks = static_cast<double>(cv::getTickCount());
 
         // attempt to acquire an image frame
         if(occulography.read(eyeImage))
         {
             // process the image frame
-            processStartTicks = clock();
+            double processStartTicks = static_cast<double>(cv::getTickCount());
             bool trackingSuccess = tracker.findPupil(eyeImage);
-            processEndTicks = clock();
-            processTime = ((float)(processEndTicks - processStartTicks)) / CLOCKS_PER_SEC;
+            pupilSeconds.record((static_cast<double>(cv::getTickCount()) - processStartTicks) / cv::getTickFrequency());
 
-            // warn on tracking failure
-            if(!trackingSuccess)
+            // count tracking failures and publish the latest pupil location
+            if(trackingSuccess)
+            {
+                cv::Point2f centroid = tracker.getEllipseCentroid();
+                pupilX.set(centroid.x);
+                pupilY.set(centroid.y);
+            }
+            else
             {
-                std::cout << "Unable to locate pupil!" << std::endl;
+                trackingFailures.add();
             }
 
             // update the display
@@ -196,12 +214,9 @@ int main(int argc, char** argv)
             continue;
         }
 
-        // stop the timer and print the elapsed time
-        frameEndTicks = clock();
-        totalTime = ((float)(frameEndTicks - frameStartTicks)) / CLOCKS_PER_SEC;
-        std::cout << std::fixed;
-        std::cout << std::setprecision(4);
-        std::cout << "Processing time (pupil, total): " << processTime << " " << totalTime << " - coordinates: " << tracker.getEllipseCentroid() << std::endl;
+        // stop the timer and record the elapsed time
+        frameSeconds.record((static_cast<double>(cv::getTickCount()) - frameStartTicks) / cv::getTickFrequency());
+        framesTotal.add();
     }
 
     // release the video source before exiting
@@ -0,0 +1,267 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+/***********************************************************************************************************************
+ * @file ClusterTracker.cpp
+ * @brief Implementation of the ClusterTracker class
+ *
+ * This class assigns persistent identifiers to point clusters across a sequence of frames
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#include "ClusterTracker.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+/***********************************************************************************************************************
+ * @brief Candidate pairing between a current cluster and a previous cluster
+ **********************************************************************************************************************/
+struct ClusterMatch
+{
+    float score;
+    int current;
+    int previous;
+
+    bool operator<(const ClusterMatch &other) const
+    {
+        return score > other.score;
+    }
+};
+
+/***********************************************************************************************************************
+ * @brief Class constructor
+ *
+ * Initializes the ClusterTracker with the given matching parameters
+ *
+ * @param[in] cellSize edge length of the spatial hash cells, should exceed the expected per-frame motion (default: 0.25)
+ * @param[in] minOverlap minimum bounding box intersection over union required to match two clusters (default: 0.2)
+ * @param[in] stableDistance maximum centroid motion for a cluster to be reported as unchanged (default: 0.005)
+ * @param[in] stableSizeRatio maximum relative point count change for a cluster to be reported as unchanged (default: 0.02)
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+ClusterTracker::ClusterTracker(float cellSize, float minOverlap, float stableDistance, float stableSizeRatio)
+{
+    m_cellSize = cellSize;
+    m_minOverlap = minOverlap;
+    m_stableDistance = stableDistance;
+    m_stableSizeRatio = stableSizeRatio;
+    reset();
+}
+
+/***********************************************************************************************************************
+ * @brief Clear the tracking state
+ *
+ * Forgets all previously tracked clusters, the next update will assign new identifiers starting from zero
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void ClusterTracker::reset()
+{
+    m_nextId = 0;
+    m_clusters.clear();
+    m_grid.clear();
+}
+
+/***********************************************************************************************************************
+ * @brief Get the clusters from the most recent update
+ *
+ * @return list of tracked clusters, ordered to match the cluster indices passed to the last update
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+const std::vector<TrackedCluster>& ClusterTracker::getClusters() const
+{
+    return m_clusters;
+}
+
+/***********************************************************************************************************************
+ * @brief Match the clusters of a new frame against the previous frame
+ *
+ * Computes the centroid and bounding box of each cluster, matches them against the previous frame using the spatial
+ * hash, and assigns persistent identifiers. Clusters without a match receive a new identifier.
+ *
+ * @param[in] cloud pointer to the clustered point cloud
+ * @param[in] clusterIndices list of point indices for each cluster
+ * @return list of tracked clusters, ordered to match clusterIndices
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+const std::vector<TrackedCluster>& ClusterTracker::update(const pcl::PointCloud<pcl::PointXYZRGBA>::ConstPtr &cloud, const std::vector<pcl::PointIndices> &clusterIndices)
+{
+    // compute the summary of each current cluster
+    std::vector<TrackedCluster> current(clusterIndices.size());
+    for(size_t i = 0; i < clusterIndices.size(); i++)
+    {
+        TrackedCluster &cluster = current.at(i);
+        const std::vector<int> &indices = clusterIndices.at(i).indices;
+        cluster.id = -1;
+        cluster.age = 0;
+        cluster.unchanged = false;
+        cluster.numPoints = static_cast<int>(indices.size());
+        cluster.centroid.setZero();
+        cluster.minPoint.setConstant(std::numeric_limits<float>::max());
+        cluster.maxPoint.setConstant(-std::numeric_limits<float>::max());
+        for(size_t j = 0; j < indices.size(); j++)
+        {
+            const pcl::PointXYZRGBA &p = cloud->points[indices[j]];
+            Eigen::Vector3f position(p.x, p.y, p.z);
+            cluster.centroid += position;
+            cluster.minPoint = cluster.minPoint.cwiseMin(position);
+            cluster.maxPoint = cluster.maxPoint.cwiseMax(position);
+        }
+        if(cluster.numPoints > 0)
+        {
+            cluster.centroid /= static_cast<float>(cluster.numPoints);
+        }
+    }
+
+    // gather candidate pairings from the neighbouring cells of each current centroid
+    std::vector<ClusterMatch> matches;
+    matches.reserve(current.size() * 2);
+    for(size_t i = 0; i < current.size(); i++)
+    {
+        int cx, cy, cz;
+        cellIndex(current.at(i).centroid, cx, cy, cz);
+        for(int dx = -1; dx <= 1; dx++)
+        {
+            for(int dy = -1; dy <= 1; dy++)
+            {
+                for(int dz = -1; dz <= 1; dz++)
+                {
+                    std::unordered_map<long long, std::vector<int> >::const_iterator cell = m_grid.find(cellKey(cx + dx, cy + dy, cz + dz));
+                    if(cell == m_grid.end())
+                    {
+                        continue;
+                    }
+                    for(size_t k = 0; k < cell->second.size(); k++)
+                    {
+                        int previous = cell->second[k];
+                        float overlap = boxOverlap(current.at(i), m_clusters.at(previous));
+                        if(overlap >= m_minOverlap)
+                        {
+                            ClusterMatch match = {overlap, static_cast<int>(i), previous};
+                            matches.push_back(match);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // assign the best pairings first, each cluster may only be used once
+    std::sort(matches.begin(), matches.end());
+    std::vector<bool> previousUsed(m_clusters.size(), false);
+    for(size_t i = 0; i < matches.size(); i++)
+    {
+        const ClusterMatch &match = matches.at(i);
+        TrackedCluster &cluster = current.at(match.current);
+        if(cluster.id >= 0 || previousUsed.at(match.previous))
+        {
+            continue;
+        }
+        const TrackedCluster &previous = m_clusters.at(match.previous);
+        previousUsed.at(match.previous) = true;
+        cluster.id = previous.id;
+        cluster.age = previous.age + 1;
+
+        // flag clusters that neither moved nor changed size so consumers can skip reprocessing them
+        float motion = (cluster.centroid - previous.centroid).norm();
+        float sizeChange = std::abs(cluster.numPoints - previous.numPoints) / static_cast<float>(std::max(previous.numPoints, 1));
+        cluster.unchanged = motion <= m_stableDistance && sizeChange <= m_stableSizeRatio;
+    }
+
+    // unmatched clusters are new objects
+    for(size_t i = 0; i < current.size(); i++)
+    {
+        if(current.at(i).id < 0)
+        {
+            current.at(i).id = m_nextId++;
+        }
+    }
+
+    // rebuild the spatial hash from the current frame for the next update
+    m_clusters.swap(current);
+    m_grid.clear();
+    m_grid.reserve(m_clusters.size());
+    for(size_t i = 0; i < m_clusters.size(); i++)
+    {
+        int cx, cy, cz;
+        cellIndex(m_clusters.at(i).centroid, cx, cy, cz);
+        m_grid[cellKey(cx, cy, cz)].push_back(static_cast<int>(i));
+    }
+
+    return m_clusters;
+}
+
+/***********************************************************************************************************************
+ * @brief Compute the spatial hash cell containing a position
+ *
+ * @param[in] position the query position
+ * @param[out] x cell index along the x axis
+ * @param[out] y cell index along the y axis
+ * @param[out] z cell index along the z axis
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void ClusterTracker::cellIndex(const Eigen::Vector3f &position, int &x, int &y, int &z) const
+{
+    x = static_cast<int>(std::floor(position.x() / m_cellSize));
+    y = static_cast<int>(std::floor(position.y() / m_cellSize));
+    z = static_cast<int>(std::floor(position.z() / m_cellSize));
+}
+
+/***********************************************************************************************************************
+ * @brief Pack three cell indices into a single hash key
+ *
+ * @param[in] x cell index along the x axis
+ * @param[in] y cell index along the y axis
+ * @param[in] z cell index along the z axis
+ * @return the packed key, using 21 bits per axis
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+long long ClusterTracker::cellKey(int x, int y, int z) const
+{
+    const long long mask = (1LL << 21) - 1;
+    return ((static_cast<long long>(x) & mask) << 42) | ((static_cast<long long>(y) & mask) << 21) | (static_cast<long long>(z) & mask);
+}
+
+/***********************************************************************************************************************
+ * @brief Compute the intersection over union of two cluster bounding boxes
+ *
+ * Boxes are padded by a small margin so that planar clusters with zero thickness still produce a usable score
+ *
+ * @param[in] a the first cluster
+ * @param[in] b the second cluster
+ * @return the intersection over union, in the range [0, 1]
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+float ClusterTracker::boxOverlap(const TrackedCluster &a, const TrackedCluster &b)
+{
+    const float padding = 0.005f;
+    Eigen::Vector3f aMin = a.minPoint.array() - padding;
+    Eigen::Vector3f aMax = a.maxPoint.array() + padding;
+    Eigen::Vector3f bMin = b.minPoint.array() - padding;
+    Eigen::Vector3f bMax = b.maxPoint.array() + padding;
+
+    Eigen::Vector3f intersection = (aMax.cwiseMin(bMax) - aMin.cwiseMax(bMin)).cwiseMax(0.0f);
+    float intersectionVolume = intersection.prod();
+    float unionVolume = (aMax - aMin).prod() + (bMax - bMin).prod() - intersectionVolume;
+    if(unionVolume <= 0.0f)
+    {
+        return 0.0f;
+    }
+    return intersectionVolume / unionVolume;
+}
@@ -0,0 +1,97 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+/*******************************************************************************************************************//**
+ * @file ClusterTracker.h
+ * @brief Header file for the ClusterTracker class
+ *
+ * This class assigns persistent identifiers to point clusters across a sequence of frames
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#ifndef CLUSTERTRACKER_H
+#define CLUSTERTRACKER_H
+
+#include <vector>
+#include <unordered_map>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/PointIndices.h>
+#include <Eigen/Core>
+
+/*******************************************************************************************************************//**
+ * @struct TrackedCluster
+ *
+ * @brief Summary of a single cluster and the persistent identity assigned to it
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+struct TrackedCluster
+{
+    int id;                     // persistent identifier, stable across frames while the cluster is matched
+    int age;                    // number of consecutive frames this identifier has been matched
+    int numPoints;              // number of points in the cluster for the current frame
+    bool unchanged;             // true if the cluster did not move or change size since the previous frame
+    Eigen::Vector3f centroid;   // mean position of the cluster points
+    Eigen::Vector3f minPoint;   // minimum corner of the axis aligned bounding box
+    Eigen::Vector3f maxPoint;   // maximum corner of the axis aligned bounding box
+};
+
+/*******************************************************************************************************************//**
+ * @class ClusterTracker
+ *
+ * @brief Class for matching the clusters of the current frame to the clusters of the previous frame
+ *
+ * Previous clusters are inserted into a spatial hash keyed by the grid cell containing their centroid. Each current
+ * cluster only considers the previous clusters in the neighbouring cells, so matching is linear in the number of
+ * clusters. Candidate pairs are scored by bounding box overlap and assigned greedily from best to worst.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class ClusterTracker
+{
+private:
+
+    // tracking settings
+    float m_cellSize;
+    float m_minOverlap;
+    float m_stableDistance;
+    float m_stableSizeRatio;
+
+    // tracking state
+    int m_nextId;
+    std::vector<TrackedCluster> m_clusters;
+    std::unordered_map<long long, std::vector<int> > m_grid;
+
+    // helper functions
+    long long cellKey(int x, int y, int z) const;
+    void cellIndex(const Eigen::Vector3f &position, int &x, int &y, int &z) const;
+    static float boxOverlap(const TrackedCluster &a, const TrackedCluster &b);
+
+public:
+
+    // constructors
+    ClusterTracker(float cellSize=0.25, float minOverlap=0.2, float stableDistance=0.005, float stableSizeRatio=0.02);
+
+    // tracking functions
+    const std::vector<TrackedCluster>& update(const pcl::PointCloud<pcl::PointXYZRGBA>::ConstPtr &cloud, const std::vector<pcl::PointIndices> &clusterIndices);
+    const std::vector<TrackedCluster>& getClusters() const;
+    void reset();
+};
+
+#endif // CLUSTERTRACKER_H
@@ -0,0 +1,75 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+/*******************************************************************************************************************//**
+ * @file NeighborGraph.h
+ * @brief Header file for the NeighborGraph class
+ *
+ * This class caches radius neighbour lists so that euclidean clustering can be repeated with different parameters
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#ifndef NEIGHBORGRAPH_H
+#define NEIGHBORGRAPH_H
+
+#include <vector>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/PointIndices.h>
+#include <pcl/search/kdtree.h>
+
+/*******************************************************************************************************************//**
+ * @class NeighborGraph
+ *
+ * @brief Class storing the radius neighbours of every point in a cloud, computed once at a maximum search radius
+ *
+ * The neighbour lists are stored in compressed row form, sorted by distance. Clustering at any tolerance up to the
+ * maximum radius only walks the prefix of each list, so no spatial searches are needed after the graph is built.
+ * Once built, the graph is read only and can be shared by concurrent extractions.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class NeighborGraph
+{
+private:
+
+    // graph data in compressed row form
+    float m_maxRadius;
+    std::vector<int> m_offsets;
+    std::vector<int> m_neighbors;
+    std::vector<float> m_sqrDistances;
+
+public:
+
+    // constructors
+    NeighborGraph();
+
+    // graph construction
+    void build(const pcl::search::KdTree<pcl::PointXYZRGBA>::Ptr &tree, float maxRadius, int numThreads=1);
+    void clear();
+
+    // accessors
+    float getMaxRadius() const;
+    int getNumPoints() const;
+    size_t getNumEdges() const;
+
+    // clustering
+    void extract(float tolerance, int minClusterSize, int maxClusterSize, std::vector<pcl::PointIndices> &clusterIndices) const;
+};
+
+#endif // NEIGHBORGRAPH_H
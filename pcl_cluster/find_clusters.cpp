@@ -16,14 +16,17 @@
 //
 /***********************************************************************************************************************
 * @file find_clusters.cpp
-* @brief finds a plane in a PCD file
+* @brief finds clusters in a PCD file
 *
-* Simple example of identifying point clusters in a PCD file
+* Simple example of identifying point clusters in a PCD file. When multiple files are given, they are processed as a
+* sequence of frames and clusters keep the same identifier and color from frame to frame.
 *
 * @author Christopher D. McMurrough
 **********************************************************************************************************************/
 
 #include "CloudVisualizer.h"
+#include "ClusterTracker.h"
+#include "NeighborGraph.h"
 
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
@@ -38,13 +41,26 @@
 #include <pcl/segmentation/euclidean_cluster_comparator.h>
 #include <pcl/segmentation/extract_clusters.h>
 
+#include <climits>
+#include <thread>
+
 #define NUM_COMMAND_ARGS 1
 
 using namespace std;
 
+// clustering parameters, adjustable at runtime from the keyboard callback
+float clusterDistance = 0.02;
+int minClusterSize = 50;
+int maxClusterSize = 100000;
+bool reclusterRequested = false;
+
+// radius of the cached neighbour graph, the graph is rebuilt if the cluster distance exceeds it
+const float maxClusterDistance = 0.05;
+
 // function prototypes
 void pointPickingCallback(const pcl::visualization::PointPickingEvent& event, void* cookie);
 void keyboardCallback(const pcl::visualization::KeyboardEvent &event, void* viewer_void);
+void colorClusters(pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &cloud, const std::vector<pcl::PointIndices> &clusterIndices, ClusterTracker &tracker);
 
 /***********************************************************************************************************************
 * @brief callback function for handling a point picking event
@@ -93,9 +109,80 @@ void keyboardCallback(const pcl::visualization::KeyboardEvent &event, void* view
             case 'a':
                 cout << "KEYPRESS DETECTED: '" << event.getKeySym() << "'" << endl;
                 break;
+            case '[':
+                clusterDistance = std::max(clusterDistance - 0.005f, 0.005f);
+                reclusterRequested = true;
+                break;
+            case ']':
+                clusterDistance += 0.005f;
+                reclusterRequested = true;
+                break;
+            case ',':
+                minClusterSize = std::max(minClusterSize / 2, 1);
+                reclusterRequested = true;
+                break;
+            case '.':
+                minClusterSize = std::min(minClusterSize * 2, maxClusterSize);
+                reclusterRequested = true;
+                break;
+            case ';':
+                maxClusterSize = std::max(maxClusterSize / 2, minClusterSize);
+                reclusterRequested = true;
+                break;
+            case '\'':
+                maxClusterSize = std::min(maxClusterSize, INT_MAX / 2) * 2;
+                reclusterRequested = true;
+                break;
             default:
                 break;
         }
+
+        // report the updated parameters
+        if(reclusterRequested)
+        {
+            cout << "CLUSTER PARAMETERS: distance=" << clusterDistance << " minSize=" << minClusterSize << " maxSize=" << maxClusterSize << endl;
+        }
+    }
+}
+
+/***********************************************************************************************************************
+* @brief Colors each cluster by its persistent identifier
+*
+* Matches the clusters against the previous result of the tracker and colors the cluster points with the color
+* assigned to the matched identifier
+*
+* @param[in,out] cloud pointer to the clustered point cloud
+* @param[in] clusterIndices list of point indices for each cluster
+* @param[in,out] tracker the cluster tracker holding the previous result
+* @author Christopher D. McMurrough
+**********************************************************************************************************************/
+void colorClusters(pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &cloud, const std::vector<pcl::PointIndices> &clusterIndices, ClusterTracker &tracker)
+{
+    // match the clusters against the previous result
+    const std::vector<TrackedCluster> &clusters = tracker.update(cloud, clusterIndices);
+    int newClusters = 0;
+    int unchangedClusters = 0;
+    for(int i = 0; i < clusters.size(); i++)
+    {
+        newClusters += clusters.at(i).age == 0 ? 1 : 0;
+        unchangedClusters += clusters.at(i).unchanged ? 1 : 0;
+    }
+    std::cout << "Clusters identified: " << clusterIndices.size() << " (new: " << newClusters << ", unchanged: " << unchangedClusters << ")" << std::endl;
+
+    // color each cluster using its persistent identifier
+    for(int i = 0; i < clusterIndices.size(); i++)
+    {
+        // get the color assigned to this cluster identifier
+        int r, g, b;
+        CloudVisualizer::getColor(clusters.at(i).id, r, g, b);
+
+        // iterate through the cluster points
+        for(int j = 0; j < clusterIndices.at(i).indices.size(); j++)
+        {
+            cloud->points.at(clusterIndices.at(i).indices.at(j)).r = r;
+            cloud->points.at(clusterIndices.at(i).indices.at(j)).g = g;
+            cloud->points.at(clusterIndices.at(i).indices.at(j)).b = b;
+        }
     }
 }
 
@@ -159,93 +246,130 @@ bool openCloud(pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &cloudOut, const char* fi
 int main(int argc, char** argv)
 {
     // validate and parse the command line arguments
-    if(argc != NUM_COMMAND_ARGS + 1)
+    if(argc < NUM_COMMAND_ARGS + 1)
     {
-        std::printf("USAGE: %s <file_name>\n", argv[0]);
+        std::printf("USAGE: %s <file_name> [<file_name> ...]\n", argv[0]);
         return 0;
     }
 
-    // parse the command line arguments
-    char* fileName = argv[1];
-
     // create a stop watch for measuring time
     pcl::StopWatch watch;
 
     // initialize the cloud viewer
     CloudVisualizer CV("Rendering Window");
 
-    // start timing the processing step
-    watch.reset();
+    // create the cluster tracker for keeping cluster identities consistent between frames
+    ClusterTracker tracker;
 
-    // open the point cloud
-    pcl::PointCloud<pcl::PointXYZRGBA>::Ptr cloudIn(new pcl::PointCloud<pcl::PointXYZRGBA>);
-    openCloud(cloudIn, fileName);
-
-    // downsample the cloud using a voxel grid filter
-    const float voxelSize = 0.01;
+    // store the most recent frame for rendering and interactive reclustering
     pcl::PointCloud<pcl::PointXYZRGBA>::Ptr cloudFiltered(new pcl::PointCloud<pcl::PointXYZRGBA>);
-    pcl::VoxelGrid<pcl::PointXYZRGBA> voxFilter;
-    voxFilter.setInputCloud(cloudIn);
-    voxFilter.setLeafSize(static_cast<float>(voxelSize), static_cast<float>(voxelSize), static_cast<float>(voxelSize));
-    voxFilter.filter(*cloudFiltered);
-    std::cout << "Points before downsampling: " << cloudIn->points.size() << std::endl;
-    std::cout << "Points before downsampling: " << cloudFiltered->points.size() << std::endl;
-
-    // create the vector of indices lists (each element contains a list of imultiple indices)
-    const float clusterDistance = 0.02;
-    int minClusterSize = 50;
-    int maxClusterSize = 100000;
-    std::vector<pcl::PointIndices> clusterIndices;
-
-    // Creating the KdTree object for the search method of the extraction
-    pcl::search::KdTree<pcl::PointXYZRGBA>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZRGBA>);
-    tree->setInputCloud(cloudFiltered);
-
-    // create the euclidian cluster extraction object
-    pcl::EuclideanClusterExtraction<pcl::PointXYZRGBA> ec;
-    ec.setClusterTolerance(clusterDistance);
-    ec.setMinClusterSize(minClusterSize);
-    ec.setMaxClusterSize(maxClusterSize);
-    ec.setSearchMethod(tree);
-    ec.setInputCloud(cloudFiltered);
-
-    // perform the clustering
-    ec.extract(clusterIndices);
-    std::cout << "Clusters identified: " << clusterIndices.size() << std::endl;
-
-    // color each cluster
-    for(int i = 0; i < clusterIndices.size(); i++)
+    pcl::PointCloud<pcl::PointXYZRGBA>::Ptr cloudUncolored(new pcl::PointCloud<pcl::PointXYZRGBA>);
+    pcl::search::KdTree<pcl::PointXYZRGBA>::Ptr tree;
+    NeighborGraph graph;
+
+    // process each file as a frame of the sequence, the viewer is set up with the first file that loads
+    bool firstLoaded = false;
+    for(int frame = 1; frame < argc && CV.isRunning(); frame++)
     {
-        // create a random color for this cluster
-        int r = rand() % 256;
-        int g = rand() % 256;
-        int b = rand() % 256;
+        // parse the command line arguments
+        char* fileName = argv[frame];
 
-        // iterate through the cluster points
-        for(int j = 0; j < clusterIndices.at(i).indices.size(); j++)
+        // start timing the processing step
+        watch.reset();
+
+        // open the point cloud
+        pcl::PointCloud<pcl::PointXYZRGBA>::Ptr cloudIn(new pcl::PointCloud<pcl::PointXYZRGBA>);
+        if(!openCloud(cloudIn, fileName))
         {
-            cloudFiltered->points.at(clusterIndices.at(i).indices.at(j)).r = r;
-            cloudFiltered->points.at(clusterIndices.at(i).indices.at(j)).g = g;
-            cloudFiltered->points.at(clusterIndices.at(i).indices.at(j)).b = b;
+            continue;
         }
-    }
-
-    // get the elapsed time
-    double elapsedTime = watch.getTimeSeconds();
-    std::cout << elapsedTime << " seconds passed " << std::endl;
 
-    // render the scene
-    CV.addCloud(cloudFiltered);
-    CV.addCoordinateFrame(cloudFiltered->sensor_origin_, cloudFiltered->sensor_orientation_);
+        // downsample the cloud using a voxel grid filter
+        const float voxelSize = 0.01;
+        pcl::PointCloud<pcl::PointXYZRGBA>::Ptr frameFiltered(new pcl::PointCloud<pcl::PointXYZRGBA>);
+        pcl::VoxelGrid<pcl::PointXYZRGBA> voxFilter;
+        voxFilter.setInputCloud(cloudIn);
+        voxFilter.setLeafSize(static_cast<float>(voxelSize), static_cast<float>(voxelSize), static_cast<float>(voxelSize));
+        voxFilter.filter(*frameFiltered);
+        std::cout << "Points before downsampling: " << cloudIn->points.size() << std::endl;
+        std::cout << "Points after downsampling: " << frameFiltered->points.size() << std::endl;
+
+        // create the vector of indices lists (each element contains a list of imultiple indices)
+        std::vector<pcl::PointIndices> clusterIndices;
+
+        // Creating the KdTree object for the search method of the extraction
+        tree.reset(new pcl::search::KdTree<pcl::PointXYZRGBA>);
+        tree->setInputCloud(frameFiltered);
+        graph.clear();
+
+        // create the euclidian cluster extraction object
+        pcl::EuclideanClusterExtraction<pcl::PointXYZRGBA> ec;
+        ec.setClusterTolerance(clusterDistance);
+        ec.setMinClusterSize(minClusterSize);
+        ec.setMaxClusterSize(maxClusterSize);
+        ec.setSearchMethod(tree);
+        ec.setInputCloud(frameFiltered);
+
+        // perform the clustering
+        ec.extract(clusterIndices);
+
+        // color the clusters, keeping an uncolored copy for reclustering
+        *cloudUncolored = *frameFiltered;
+        colorClusters(frameFiltered, clusterIndices, tracker);
+
+        // get the elapsed time
+        double elapsedTime = watch.getTimeSeconds();
+        std::cout << elapsedTime << " seconds passed " << std::endl;
+
+        // render the scene
+        cloudFiltered = frameFiltered;
+        if(!firstLoaded)
+        {
+            firstLoaded = true;
+            CV.addCloud(cloudFiltered);
+            CV.addCoordinateFrame(cloudFiltered->sensor_origin_, cloudFiltered->sensor_orientation_);
 
-    // register mouse and keyboard event callbacks
-    CV.registerPointPickingCallback(pointPickingCallback, cloudFiltered);
-    CV.registerKeyboardCallback(keyboardCallback);
+            // register mouse and keyboard event callbacks
+            CV.registerPointPickingCallback(pointPickingCallback, cloudFiltered);
+            CV.registerKeyboardCallback(keyboardCallback);
+        }
+        else
+        {
+            CV.updateCloud(cloudFiltered);
+        }
+        CV.spin(100);
+    }
 
     // enter visualization loop
+    std::cout << "Adjust clustering with '[' ']' (distance), ',' '.' (min size), ';' '\'' (max size)" << std::endl;
     while(CV.isRunning())
     {
         CV.spin(100);
+
+        // recluster the last frame if the parameters were changed
+        if(reclusterRequested && tree)
+        {
+            reclusterRequested = false;
+            watch.reset();
+
+            // build the neighbour graph on first use, reusing the existing search tree
+            if(graph.getNumPoints() != static_cast<int>(cloudUncolored->points.size()) || clusterDistance > graph.getMaxRadius())
+            {
+                graph.build(tree, std::max(maxClusterDistance, clusterDistance), std::thread::hardware_concurrency());
+                std::cout << "Neighbour graph built (" << graph.getNumEdges() << " edges) in " << watch.getTimeSeconds() << " seconds" << std::endl;
+                watch.reset();
+            }
+
+            // extract the clusters from the cached graph
+            std::vector<pcl::PointIndices> clusterIndices;
+            graph.extract(clusterDistance, minClusterSize, maxClusterSize, clusterIndices);
+
+            // recolor and update the rendered cloud
+            *cloudFiltered = *cloudUncolored;
+            colorClusters(cloudFiltered, clusterIndices, tracker);
+            CV.updateCloud(cloudFiltered);
+            std::cout << "Reclustered in " << watch.getTimeSeconds() * 1000.0 << " ms" << std::endl;
+        }
     }
 
     // exit program
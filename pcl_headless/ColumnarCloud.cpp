@@ -0,0 +1,620 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+/***********************************************************************************************************************
+ * @file ColumnarCloud.cpp
+ * @brief Implementation of reading and writing columnar point cloud files
+ *
+ * See ColumnarCloud.h for a description of the file layout
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#include "ColumnarCloud.h"
+
+#include <pcl/io/lzf.h>
+#include <pcl/console/print.h>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+// file format constants
+#define PCC_MAGIC "PCC1"
+#define PCC_VERSION 1
+#define PCC_NUM_FIELDS 4
+#define PCC_FIELD_NAME_LENGTH 8
+#define PCC_FLAG_COMPRESSED 0x01
+
+// field names and element sizes, in file order (the field index matches the CLOUD_FIELD bit)
+static const char* FIELD_NAMES[PCC_NUM_FIELDS] = {"x", "y", "z", "rgba"};
+static const unsigned int FIELD_SIZE = 4;
+
+/***********************************************************************************************************************
+ * @brief Write a value to a binary stream
+ **********************************************************************************************************************/
+template<typename T> static void writeValue(std::ofstream &file, const T &value)
+{
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+/***********************************************************************************************************************
+ * @brief Read a value from a binary stream
+ **********************************************************************************************************************/
+template<typename T> static bool readValue(std::ifstream &file, T &value)
+{
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+/***********************************************************************************************************************
+ * @brief Get a pointer to the storage of a field within a point
+ *
+ * @param[in] point the point to access
+ * @param[in] field the field index in file order
+ * @return pointer to the first byte of the field
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+static const char* fieldPointer(const pcl::PointXYZRGBA &point, unsigned int field)
+{
+    switch(field)
+    {
+        case 0:
+            return reinterpret_cast<const char*>(&point.x);
+        case 1:
+            return reinterpret_cast<const char*>(&point.y);
+        case 2:
+            return reinterpret_cast<const char*>(&point.z);
+        default:
+            return reinterpret_cast<const char*>(&point.rgba);
+    }
+}
+
+/***********************************************************************************************************************
+ * @brief Spread the lower 10 bits of a value so that two zero bits separate each bit, for building Morton codes
+ **********************************************************************************************************************/
+static unsigned int spreadBits(unsigned int value)
+{
+    value &= 0x3ff;
+    value = (value | (value << 16)) & 0x030000ff;
+    value = (value | (value << 8)) & 0x0300f00f;
+    value = (value | (value << 4)) & 0x030c30c3;
+    value = (value | (value << 2)) & 0x09249249;
+    return value;
+}
+
+/***********************************************************************************************************************
+ * @brief Compute a point ordering that keeps nearby points in the same chunk
+ *
+ * Sorts the points along a Morton curve over the cloud bounding box, so that the chunk bounding boxes are compact
+ *
+ * @param[in] cloudIn the input cloud
+ * @param[out] order the sorted point indices
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+static void spatialOrder(const pcl::PointCloud<pcl::PointXYZRGBA> &cloudIn, std::vector<unsigned int> &order)
+{
+    const size_t numPoints = cloudIn.points.size();
+
+    // compute the bounding box of the finite points
+    Eigen::Vector3f minPoint = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+    Eigen::Vector3f maxPoint = Eigen::Vector3f::Constant(-std::numeric_limits<float>::max());
+    for(size_t i = 0; i < numPoints; i++)
+    {
+        const pcl::PointXYZRGBA &p = cloudIn.points[i];
+        if(std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z))
+        {
+            minPoint = minPoint.cwiseMin(Eigen::Vector3f(p.x, p.y, p.z));
+            maxPoint = maxPoint.cwiseMax(Eigen::Vector3f(p.x, p.y, p.z));
+        }
+    }
+    Eigen::Vector3f scale = (maxPoint - minPoint).cwiseMax(1e-6f).cwiseInverse() * 1023.0f;
+
+    // compute the Morton code of each point, non finite points are placed at the end
+    std::vector<std::pair<unsigned int, unsigned int> > keys(numPoints);
+    for(size_t i = 0; i < numPoints; i++)
+    {
+        const pcl::PointXYZRGBA &p = cloudIn.points[i];
+        unsigned int code = std::numeric_limits<unsigned int>::max();
+        if(std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z))
+        {
+            Eigen::Vector3f q = (Eigen::Vector3f(p.x, p.y, p.z) - minPoint).cwiseProduct(scale);
+            code = spreadBits(static_cast<unsigned int>(q.x())) | (spreadBits(static_cast<unsigned int>(q.y())) << 1) | (spreadBits(static_cast<unsigned int>(q.z())) << 2);
+        }
+        keys[i] = std::make_pair(code, static_cast<unsigned int>(i));
+    }
+    std::sort(keys.begin(), keys.end());
+
+    order.resize(numPoints);
+    for(size_t i = 0; i < numPoints; i++)
+    {
+        order[i] = keys[i].second;
+    }
+}
+
+/***********************************************************************************************************************
+ * @brief Saves a point cloud in the columnar format
+ *
+ * Points are reordered along a space filling curve before being split into chunks, so the organized structure of the
+ * input cloud is not preserved
+ *
+ * @param[in] cloudIn the cloud to save
+ * @param[in] fileName path and name of output file
+ * @param[in] compress byte shuffle and LZF compress each block if true (default: true)
+ * @param[in] chunkSize number of points per chunk (default: 65536)
+ * @return false if an error occurred while writing the file
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool saveColumnarCloud(const pcl::PointCloud<pcl::PointXYZRGBA> &cloudIn, const std::string &fileName, bool compress, unsigned int chunkSize)
+{
+    if(chunkSize == 0)
+    {
+        PCL_ERROR("error while attempting to save pcc file, the chunk size must be positive: %s \n", fileName.c_str());
+        return false;
+    }
+    const unsigned long long numPoints = cloudIn.points.size();
+    const unsigned int numChunks = static_cast<unsigned int>((numPoints + chunkSize - 1) / chunkSize);
+
+    // order the points so that each chunk covers a compact region
+    std::vector<unsigned int> order;
+    spatialOrder(cloudIn, order);
+
+    // compute the chunk bounding boxes
+    std::vector<Eigen::Vector3f> chunkMin(numChunks, Eigen::Vector3f::Constant(std::numeric_limits<float>::max()));
+    std::vector<Eigen::Vector3f> chunkMax(numChunks, Eigen::Vector3f::Constant(-std::numeric_limits<float>::max()));
+    std::vector<unsigned int> chunkPoints(numChunks, 0);
+    for(unsigned long long i = 0; i < numPoints; i++)
+    {
+        const pcl::PointXYZRGBA &p = cloudIn.points[order[i]];
+        const unsigned int chunk = static_cast<unsigned int>(i / chunkSize);
+        chunkPoints[chunk]++;
+        if(std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z))
+        {
+            chunkMin[chunk] = chunkMin[chunk].cwiseMin(Eigen::Vector3f(p.x, p.y, p.z));
+            chunkMax[chunk] = chunkMax[chunk].cwiseMax(Eigen::Vector3f(p.x, p.y, p.z));
+        }
+    }
+
+    // encode the blocks of each field
+    std::vector<std::vector<char> > blocks(PCC_NUM_FIELDS * numChunks);
+    std::vector<char> raw(static_cast<size_t>(chunkSize) * FIELD_SIZE);
+    for(unsigned int field = 0; field < PCC_NUM_FIELDS; field++)
+    {
+        for(unsigned int chunk = 0; chunk < numChunks; chunk++)
+        {
+            // gather and byte shuffle the field values of this chunk
+            const unsigned int count = chunkPoints[chunk];
+            const unsigned int rawSize = count * FIELD_SIZE;
+            for(unsigned int i = 0; i < count; i++)
+            {
+                const char* value = fieldPointer(cloudIn.points[order[static_cast<size_t>(chunk) * chunkSize + i]], field);
+                for(unsigned int b = 0; b < FIELD_SIZE; b++)
+                {
+                    raw[b * count + i] = value[b];
+                }
+            }
+
+            // compress the block, keeping the raw bytes if compression does not help
+            std::vector<char> &block = blocks[field * numChunks + chunk];
+            block.resize(rawSize);
+            unsigned int storedSize = 0;
+            if(compress && rawSize > 0)
+            {
+                storedSize = pcl::lzfCompress(&raw[0], rawSize, &block[0], rawSize - 1);
+            }
+            if(storedSize == 0)
+            {
+                std::copy(raw.begin(), raw.begin() + rawSize, block.begin());
+                storedSize = rawSize;
+            }
+            block.resize(storedSize);
+        }
+    }
+
+    // open the output file
+    std::ofstream file(fileName.c_str(), std::ios::binary | std::ios::trunc);
+    if(!file)
+    {
+        PCL_ERROR("error while attempting to save pcc file: %s \n", fileName.c_str());
+        return false;
+    }
+
+    // write the header and field table
+    file.write(PCC_MAGIC, 4);
+    writeValue(file, static_cast<unsigned int>(PCC_VERSION));
+    writeValue(file, numPoints);
+    writeValue(file, chunkSize);
+    writeValue(file, numChunks);
+    writeValue(file, static_cast<unsigned int>(PCC_NUM_FIELDS));
+    writeValue(file, static_cast<unsigned int>(compress ? PCC_FLAG_COMPRESSED : 0));
+    for(unsigned int field = 0; field < PCC_NUM_FIELDS; field++)
+    {
+        char name[PCC_FIELD_NAME_LENGTH] = {0};
+        std::strncpy(name, FIELD_NAMES[field], PCC_FIELD_NAME_LENGTH - 1);
+        file.write(name, PCC_FIELD_NAME_LENGTH);
+        writeValue(file, FIELD_SIZE);
+    }
+
+    // write the chunk table
+    for(unsigned int chunk = 0; chunk < numChunks; chunk++)
+    {
+        for(int axis = 0; axis < 3; axis++)
+        {
+            writeValue(file, chunkMin[chunk][axis]);
+        }
+        for(int axis = 0; axis < 3; axis++)
+        {
+            writeValue(file, chunkMax[chunk][axis]);
+        }
+        writeValue(file, chunkPoints[chunk]);
+    }
+
+    // write the block table, the data section starts immediately after it
+    unsigned long long offset = static_cast<unsigned long long>(file.tellp()) + static_cast<unsigned long long>(blocks.size()) * (sizeof(unsigned long long) + 2 * sizeof(unsigned int));
+    for(unsigned int field = 0; field < PCC_NUM_FIELDS; field++)
+    {
+        for(unsigned int chunk = 0; chunk < numChunks; chunk++)
+        {
+            const std::vector<char> &block = blocks[field * numChunks + chunk];
+            writeValue(file, offset);
+            writeValue(file, static_cast<unsigned int>(block.size()));
+            writeValue(file, chunkPoints[chunk] * FIELD_SIZE);
+            offset += block.size();
+        }
+    }
+
+    // write the data blocks
+    for(size_t i = 0; i < blocks.size(); i++)
+    {
+        if(!blocks[i].empty())
+        {
+            file.write(&blocks[i][0], blocks[i].size());
+        }
+    }
+
+    if(!file)
+    {
+        PCL_ERROR("error while attempting to save pcc file: %s \n", fileName.c_str());
+        return false;
+    }
+    return true;
+}
+
+/***********************************************************************************************************************
+ * @brief Class constructor
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+ColumnarCloudReader::ColumnarCloudReader()
+{
+    close();
+}
+
+/***********************************************************************************************************************
+ * @brief Close the file and release the tables
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void ColumnarCloudReader::close()
+{
+    if(m_file.is_open())
+    {
+        m_file.close();
+    }
+    m_numPoints = 0;
+    m_chunkSize = 0;
+    m_numFields = 0;
+    m_bytesRead = 0;
+    m_chunkMin.clear();
+    m_chunkMax.clear();
+    m_chunkPoints.clear();
+    m_blocks.clear();
+}
+
+/***********************************************************************************************************************
+ * @brief Open a columnar cloud file and read its tables
+ *
+ * Only the header and tables are read, the point data is read on demand. The tables are checked against each other and
+ * against the file size, so a corrupt file is rejected here instead of causing out of range reads later.
+ *
+ * @param[in] fileName path and name of input file
+ * @return false if the file could not be opened or is not a columnar cloud file
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool ColumnarCloudReader::open(const std::string &fileName)
+{
+    close();
+    m_file.open(fileName.c_str(), std::ios::binary);
+    if(!m_file)
+    {
+        PCL_ERROR("error while attempting to read pcc file: %s \n", fileName.c_str());
+        return false;
+    }
+
+    // get the file size for validating the tables
+    m_file.seekg(0, std::ios::end);
+    const unsigned long long fileSize = static_cast<unsigned long long>(m_file.tellg());
+    m_file.seekg(0, std::ios::beg);
+
+    // read and validate the header
+    char magic[4];
+    unsigned int version, numChunks, flags;
+    m_file.read(magic, 4);
+    if(!m_file || std::strncmp(magic, PCC_MAGIC, 4) != 0 || !readValue(m_file, version) || version != PCC_VERSION)
+    {
+        PCL_ERROR("error while attempting to read pcc file, invalid header: %s \n", fileName.c_str());
+        close();
+        return false;
+    }
+    readValue(m_file, m_numPoints);
+    readValue(m_file, m_chunkSize);
+    readValue(m_file, numChunks);
+    readValue(m_file, m_numFields);
+    readValue(m_file, flags);
+    if(!m_file || m_numFields != PCC_NUM_FIELDS)
+    {
+        PCL_ERROR("error while attempting to read pcc file, unsupported fields: %s \n", fileName.c_str());
+        close();
+        return false;
+    }
+
+    // the chunk count must match the point count, and the tables must fit in the file before they are allocated
+    const unsigned long long chunkTableSize = static_cast<unsigned long long>(numChunks) * (6 * sizeof(float) + sizeof(unsigned int));
+    const unsigned long long blockTableSize = static_cast<unsigned long long>(numChunks) * m_numFields * (sizeof(unsigned long long) + 2 * sizeof(unsigned int));
+    const unsigned long long tablesEnd = static_cast<unsigned long long>(m_file.tellg()) + m_numFields * (PCC_FIELD_NAME_LENGTH + sizeof(unsigned int)) + chunkTableSize + blockTableSize;
+    if(m_chunkSize == 0 || numChunks != (m_numPoints + m_chunkSize - 1) / m_chunkSize || tablesEnd > fileSize)
+    {
+        PCL_ERROR("error while attempting to read pcc file, invalid chunk layout: %s \n", fileName.c_str());
+        close();
+        return false;
+    }
+
+    // skip the field table, the field order is fixed for this version
+    m_file.seekg(m_numFields * (PCC_FIELD_NAME_LENGTH + sizeof(unsigned int)), std::ios::cur);
+
+    // read the chunk table
+    m_chunkMin.resize(numChunks);
+    m_chunkMax.resize(numChunks);
+    m_chunkPoints.resize(numChunks);
+    for(unsigned int chunk = 0; chunk < numChunks; chunk++)
+    {
+        for(int axis = 0; axis < 3; axis++)
+        {
+            readValue(m_file, m_chunkMin[chunk][axis]);
+        }
+        for(int axis = 0; axis < 3; axis++)
+        {
+            readValue(m_file, m_chunkMax[chunk][axis]);
+        }
+        readValue(m_file, m_chunkPoints[chunk]);
+    }
+
+    // read the block table
+    m_blocks.resize(m_numFields * numChunks);
+    for(size_t i = 0; i < m_blocks.size(); i++)
+    {
+        readValue(m_file, m_blocks[i].offset);
+        readValue(m_file, m_blocks[i].storedSize);
+        readValue(m_file, m_blocks[i].rawSize);
+    }
+
+    if(!m_file)
+    {
+        PCL_ERROR("error while attempting to read pcc file, truncated tables: %s \n", fileName.c_str());
+        close();
+        return false;
+    }
+
+    // every chunk must hold at most a chunk of points, and together exactly the point count
+    unsigned long long totalPoints = 0;
+    for(unsigned int chunk = 0; chunk < numChunks; chunk++)
+    {
+        if(m_chunkPoints[chunk] > m_chunkSize)
+        {
+            totalPoints = m_numPoints + 1;
+            break;
+        }
+        totalPoints += m_chunkPoints[chunk];
+    }
+    if(totalPoints != m_numPoints)
+    {
+        PCL_ERROR("error while attempting to read pcc file, invalid chunk table: %s \n", fileName.c_str());
+        close();
+        return false;
+    }
+
+    // every block must decode to its chunk of values, from bytes that lie inside the data section
+    for(size_t i = 0; i < m_blocks.size(); i++)
+    {
+        const Block &block = m_blocks[i];
+        const unsigned long long expectedRawSize = static_cast<unsigned long long>(m_chunkPoints[i % numChunks]) * FIELD_SIZE;
+        if(block.rawSize != expectedRawSize || block.storedSize > block.rawSize || (block.storedSize == 0 && block.rawSize > 0) ||
+           block.offset < tablesEnd || block.offset > fileSize || block.storedSize > fileSize - block.offset)
+        {
+            PCL_ERROR("error while attempting to read pcc file, invalid block table: %s \n", fileName.c_str());
+            close();
+            return false;
+        }
+    }
+    m_bytesRead = static_cast<unsigned long long>(m_file.tellg());
+    return true;
+}
+
+/***********************************************************************************************************************
+ * @brief Get the total number of points in the file
+ *
+ * @return the number of points
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+unsigned long long ColumnarCloudReader::getNumPoints() const
+{
+    return m_numPoints;
+}
+
+/***********************************************************************************************************************
+ * @brief Get the number of chunks in the file
+ *
+ * @return the number of chunks
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+unsigned int ColumnarCloudReader::getNumChunks() const
+{
+    return static_cast<unsigned int>(m_chunkPoints.size());
+}
+
+/***********************************************************************************************************************
+ * @brief Get the number of bytes read from the file since it was opened
+ *
+ * @return the number of bytes read, including the header and tables
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+unsigned long long ColumnarCloudReader::getBytesRead() const
+{
+    return m_bytesRead;
+}
+
+/***********************************************************************************************************************
+ * @brief Check if the bounding box of a chunk intersects a query box
+ *
+ * @param[in] chunk the chunk index
+ * @param[in] boxMin minimum corner of the query box
+ * @param[in] boxMax maximum corner of the query box
+ * @return true if the boxes intersect
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool ColumnarCloudReader::chunkIntersects(unsigned int chunk, const Eigen::Vector3f &boxMin, const Eigen::Vector3f &boxMax) const
+{
+    return (m_chunkMin[chunk].array() <= boxMax.array()).all() && (m_chunkMax[chunk].array() >= boxMin.array()).all();
+}
+
+/***********************************************************************************************************************
+ * @brief Read and decode one block of the file
+ *
+ * @param[in] field the field index
+ * @param[in] chunk the chunk index
+ * @param[out] data the decompressed, still byte shuffled, block contents
+ * @return false if an error occurred while reading
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool ColumnarCloudReader::readBlock(unsigned int field, unsigned int chunk, std::vector<char> &data)
+{
+    const Block &block = m_blocks[field * getNumChunks() + chunk];
+    data.resize(block.rawSize);
+    if(block.rawSize == 0)
+    {
+        return true;
+    }
+
+    // read the stored bytes
+    m_stored.resize(block.storedSize);
+    m_file.clear();
+    m_file.seekg(block.offset);
+    if(!m_file.read(&m_stored[0], block.storedSize))
+    {
+        return false;
+    }
+    m_bytesRead += block.storedSize;
+
+    // decompress the block if necessary
+    if(block.storedSize == block.rawSize)
+    {
+        data.swap(m_stored);
+        return true;
+    }
+    return pcl::lzfDecompress(&m_stored[0], block.storedSize, &data[0], block.rawSize) == block.rawSize;
+}
+
+/***********************************************************************************************************************
+ * @brief Read the selected fields of a single chunk
+ *
+ * The chunk points are appended to the output cloud. Fields that are not selected are left at their defaults: zero
+ * for the coordinates and opaque white for the color.
+ *
+ * @param[in] chunk the chunk index
+ * @param[in] fields bitwise combination of the CLOUD_FIELD values to load
+ * @param[out] cloudOut the cloud to append the points to
+ * @return false if an error occurred while reading
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool ColumnarCloudReader::readChunk(unsigned int chunk, unsigned int fields, pcl::PointCloud<pcl::PointXYZRGBA> &cloudOut)
+{
+    const size_t first = cloudOut.points.size();
+    const unsigned int count = m_chunkPoints[chunk];
+
+    // append default points
+    pcl::PointXYZRGBA defaultPoint;
+    defaultPoint.x = defaultPoint.y = defaultPoint.z = 0.0f;
+    defaultPoint.rgba = 0xffffffff;
+    cloudOut.points.resize(first + count, defaultPoint);
+
+    // unshuffle each selected field into the points
+    for(unsigned int field = 0; field < m_numFields; field++)
+    {
+        if((fields & (1u << field)) == 0)
+        {
+            continue;
+        }
+        if(!readBlock(field, chunk, m_raw))
+        {
+            cloudOut.points.resize(first);
+            return false;
+        }
+        for(unsigned int i = 0; i < count; i++)
+        {
+            char* value = const_cast<char*>(fieldPointer(cloudOut.points[first + i], field));
+            for(unsigned int b = 0; b < FIELD_SIZE; b++)
+            {
+                value[b] = m_raw[b * count + i];
+            }
+        }
+    }
+
+    cloudOut.width = static_cast<unsigned int>(cloudOut.points.size());
+    cloudOut.height = 1;
+    cloudOut.is_dense = false;
+    return true;
+}
+
+/***********************************************************************************************************************
+ * @brief Read the selected fields of every chunk that intersects a query box
+ *
+ * @param[out] cloudOut the loaded cloud
+ * @param[in] fields bitwise combination of the CLOUD_FIELD values to load (default: CLOUD_FIELD_ALL)
+ * @param[in] boxMin minimum corner of the query box, or null to load every chunk (default: null)
+ * @param[in] boxMax maximum corner of the query box, or null to load every chunk (default: null)
+ * @return false if an error occurred while reading
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool ColumnarCloudReader::read(pcl::PointCloud<pcl::PointXYZRGBA> &cloudOut, unsigned int fields, const Eigen::Vector3f *boxMin, const Eigen::Vector3f *boxMax)
+{
+    cloudOut.points.clear();
+    cloudOut.points.reserve(m_numPoints);
+    for(unsigned int chunk = 0; chunk < getNumChunks(); chunk++)
+    {
+        if(boxMin != 0 && boxMax != 0 && !chunkIntersects(chunk, *boxMin, *boxMax))
+        {
+            continue;
+        }
+        if(!readChunk(chunk, fields, cloudOut))
+        {
+            PCL_ERROR("error while attempting to read pcc chunk: %u \n", chunk);
+            return false;
+        }
+    }
+    cloudOut.width = static_cast<unsigned int>(cloudOut.points.size());
+    cloudOut.height = 1;
+    return true;
+}
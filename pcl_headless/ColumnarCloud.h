@@ -0,0 +1,118 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+/*******************************************************************************************************************//**
+ * @file ColumnarCloud.h
+ * @brief Header file for reading and writing columnar point cloud files
+ *
+ * A columnar cloud file (.pcc) stores each point field in its own contiguous region of the file. Each region is split
+ * into chunks of points, and every chunk carries an axis aligned bounding box. Readers can load only the fields they
+ * need and skip chunks that fall outside a query box.
+ *
+ * File layout (little endian):
+ *
+ *     header       magic "PCC1", version, point count, chunk size, chunk count, field count, flags
+ *     field table  per field: 8 character name, element size in bytes
+ *     chunk table  per chunk: minimum corner, maximum corner, point count
+ *     block table  per field and chunk: file offset, stored size, raw size
+ *     data         per field: the blocks of every chunk, one after the other
+ *
+ * Blocks are byte shuffled (all first bytes of the elements, then all second bytes, etc.) and LZF compressed when the
+ * compression flag is set. A block whose stored size equals its raw size was kept uncompressed.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#ifndef COLUMNARCLOUD_H
+#define COLUMNARCLOUD_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <Eigen/Core>
+
+// selectable point fields
+#define CLOUD_FIELD_X 0x01
+#define CLOUD_FIELD_Y 0x02
+#define CLOUD_FIELD_Z 0x04
+#define CLOUD_FIELD_RGBA 0x08
+#define CLOUD_FIELD_XYZ (CLOUD_FIELD_X | CLOUD_FIELD_Y | CLOUD_FIELD_Z)
+#define CLOUD_FIELD_ALL (CLOUD_FIELD_XYZ | CLOUD_FIELD_RGBA)
+
+/*******************************************************************************************************************//**
+ * @class ColumnarCloudReader
+ *
+ * @brief Class for reading the fields and chunks of a columnar cloud file on demand
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class ColumnarCloudReader
+{
+private:
+
+    // block location within the file
+    struct Block
+    {
+        unsigned long long offset;
+        unsigned int storedSize;
+        unsigned int rawSize;
+    };
+
+    // file state
+    std::ifstream m_file;
+    unsigned long long m_numPoints;
+    unsigned int m_chunkSize;
+    unsigned int m_numFields;
+    std::vector<Eigen::Vector3f> m_chunkMin;
+    std::vector<Eigen::Vector3f> m_chunkMax;
+    std::vector<unsigned int> m_chunkPoints;
+    std::vector<Block> m_blocks;
+    unsigned long long m_bytesRead;
+
+    // scratch buffers
+    std::vector<char> m_stored;
+    std::vector<char> m_raw;
+
+    // helper functions
+    bool readBlock(unsigned int field, unsigned int chunk, std::vector<char> &data);
+
+public:
+
+    // constructors
+    ColumnarCloudReader();
+
+    // file access
+    bool open(const std::string &fileName);
+    void close();
+
+    // accessors
+    unsigned long long getNumPoints() const;
+    unsigned int getNumChunks() const;
+    unsigned long long getBytesRead() const;
+    bool chunkIntersects(unsigned int chunk, const Eigen::Vector3f &boxMin, const Eigen::Vector3f &boxMax) const;
+
+    // loading
+    bool readChunk(unsigned int chunk, unsigned int fields, pcl::PointCloud<pcl::PointXYZRGBA> &cloudOut);
+    bool read(pcl::PointCloud<pcl::PointXYZRGBA> &cloudOut, unsigned int fields=CLOUD_FIELD_ALL, const Eigen::Vector3f *boxMin=0, const Eigen::Vector3f *boxMax=0);
+};
+
+// writing
+bool saveColumnarCloud(const pcl::PointCloud<pcl::PointXYZRGBA> &cloudIn, const std::string &fileName, bool compress=true, unsigned int chunkSize=65536);
+
+#endif // COLUMNARCLOUD_H
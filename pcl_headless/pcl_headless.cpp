@@ -23,6 +23,8 @@
 * @author Christopher D. McMurrough
 **********************************************************************************************************************/
 
+#include "ColumnarCloud.h"
+
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
 #include <pcl/io/pcd_io.h>
@@ -35,14 +37,18 @@
 /***********************************************************************************************************************
 * @brief Opens a point cloud file
 *
-* Opens a point cloud file in either PCD or PLY format
+* Opens a point cloud file in either PCD, PLY, or columnar PCC format. For PCC files, only the selected fields are
+* read and chunks outside of the query box are skipped.
 *
 * @param[out] cloudOut pointer to opened point cloud
 * @param[in] filename path and name of input file
+* @param[in] fields bitwise combination of CLOUD_FIELD values to load from PCC files (default: CLOUD_FIELD_ALL)
+* @param[in] boxMin minimum corner of the PCC query box, or null to load every chunk (default: null)
+* @param[in] boxMax maximum corner of the PCC query box, or null to load every chunk (default: null)
 * @return false if an error occurred while opening file
 * @author Christopher D. McMurrough
 **********************************************************************************************************************/
-bool openCloud(pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &cloudOut, std::string fileName)
+bool openCloud(pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &cloudOut, std::string fileName, unsigned int fields=CLOUD_FIELD_ALL, const Eigen::Vector3f *boxMin=0, const Eigen::Vector3f *boxMax=0)
 {
     // handle various file types
     std::string fileExtension = fileName.substr(fileName.find_last_of(".") + 1);
@@ -72,6 +78,20 @@ bool openCloud(pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &cloudOut, std::string fi
             return true;
         }
     }
+    else if(fileExtension.compare("pcc") == 0)
+    {
+        // attempt to open the file, reading only the requested fields
+        ColumnarCloudReader reader;
+        if(!reader.open(fileName) || !reader.read(*cloudOut, fields, boxMin, boxMax))
+        {
+            PCL_ERROR("error while attempting to read pcc file: %s \n", fileName.c_str());
+            return false;
+        }
+        else
+        {
+            return true;
+        }
+    }
     else
     {
         PCL_ERROR("error while attempting to read unsupported file: %s \n", fileName.c_str());
@@ -82,7 +102,7 @@ bool openCloud(pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &cloudOut, std::string fi
 /*******************************************************************************************************************//**
  * @brief Saves a point cloud to file
  *
- * Saves a given point cloud to disk in PCD format
+ * Saves a given point cloud to disk in PCD format, or in compressed columnar format if the file extension is pcc
  *
  * @param[in] cloudIn pointer to output point cloud
  * @param[in] filename path and name of output file
@@ -98,10 +118,17 @@ bool saveCloud(const pcl::PointCloud<pcl::PointXYZRGBA>::ConstPtr &cloudIn, std:
         return false;
     }
 
+    // save columnar files
+    std::string fileExtension = fileName.substr(fileName.find_last_of(".") + 1);
+    if(fileExtension.compare("pcc") == 0)
+    {
+        return saveColumnarCloud(*cloudIn, fileName);
+    }
+
     // attempt to save the file
     if(pcl::io::savePCDFile<pcl::PointXYZRGBA>(fileName, *cloudIn, binaryMode) == -1)
     {
-        PCL_ERROR("error while attempting to save pcd file: %s \n", fileName);
+        PCL_ERROR("error while attempting to save pcd file: %s \n", fileName.c_str());
         return false;
     }
     else
@@ -122,7 +149,7 @@ int main(int argc, char** argv)
     // validate and parse the command line arguments
     if(argc != NUM_COMMAND_ARGS + 1)
     {
-        std::printf("USAGE: %s <file_name>\n", argv[0]);
+        std::printf("USAGE: %s <input_file> <output_file> (pcd, ply, or pcc) \n", argv[0]);
         return 0;
     }
 	std::string inputFilePath(argv[1]);
@@ -131,9 +158,10 @@ int main(int argc, char** argv)
     // create a stop watch for measuring time
     pcl::StopWatch watch;
 
-    // open the point cloud
+    // open the point cloud, only the coordinates are needed since all colors are replaced
     pcl::PointCloud<pcl::PointXYZRGBA>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGBA>);
-    openCloud(cloud, inputFilePath);
+    openCloud(cloud, inputFilePath, CLOUD_FIELD_XYZ);
+    std::cout << "Loaded " << cloud->points.size() << " points in " << watch.getTimeSeconds() << " seconds" << std::endl;
 
 	// start timing the processing step
     watch.reset();
@@ -0,0 +1,213 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+/***********************************************************************************************************************
+ * @file NeighborGraph.cpp
+ * @brief Implementation of the NeighborGraph class
+ *
+ * This class caches radius neighbour lists so that euclidean clustering can be repeated with different parameters
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#include "NeighborGraph.h"
+
+#include <algorithm>
+#include <thread>
+
+/***********************************************************************************************************************
+ * @brief Comparison used to sort clusters from largest to smallest, matching pcl::EuclideanClusterExtraction
+ **********************************************************************************************************************/
+static bool compareClusterSize(const pcl::PointIndices &a, const pcl::PointIndices &b)
+{
+    return a.indices.size() > b.indices.size();
+}
+
+/***********************************************************************************************************************
+ * @brief Class constructor
+ *
+ * Initializes an empty graph
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+NeighborGraph::NeighborGraph()
+{
+    clear();
+}
+
+/***********************************************************************************************************************
+ * @brief Release the graph data
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void NeighborGraph::clear()
+{
+    m_maxRadius = 0;
+    m_offsets.assign(1, 0);
+    m_neighbors.clear();
+    m_sqrDistances.clear();
+}
+
+/***********************************************************************************************************************
+ * @brief Build the neighbour lists for every point of the tree input cloud
+ *
+ * Performs one radius search per point using an already constructed search tree. The searches are read only, so the
+ * points can be split into contiguous ranges and searched on several threads.
+ *
+ * @param[in] tree search tree with the input cloud already set
+ * @param[in] maxRadius the largest clustering tolerance the graph will support
+ * @param[in] numThreads number of threads used for the radius searches (default: 1)
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void NeighborGraph::build(const pcl::search::KdTree<pcl::PointXYZRGBA>::Ptr &tree, float maxRadius, int numThreads)
+{
+    const pcl::PointCloud<pcl::PointXYZRGBA>::ConstPtr cloud = tree->getInputCloud();
+    const int numPoints = static_cast<int>(cloud->points.size());
+    numThreads = std::max(1, std::min(numThreads, numPoints));
+
+    clear();
+    m_maxRadius = maxRadius;
+    m_offsets.assign(numPoints + 1, 0);
+
+    // perform the radius searches for each range, results are sorted by increasing distance
+    tree->setSortedResults(true);
+    std::vector<std::vector<int> > rangeNeighbors(numThreads);
+    std::vector<std::vector<float> > rangeSqrDistances(numThreads);
+    std::vector<std::thread> workers;
+    for(int t = 0; t < numThreads; t++)
+    {
+        workers.push_back(std::thread([&, t]()
+        {
+            std::vector<int> neighborIndices;
+            std::vector<float> neighborSqrDistances;
+            const int begin = static_cast<int>(static_cast<long long>(numPoints) * t / numThreads);
+            const int end = static_cast<int>(static_cast<long long>(numPoints) * (t + 1) / numThreads);
+            for(int i = begin; i < end; i++)
+            {
+                tree->radiusSearch(i, maxRadius, neighborIndices, neighborSqrDistances);
+                m_offsets[i + 1] = static_cast<int>(neighborIndices.size());
+                rangeNeighbors[t].insert(rangeNeighbors[t].end(), neighborIndices.begin(), neighborIndices.end());
+                rangeSqrDistances[t].insert(rangeSqrDistances[t].end(), neighborSqrDistances.begin(), neighborSqrDistances.end());
+            }
+        }));
+    }
+    for(size_t t = 0; t < workers.size(); t++)
+    {
+        workers[t].join();
+    }
+
+    // convert the neighbour counts to offsets and concatenate the ranges
+    for(int i = 0; i < numPoints; i++)
+    {
+        m_offsets[i + 1] += m_offsets[i];
+    }
+    m_neighbors.reserve(m_offsets[numPoints]);
+    m_sqrDistances.reserve(m_offsets[numPoints]);
+    for(int t = 0; t < numThreads; t++)
+    {
+        m_neighbors.insert(m_neighbors.end(), rangeNeighbors[t].begin(), rangeNeighbors[t].end());
+        m_sqrDistances.insert(m_sqrDistances.end(), rangeSqrDistances[t].begin(), rangeSqrDistances[t].end());
+    }
+}
+
+/***********************************************************************************************************************
+ * @brief Get the search radius the graph was built with
+ *
+ * @return the maximum supported clustering tolerance
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+float NeighborGraph::getMaxRadius() const
+{
+    return m_maxRadius;
+}
+
+/***********************************************************************************************************************
+ * @brief Get the number of points in the graph
+ *
+ * @return the number of points
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+int NeighborGraph::getNumPoints() const
+{
+    return static_cast<int>(m_offsets.size()) - 1;
+}
+
+/***********************************************************************************************************************
+ * @brief Get the number of stored neighbour entries
+ *
+ * @return the number of edges
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+size_t NeighborGraph::getNumEdges() const
+{
+    return m_neighbors.size();
+}
+
+/***********************************************************************************************************************
+ * @brief Perform euclidean cluster extraction using the cached neighbour lists
+ *
+ * Produces the same clusters as pcl::EuclideanClusterExtraction for any tolerance up to the maximum radius
+ *
+ * @param[in] tolerance the clustering distance, must not exceed the maximum radius of the graph
+ * @param[in] minClusterSize minimum number of points in a valid cluster
+ * @param[in] maxClusterSize maximum number of points in a valid cluster
+ * @param[out] clusterIndices list of point indices for each cluster, sorted from largest to smallest
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void NeighborGraph::extract(float tolerance, int minClusterSize, int maxClusterSize, std::vector<pcl::PointIndices> &clusterIndices) const
+{
+    const int numPoints = getNumPoints();
+    const float sqrTolerance = tolerance * tolerance;
+
+    clusterIndices.clear();
+    std::vector<bool> processed(numPoints, false);
+    std::vector<int> queue;
+    for(int i = 0; i < numPoints; i++)
+    {
+        if(processed[i])
+        {
+            continue;
+        }
+
+        // grow the cluster in breadth first order
+        queue.clear();
+        queue.push_back(i);
+        processed[i] = true;
+        for(size_t head = 0; head < queue.size(); head++)
+        {
+            const int point = queue[head];
+            for(int k = m_offsets[point]; k < m_offsets[point + 1] && m_sqrDistances[k] <= sqrTolerance; k++)
+            {
+                const int neighbor = m_neighbors[k];
+                if(!processed[neighbor])
+                {
+                    processed[neighbor] = true;
+                    queue.push_back(neighbor);
+                }
+            }
+        }
+
+        // keep the cluster if it satisfies the size constraints
+        if(static_cast<int>(queue.size()) >= minClusterSize && static_cast<int>(queue.size()) <= maxClusterSize)
+        {
+            clusterIndices.push_back(pcl::PointIndices());
+            clusterIndices.back().indices = queue;
+            std::sort(clusterIndices.back().indices.begin(), clusterIndices.back().indices.end());
+        }
+    }
+
+    std::sort(clusterIndices.begin(), clusterIndices.end(), compareClusterSize);
+}
@@ -0,0 +1,372 @@
+//
+//    Copyright 2021 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+/***********************************************************************************************************************
+* @file pcl_sweep.cpp
+* @brief sweeps clustering and plane segmentation parameters over a PCD file
+*
+* Headless tool for choosing segmentation thresholds. The cloud is loaded, downsampled and indexed once, then every
+* configuration of the given parameter grids is evaluated concurrently on a pool of worker threads. Grids are given as
+* name=min:max:step or name=v1,v2,v3 on the command line, for example:
+*
+*     pcl_sweep scan.pcd threads=8 distance=0.01:0.05:0.01 min_size=25,50,100 plane_distance=0.01:0.03:0.01
+*
+* @author Christopher D. McMurrough
+**********************************************************************************************************************/
+
+#include "ColumnarCloud.h"
+#include "NeighborGraph.h"
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/io/pcd_io.h>
+#include <pcl/io/ply_io.h>
+#include <pcl/common/time.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/search/kdtree.h>
+#include <pcl/sample_consensus/model_types.h>
+#include <pcl/sample_consensus/method_types.h>
+#include <pcl/sample_consensus/sac_model_plane.h>
+#include <pcl/segmentation/sac_segmentation.h>
+
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#define NUM_COMMAND_ARGS 1
+
+/***********************************************************************************************************************
+* @brief A single configuration of the sweep and its result
+**********************************************************************************************************************/
+struct SweepJob
+{
+    // configuration
+    bool isPlane;
+    double distance;
+    int minSize;
+    int maxSize;
+    int iterations;
+
+    // result
+    int count;
+    double elapsedMs;
+};
+
+/***********************************************************************************************************************
+* @brief Opens a point cloud file
+*
+* Opens a point cloud file in either PCD, PLY, or columnar PCC format. For PCC files, only the selected fields are
+* read and chunks outside of the query box are skipped.
+*
+* @param[out] cloudOut pointer to opened point cloud
+* @param[in] filename path and name of input file
+* @param[in] fields bitwise combination of CLOUD_FIELD values to load from PCC files (default: CLOUD_FIELD_ALL)
+* @param[in] boxMin minimum corner of the PCC query box, or null to load every chunk (default: null)
+* @param[in] boxMax maximum corner of the PCC query box, or null to load every chunk (default: null)
+* @return false if an error occurred while opening file
+* @author Christopher D. McMurrough
+**********************************************************************************************************************/
+bool openCloud(pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &cloudOut, std::string fileName, unsigned int fields=CLOUD_FIELD_ALL, const Eigen::Vector3f *boxMin=0, const Eigen::Vector3f *boxMax=0)
+{
+    // handle various file types
+    std::string fileExtension = fileName.substr(fileName.find_last_of(".") + 1);
+    if(fileExtension.compare("pcd") == 0)
+    {
+        // attempt to open the file
+        if(pcl::io::loadPCDFile<pcl::PointXYZRGBA>(fileName, *cloudOut) == -1)
+        {
+            PCL_ERROR("error while attempting to read pcd file: %s \n", fileName.c_str());
+            return false;
+        }
+        else
+        {
+            return true;
+        }
+    }
+    else if(fileExtension.compare("ply") == 0)
+    {
+        // attempt to open the file
+        if(pcl::io::loadPLYFile<pcl::PointXYZRGBA>(fileName, *cloudOut) == -1)
+        {
+            PCL_ERROR("error while attempting to read pcl file: %s \n", fileName.c_str());
+            return false;
+        }
+        else
+        {
+            return true;
+        }
+    }
+    else if(fileExtension.compare("pcc") == 0)
+    {
+        // attempt to open the file, reading only the requested fields
+        ColumnarCloudReader reader;
+        if(!reader.open(fileName) || !reader.read(*cloudOut, fields, boxMin, boxMax))
+        {
+            PCL_ERROR("error while attempting to read pcc file: %s \n", fileName.c_str());
+            return false;
+        }
+        else
+        {
+            return true;
+        }
+    }
+    else
+    {
+        PCL_ERROR("error while attempting to read unsupported file: %s \n", fileName.c_str());
+        return false;
+    }
+}
+
+/***********************************************************************************************************************
+* @brief Parses a parameter grid specification
+*
+* Accepts either a range in the form min:max:step or a comma separated list of values
+*
+* @param[in] spec the grid specification string
+* @param[out] values the expanded list of grid values
+* @return false if the specification could not be parsed
+* @author Christopher D. McMurrough
+**********************************************************************************************************************/
+bool parseGrid(const std::string &spec, std::vector<double> &values)
+{
+    values.clear();
+    if(spec.find(':') != std::string::npos)
+    {
+        // parse a range
+        double minValue, maxValue, step;
+        char separator1, separator2;
+        std::stringstream ss(spec);
+        if(!(ss >> minValue >> separator1 >> maxValue >> separator2 >> step) || step <= 0)
+        {
+            return false;
+        }
+        for(int i = 0; minValue + i * step <= maxValue + step * 1e-6; i++)
+        {
+            values.push_back(minValue + i * step);
+        }
+    }
+    else
+    {
+        // parse a list
+        std::stringstream ss(spec);
+        std::string item;
+        while(std::getline(ss, item, ','))
+        {
+            values.push_back(std::atof(item.c_str()));
+        }
+    }
+    return !values.empty();
+}
+
+/***********************************************************************************************************************
+* @brief Locate a plane in the cloud
+*
+* Perform planar segmentation using RANSAC, returning the number of inliers
+*
+* @param[in] cloudIn pointer to input point cloud
+* @param[in] distanceThreshold maximum distance of a point to the planar model to be considered an inlier
+* @param[in] maxIterations maximum number of iterations to attempt before returning
+* @return the number of inliers
+* @author Christopher D. McMurrough
+**********************************************************************************************************************/
+int segmentPlane(const pcl::PointCloud<pcl::PointXYZRGBA>::ConstPtr &cloudIn, double distanceThreshold, int maxIterations)
+{
+    // store the model coefficients and inliers
+    pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
+    pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
+
+    // Create the segmentation object for the planar model and set the parameters
+    pcl::SACSegmentation<pcl::PointXYZRGBA> seg;
+    seg.setOptimizeCoefficients(true);
+    seg.setModelType(pcl::SACMODEL_PLANE);
+    seg.setMethodType(pcl::SAC_RANSAC);
+    seg.setMaxIterations(maxIterations);
+    seg.setDistanceThreshold(distanceThreshold);
+
+    // Segment the largest planar component from the remaining cloud
+    seg.setInputCloud(cloudIn);
+    seg.segment(*inliers, *coefficients);
+    return static_cast<int>(inliers->indices.size());
+}
+
+/***********************************************************************************************************************
+* @brief program entry point
+* @param[in] argc number of command line arguments
+* @param[in] argv string array of command line arguments
+* @returnS return code (0 for normal termination)
+* @author Christoper D. McMurrough
+**********************************************************************************************************************/
+int main(int argc, char** argv)
+{
+    // validate and parse the command line arguments
+    if(argc < NUM_COMMAND_ARGS + 1)
+    {
+        std::printf("USAGE: %s <file_name> [threads=N] [voxel=S] [distance=GRID] [min_size=GRID] [max_size=GRID] [plane_distance=GRID] [plane_iterations=GRID]\n", argv[0]);
+        std::printf("       GRID is min:max:step or v1,v2,... (an empty grid skips that sweep)\n");
+        return 0;
+    }
+    std::string inputFilePath(argv[1]);
+
+    // set the default parameter grids
+    std::map<std::string, std::string> gridSpecs;
+    gridSpecs["threads"] = "0";
+    gridSpecs["voxel"] = "0.01";
+    gridSpecs["distance"] = "0.01:0.05:0.01";
+    gridSpecs["min_size"] = "50";
+    gridSpecs["max_size"] = "100000";
+    gridSpecs["plane_distance"] = "0.01:0.03:0.005";
+    gridSpecs["plane_iterations"] = "1000,5000";
+    for(int i = 2; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+        size_t split = arg.find('=');
+        if(split == std::string::npos || gridSpecs.find(arg.substr(0, split)) == gridSpecs.end())
+        {
+            std::printf("Unknown argument: %s \n", argv[i]);
+            return 0;
+        }
+        gridSpecs[arg.substr(0, split)] = arg.substr(split + 1);
+    }
+
+    // expand the parameter grids
+    std::map<std::string, std::vector<double> > grids;
+    for(std::map<std::string, std::string>::const_iterator it = gridSpecs.begin(); it != gridSpecs.end(); ++it)
+    {
+        if(!it->second.empty() && !parseGrid(it->second, grids[it->first]))
+        {
+            std::printf("Unable to parse grid: %s=%s \n", it->first.c_str(), it->second.c_str());
+            return 0;
+        }
+    }
+    int numThreads = grids["threads"].empty() ? 0 : static_cast<int>(grids["threads"].at(0));
+    if(numThreads <= 0)
+    {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    const float voxelSize = grids["voxel"].empty() ? 0.01f : static_cast<float>(grids["voxel"].at(0));
+
+    // create the list of jobs from the cartesian product of the grids
+    std::vector<SweepJob> jobs;
+    const std::vector<double> &distances = grids["distance"];
+    const std::vector<double> &minSizes = grids["min_size"];
+    const std::vector<double> &maxSizes = grids["max_size"];
+    const std::vector<double> &planeDistances = grids["plane_distance"];
+    const std::vector<double> &planeIterations = grids["plane_iterations"];
+    for(size_t i = 0; i < distances.size(); i++)
+    {
+        for(size_t j = 0; j < minSizes.size(); j++)
+        {
+            for(size_t k = 0; k < maxSizes.size(); k++)
+            {
+                SweepJob job = {false, distances[i], static_cast<int>(minSizes[j]), static_cast<int>(maxSizes[k]), 0, 0, 0.0};
+                jobs.push_back(job);
+            }
+        }
+    }
+    for(size_t i = 0; i < planeDistances.size(); i++)
+    {
+        for(size_t j = 0; j < planeIterations.size(); j++)
+        {
+            SweepJob job = {true, planeDistances[i], 0, 0, static_cast<int>(planeIterations[j]), 0, 0.0};
+            jobs.push_back(job);
+        }
+    }
+
+    // create a stop watch for measuring time
+    pcl::StopWatch watch;
+
+    // open the point cloud once for all configurations, only the coordinates are needed
+    pcl::PointCloud<pcl::PointXYZRGBA>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGBA>);
+    if(!openCloud(cloud, inputFilePath, CLOUD_FIELD_XYZ))
+    {
+        return 0;
+    }
+    std::printf("Loaded %d points in %.3f seconds \n", static_cast<int>(cloud->points.size()), watch.getTimeSeconds());
+
+    // downsample the cloud and build the shared neighbour graph at the largest cluster distance
+    NeighborGraph graph;
+    if(!distances.empty())
+    {
+        watch.reset();
+        pcl::PointCloud<pcl::PointXYZRGBA>::Ptr cloudFiltered(new pcl::PointCloud<pcl::PointXYZRGBA>);
+        pcl::VoxelGrid<pcl::PointXYZRGBA> voxFilter;
+        voxFilter.setInputCloud(cloud);
+        voxFilter.setLeafSize(voxelSize, voxelSize, voxelSize);
+        voxFilter.filter(*cloudFiltered);
+
+        pcl::search::KdTree<pcl::PointXYZRGBA>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZRGBA>);
+        tree->setInputCloud(cloudFiltered);
+        graph.build(tree, static_cast<float>(*std::max_element(distances.begin(), distances.end())), numThreads);
+        std::printf("Indexed %d points (%d neighbour entries) in %.3f seconds \n", graph.getNumPoints(), static_cast<int>(graph.getNumEdges()), watch.getTimeSeconds());
+    }
+
+    // run the jobs on the worker threads, each worker claims the next unprocessed job
+    watch.reset();
+    std::atomic<int> nextJob(0);
+    std::vector<std::thread> workers;
+    for(int t = 0; t < numThreads; t++)
+    {
+        workers.push_back(std::thread([&]()
+        {
+            pcl::StopWatch jobWatch;
+            std::vector<pcl::PointIndices> clusterIndices;
+            for(int i = nextJob++; i < static_cast<int>(jobs.size()); i = nextJob++)
+            {
+                SweepJob &job = jobs[i];
+                jobWatch.reset();
+                if(job.isPlane)
+                {
+                    job.count = segmentPlane(cloud, job.distance, job.iterations);
+                }
+                else
+                {
+                    graph.extract(static_cast<float>(job.distance), job.minSize, job.maxSize, clusterIndices);
+                    job.count = static_cast<int>(clusterIndices.size());
+                }
+                job.elapsedMs = jobWatch.getTime();
+            }
+        }));
+    }
+    for(size_t t = 0; t < workers.size(); t++)
+    {
+        workers[t].join();
+    }
+    double elapsedTime = watch.getTimeSeconds();
+
+    // print the results table
+    std::printf("\n%-8s %10s %10s %10s %10s %10s %12s\n", "type", "distance", "min_size", "max_size", "iters", "count", "time_ms");
+    for(size_t i = 0; i < jobs.size(); i++)
+    {
+        const SweepJob &job = jobs[i];
+        if(job.isPlane)
+        {
+            std::printf("%-8s %10.4f %10s %10s %10d %10d %12.2f\n", "plane", job.distance, "-", "-", job.iterations, job.count, job.elapsedMs);
+        }
+        else
+        {
+            std::printf("%-8s %10.4f %10d %10d %10s %10d %12.2f\n", "cluster", job.distance, job.minSize, job.maxSize, "-", job.count, job.elapsedMs);
+        }
+    }
+    std::printf("\n%d configurations on %d threads in %.3f seconds \n", static_cast<int>(jobs.size()), numThreads, elapsedTime);
+
+    // exit program
+    return 0;
+}
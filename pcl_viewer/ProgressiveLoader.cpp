@@ -0,0 +1,383 @@
+//
+//    Copyright 2018 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+/***********************************************************************************************************************
+ * @file ProgressiveLoader.cpp
+ * @brief Implementation of the ProgressiveLoader class
+ *
+ * This class streams a point cloud file on a background thread so that it can be displayed while it loads
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#include "ProgressiveLoader.h"
+#include "ColumnarCloud.h"
+
+#include <pcl/io/pcd_io.h>
+#include <pcl/conversions.h>
+#include <pcl/PCLPointCloud2.h>
+
+#include <fstream>
+#include <algorithm>
+
+// PCD data section encodings, as reported by pcl::PCDReader::readHeader
+#define PCD_DATA_ASCII 0
+#define PCD_DATA_BINARY 1
+
+/***********************************************************************************************************************
+ * @brief Class constructor
+ *
+ * @param[in] chunkPoints number of points delivered per chunk (default: 1000000)
+ * @param[in] previewPoints approximate number of points in the initial preview (default: 200000)
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+ProgressiveLoader::ProgressiveLoader(size_t chunkPoints, size_t previewPoints)
+{
+    m_chunkPoints = std::max<size_t>(chunkPoints, 1);
+    m_previewPoints = previewPoints;
+    m_stop = false;
+    m_done = false;
+    m_success = false;
+    m_pointsLoaded = 0;
+    m_totalPoints = 0;
+}
+
+/***********************************************************************************************************************
+ * @brief Class destructor
+ *
+ * Stops the loading thread if it is still running
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+ProgressiveLoader::~ProgressiveLoader()
+{
+    stop();
+}
+
+/***********************************************************************************************************************
+ * @brief Check if a file can be loaded progressively
+ *
+ * @param[in] fileName path and name of input file
+ * @return true for PCD and PCC files
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool ProgressiveLoader::isSupported(const std::string &fileName)
+{
+    std::string fileExtension = fileName.substr(fileName.find_last_of(".") + 1);
+    return fileExtension.compare("pcd") == 0 || fileExtension.compare("pcc") == 0;
+}
+
+/***********************************************************************************************************************
+ * @brief Start loading a file on the background thread
+ *
+ * @param[in] fileName path and name of input file
+ * @return false if the file type is not supported or a load is already in progress
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool ProgressiveLoader::start(const std::string &fileName)
+{
+    if(!isSupported(fileName) || m_thread.joinable())
+    {
+        return false;
+    }
+
+    m_fileName = fileName;
+    m_stop = false;
+    m_done = false;
+    m_success = false;
+    m_pointsLoaded = 0;
+    m_totalPoints = 0;
+    m_thread = std::thread(&ProgressiveLoader::run, this);
+    return true;
+}
+
+/***********************************************************************************************************************
+ * @brief Stop the background thread and wait for it to exit
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void ProgressiveLoader::stop()
+{
+    m_stop = true;
+    if(m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+/***********************************************************************************************************************
+ * @brief Background thread entry point
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void ProgressiveLoader::run()
+{
+    std::string fileExtension = m_fileName.substr(m_fileName.find_last_of(".") + 1);
+    if(fileExtension.compare("pcc") == 0)
+    {
+        m_success = loadColumnar();
+    }
+    else
+    {
+        m_success = loadBinaryPCD();
+    }
+    m_done = true;
+}
+
+/***********************************************************************************************************************
+ * @brief Add a loaded chunk to the queue
+ *
+ * @param[in] chunk the loaded points
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+void ProgressiveLoader::pushChunk(const pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &chunk)
+{
+    m_pointsLoaded += chunk->points.size();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_chunks.push_back(chunk);
+}
+
+/***********************************************************************************************************************
+ * @brief Stream a PCD file
+ *
+ * Binary PCD files are read as a strided preview followed by contiguous chunks. ASCII and compressed PCD files can not
+ * be addressed by point, so they are loaded in one piece and delivered as a single chunk.
+ *
+ * @return false if an error occurred while reading
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool ProgressiveLoader::loadBinaryPCD()
+{
+    // read the header to find the field layout and the start of the data section
+    pcl::PCDReader reader;
+    pcl::PCLPointCloud2 header;
+    Eigen::Vector4f origin;
+    Eigen::Quaternionf orientation;
+    int version, dataType;
+    unsigned int dataIndex;
+    if(reader.readHeader(m_fileName, header, origin, orientation, version, dataType, dataIndex) < 0)
+    {
+        PCL_ERROR("error while attempting to read pcd file: %s \n", m_fileName.c_str());
+        return false;
+    }
+    header.data.clear();
+    const size_t numPoints = static_cast<size_t>(header.width) * header.height;
+    const size_t pointStep = header.point_step;
+    m_totalPoints = numPoints;
+
+    // load other encodings in one piece
+    if(dataType != PCD_DATA_BINARY)
+    {
+        pcl::PointCloud<pcl::PointXYZRGBA>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGBA>);
+        if(pcl::io::loadPCDFile<pcl::PointXYZRGBA>(m_fileName, *cloud) == -1)
+        {
+            PCL_ERROR("error while attempting to read pcd file: %s \n", m_fileName.c_str());
+            return false;
+        }
+        pushChunk(cloud);
+        return true;
+    }
+
+    std::ifstream file(m_fileName.c_str(), std::ios::binary);
+    if(!file)
+    {
+        PCL_ERROR("error while attempting to read pcd file: %s \n", m_fileName.c_str());
+        return false;
+    }
+
+    // read a strided subsample of the whole file for the preview
+    pcl::PCLPointCloud2 block = header;
+    const size_t stride = m_previewPoints > 0 ? std::max<size_t>(numPoints / m_previewPoints, 1) : 0;
+    if(stride > 1)
+    {
+        const size_t previewCount = numPoints / stride;
+        block.width = static_cast<unsigned int>(previewCount);
+        block.height = 1;
+        block.row_step = static_cast<unsigned int>(previewCount * pointStep);
+        block.data.resize(previewCount * pointStep);
+        for(size_t i = 0; i < previewCount && !m_stop; i++)
+        {
+            file.seekg(dataIndex + i * stride * pointStep);
+            file.read(reinterpret_cast<char*>(&block.data[i * pointStep]), pointStep);
+        }
+        if(!file)
+        {
+            PCL_ERROR("error while attempting to read pcd preview: %s \n", m_fileName.c_str());
+            return false;
+        }
+
+        pcl::PointCloud<pcl::PointXYZRGBA>::Ptr preview(new pcl::PointCloud<pcl::PointXYZRGBA>);
+        pcl::fromPCLPointCloud2(block, *preview);
+        preview->sensor_origin_ = origin;
+        preview->sensor_orientation_ = orientation;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_preview = preview;
+    }
+
+    // read the data section in contiguous chunks
+    file.seekg(dataIndex);
+    for(size_t first = 0; first < numPoints && !m_stop; first += m_chunkPoints)
+    {
+        const size_t count = std::min(m_chunkPoints, numPoints - first);
+        block.width = static_cast<unsigned int>(count);
+        block.height = 1;
+        block.row_step = static_cast<unsigned int>(count * pointStep);
+        block.data.resize(count * pointStep);
+        if(!file.read(reinterpret_cast<char*>(&block.data[0]), count * pointStep))
+        {
+            PCL_ERROR("error while attempting to read pcd file, truncated data: %s \n", m_fileName.c_str());
+            return false;
+        }
+
+        pcl::PointCloud<pcl::PointXYZRGBA>::Ptr chunk(new pcl::PointCloud<pcl::PointXYZRGBA>);
+        pcl::fromPCLPointCloud2(block, *chunk);
+        chunk->sensor_origin_ = origin;
+        chunk->sensor_orientation_ = orientation;
+        pushChunk(chunk);
+    }
+    return !m_stop;
+}
+
+/***********************************************************************************************************************
+ * @brief Stream a columnar cloud file one file chunk at a time
+ *
+ * @return false if an error occurred while reading
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool ProgressiveLoader::loadColumnar()
+{
+    ColumnarCloudReader reader;
+    if(!reader.open(m_fileName))
+    {
+        return false;
+    }
+    m_totalPoints = reader.getNumPoints();
+
+    // merge file chunks until the requested chunk size is reached
+    pcl::PointCloud<pcl::PointXYZRGBA>::Ptr chunk(new pcl::PointCloud<pcl::PointXYZRGBA>);
+    for(unsigned int i = 0; i < reader.getNumChunks() && !m_stop; i++)
+    {
+        if(!reader.readChunk(i, CLOUD_FIELD_ALL, *chunk))
+        {
+            PCL_ERROR("error while attempting to read pcc chunk: %u \n", i);
+            return false;
+        }
+        if(chunk->points.size() >= m_chunkPoints || i + 1 == reader.getNumChunks() || m_pointsLoaded == 0)
+        {
+            pushChunk(chunk);
+            chunk.reset(new pcl::PointCloud<pcl::PointXYZRGBA>);
+        }
+    }
+    return !m_stop;
+}
+
+/***********************************************************************************************************************
+ * @brief Take the preview subsample if it is available
+ *
+ * @param[out] previewOut the preview cloud
+ * @return true if a preview was returned, the preview is only returned once
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool ProgressiveLoader::getPreview(pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &previewOut)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(!m_preview)
+    {
+        return false;
+    }
+    previewOut = m_preview;
+    m_preview.reset();
+    return true;
+}
+
+/***********************************************************************************************************************
+ * @brief Take the next loaded chunk if one is available
+ *
+ * @param[out] chunkOut the loaded chunk
+ * @return true if a chunk was returned
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool ProgressiveLoader::getChunk(pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &chunkOut)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_chunks.empty())
+    {
+        return false;
+    }
+    chunkOut = m_chunks.front();
+    m_chunks.pop_front();
+    return true;
+}
+
+/***********************************************************************************************************************
+ * @brief Check if the background thread has finished reading
+ *
+ * @return true once the file has been read or an error occurred, chunks may still be waiting in the queue
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool ProgressiveLoader::isDone() const
+{
+    return m_done;
+}
+
+/***********************************************************************************************************************
+ * @brief Check if the file was read without errors
+ *
+ * @return true if the load completed successfully
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+bool ProgressiveLoader::wasSuccessful() const
+{
+    return m_success;
+}
+
+/***********************************************************************************************************************
+ * @brief Get the fraction of the file that has been read
+ *
+ * @return the load progress in the range [0, 1]
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+double ProgressiveLoader::getProgress() const
+{
+    const unsigned long long total = m_totalPoints;
+    if(total == 0)
+    {
+        return m_done ? 1.0 : 0.0;
+    }
+    return static_cast<double>(m_pointsLoaded) / static_cast<double>(total);
+}
+
+/***********************************************************************************************************************
+ * @brief Get the number of points read so far
+ *
+ * @return the number of points
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+unsigned long long ProgressiveLoader::getPointsLoaded() const
+{
+    return m_pointsLoaded;
+}
+
+/***********************************************************************************************************************
+ * @brief Get the number of points in the file
+ *
+ * @return the number of points, or zero if the header has not been read yet
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+unsigned long long ProgressiveLoader::getTotalPoints() const
+{
+    return m_totalPoints;
+}
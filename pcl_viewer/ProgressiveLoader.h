@@ -0,0 +1,98 @@
+//
+//    Copyright 2018 Christopher D. McMurrough
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+/*******************************************************************************************************************//**
+ * @file ProgressiveLoader.h
+ * @brief Header file for the ProgressiveLoader class
+ *
+ * This class streams a point cloud file on a background thread so that it can be displayed while it loads
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+
+#ifndef PROGRESSIVELOADER_H
+#define PROGRESSIVELOADER_H
+
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+/*******************************************************************************************************************//**
+ * @class ProgressiveLoader
+ *
+ * @brief Class for loading a point cloud file in chunks on a background thread
+ *
+ * For binary PCD files, a strided subsample of the whole file is read first and delivered as a preview, followed by
+ * the file contents in contiguous chunks. Columnar PCC files are delivered one file chunk at a time. The rendering
+ * thread polls for loaded chunks and never blocks on file I/O.
+ *
+ * @author Christopher D. McMurrough
+ **********************************************************************************************************************/
+class ProgressiveLoader
+{
+private:
+
+    // loader settings
+    std::string m_fileName;
+    size_t m_chunkPoints;
+    size_t m_previewPoints;
+
+    // loaded chunks waiting to be consumed
+    std::mutex m_mutex;
+    std::deque<pcl::PointCloud<pcl::PointXYZRGBA>::Ptr> m_chunks;
+    pcl::PointCloud<pcl::PointXYZRGBA>::Ptr m_preview;
+
+    // loader state
+    std::thread m_thread;
+    std::atomic<bool> m_stop;
+    std::atomic<bool> m_done;
+    std::atomic<bool> m_success;
+    std::atomic<unsigned long long> m_pointsLoaded;
+    std::atomic<unsigned long long> m_totalPoints;
+
+    // loading functions
+    void run();
+    bool loadBinaryPCD();
+    bool loadColumnar();
+    void pushChunk(const pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &chunk);
+
+public:
+
+    // constructors
+    ProgressiveLoader(size_t chunkPoints=1000000, size_t previewPoints=200000);
+    ~ProgressiveLoader();
+
+    // loading control
+    static bool isSupported(const std::string &fileName);
+    bool start(const std::string &fileName);
+    void stop();
+
+    // polling
+    bool getPreview(pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &previewOut);
+    bool getChunk(pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &chunkOut);
+    bool isDone() const;
+    bool wasSuccessful() const;
+    double getProgress() const;
+    unsigned long long getPointsLoaded() const;
+    unsigned long long getTotalPoints() const;
+};
+
+#endif // PROGRESSIVELOADER_H
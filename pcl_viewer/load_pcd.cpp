@@ -24,6 +24,8 @@
 **********************************************************************************************************************/
 
 #include "CloudVisualizer.h"
+#include "ColumnarCloud.h"
+#include "ProgressiveLoader.h"
 
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
@@ -95,14 +97,18 @@ void keyboardCallback(const pcl::visualization::KeyboardEvent &event, void* view
 /***********************************************************************************************************************
 * @brief Opens a point cloud file
 *
-* Opens a point cloud file in either PCD or PLY format
+* Opens a point cloud file in either PCD, PLY, or columnar PCC format. For PCC files, only the selected fields are
+* read and chunks outside of the query box are skipped.
 *
 * @param[out] cloudOut pointer to opened point cloud
 * @param[in] filename path and name of input file
+* @param[in] fields bitwise combination of CLOUD_FIELD values to load from PCC files (default: CLOUD_FIELD_ALL)
+* @param[in] boxMin minimum corner of the PCC query box, or null to load every chunk (default: null)
+* @param[in] boxMax maximum corner of the PCC query box, or null to load every chunk (default: null)
 * @return false if an error occurred while opening file
 * @author Christopher D. McMurrough
 **********************************************************************************************************************/
-bool openCloud(pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &cloudOut, const char* fileName)
+bool openCloud(pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &cloudOut, const char* fileName, unsigned int fields=CLOUD_FIELD_ALL, const Eigen::Vector3f *boxMin=0, const Eigen::Vector3f *boxMax=0)
 {
     // convert the file name to string
     std::string fileNameStr(fileName);
@@ -135,6 +141,20 @@ bool openCloud(pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &cloudOut, const char* fi
             return true;
         }
     }
+    else if(fileExtension.compare("pcc") == 0)
+    {
+        // attempt to open the file, reading only the requested fields
+        ColumnarCloudReader reader;
+        if(!reader.open(fileNameStr) || !reader.read(*cloudOut, fields, boxMin, boxMax))
+        {
+            PCL_ERROR("error while attempting to read pcc file: %s \n", fileNameStr.c_str());
+            return false;
+        }
+        else
+        {
+            return true;
+        }
+    }
     else
     {
         PCL_ERROR("error while attempting to read unsupported file: %s \n", fileNameStr.c_str());
@@ -152,14 +172,22 @@ bool openCloud(pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &cloudOut, const char* fi
 int main(int argc, char** argv)
 {
     // validate and parse the command line arguments
-    if(argc != NUM_COMMAND_ARGS + 1)
+    if(argc < NUM_COMMAND_ARGS + 1 || argc > NUM_COMMAND_ARGS + 2 || (argc == NUM_COMMAND_ARGS + 2 && std::string(argv[2]).compare("--progressive") != 0))
     {
-        std::printf("USAGE: %s <file_name>\n", argv[0]);
+        std::printf("USAGE: %s <file_name> [--progressive]\n", argv[0]);
         return 0;
     }
 
     // parse the command line arguments
     char* fileName = argv[1];
+    bool progressive = (argc == NUM_COMMAND_ARGS + 2);
+
+    // progressive loading is only available for binary PCD and PCC files
+    if(progressive && !ProgressiveLoader::isSupported(fileName))
+    {
+        cout << "progressive loading is not supported for this file type, loading synchronously" << endl;
+        progressive = false;
+    }
 
     // create a stop watch for measuring time
     pcl::StopWatch watch;
@@ -170,26 +198,100 @@ int main(int argc, char** argv)
     // start timing the processing step
     watch.reset();
 
-    // open the point cloud
+    // open the point cloud, or start streaming it in the background
     pcl::PointCloud<pcl::PointXYZRGBA>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGBA>);
-    openCloud(cloud, fileName);
+    ProgressiveLoader loader;
+    if(progressive)
+    {
+        loader.start(fileName);
+    }
+    else
+    {
+        openCloud(cloud, fileName);
 
-    // get the elapsed time
-    double elapsedTime = watch.getTimeSeconds();
-    cout << elapsedTime << " seconds passed " << std::endl;
+        // get the elapsed time
+        double elapsedTime = watch.getTimeSeconds();
+        cout << elapsedTime << " seconds passed " << std::endl;
 
-    // render the scene
-    CV.addCloud(cloud);
-    CV.addCoordinateFrame(cloud->sensor_origin_, cloud->sensor_orientation_);
+        // render the scene
+        CV.addCloud(cloud);
+        CV.addCoordinateFrame(cloud->sensor_origin_, cloud->sensor_orientation_);
+    }
 
     // register mouse and keyboard event callbacks
     CV.registerPointPickingCallback(pointPickingCallback, cloud);
     CV.registerKeyboardCallback(keyboardCallback);
 
+    // progressive loading state
+    bool firstFrame = true;
+    bool previewShown = false;
+    bool loadComplete = !progressive;
+    int numChunks = 0;
+    unsigned long long pointsShown = 0;
+    int lastProgressStep = -1;
+
     // enter visualization loop
     while(CV.isRunning())
     {
-        CV.spin(100);
+        // display any data loaded since the last frame
+        if(!loadComplete)
+        {
+            // sample the loader state before draining so that no chunk arrives after the final poll
+            bool loaderDone = loader.isDone();
+
+            // show the strided preview as soon as it is available
+            pcl::PointCloud<pcl::PointXYZRGBA>::Ptr chunk;
+            if(loader.getPreview(chunk))
+            {
+                CV.addCloud(chunk, 1.0, "preview");
+                CV.addCoordinateFrame(chunk->sensor_origin_, chunk->sensor_orientation_);
+                previewShown = true;
+            }
+
+            // add each loaded chunk as its own cloud so that appending does not re-upload the points already shown
+            while(loader.getChunk(chunk))
+            {
+                if(!previewShown && numChunks == 0)
+                {
+                    CV.addCoordinateFrame(chunk->sensor_origin_, chunk->sensor_orientation_);
+                }
+                CV.addCloud(chunk, 1.0, "chunk_" + std::to_string(numChunks));
+                pointsShown += chunk->points.size();
+                numChunks++;
+            }
+
+            // report the time until the first points were rendered
+            if(firstFrame && (previewShown || numChunks > 0))
+            {
+                cout << "time to first frame: " << watch.getTimeSeconds() << " seconds" << endl;
+                firstFrame = false;
+            }
+
+            // report the load progress in steps of ten percent
+            int progressStep = static_cast<int>(loader.getProgress() * 10.0);
+            if(progressStep != lastProgressStep)
+            {
+                cout << "loaded " << loader.getPointsLoaded() << " of " << loader.getTotalPoints() << " points (" << progressStep * 10 << "%)" << endl;
+                lastProgressStep = progressStep;
+            }
+
+            // the preview is redundant once every chunk is displayed
+            if(loaderDone)
+            {
+                if(previewShown)
+                {
+                    CV.removePointCloud("preview");
+                }
+                if(!loader.wasSuccessful())
+                {
+                    PCL_ERROR("error while attempting to read file: %s \n", fileName);
+                }
+                cout << watch.getTimeSeconds() << " seconds passed, " << pointsShown << " points loaded in " << numChunks << " chunks" << endl;
+                loadComplete = true;
+            }
+        }
+
+        CV.spin(progressive && !loadComplete ? 10 : 100);
     }
 
     // exit program